@@ -22,6 +22,7 @@
  */
 
 #include <stdlib.h>
+#include <errno.h>
 
 #include "lingot-defs.h"
 #include "lingot-audio-alsa.h"
@@ -29,25 +30,40 @@
 #include "lingot-msg.h"
 
 #ifdef ALSA
-//snd_pcm_format_t sample_format = SND_PCM_FORMAT_S16;
-snd_pcm_format_t sample_format = SND_PCM_FORMAT_FLOAT;
-//snd_pcm_format_t sample_format = SND_PCM_FORMAT_FLOAT64;
+// capture formats in order of preference, the integer ones first, as they
+// are the ones the cards use.
+static const snd_pcm_format_t alsa_formats[] = { SND_PCM_FORMAT_S32,
+		SND_PCM_FORMAT_S24_3LE, SND_PCM_FORMAT_S16, SND_PCM_FORMAT_FLOAT,
+		SND_PCM_FORMAT_FLOAT64 };
+static const sample_format_t sample_formats[] = { SAMPLE_FORMAT_S32,
+		SAMPLE_FORMAT_S24_3LE, SAMPLE_FORMAT_S16, SAMPLE_FORMAT_FLOAT32,
+		SAMPLE_FORMAT_FLOAT64 };
 #endif
 
-LingotAudioHandler* lingot_audio_alsa_new(char* device, int sample_rate) {
+LingotAudioHandler* lingot_audio_alsa_new(char* device, int sample_rate,
+		unsigned int period_size, unsigned int periods) {
 
 	LingotAudioHandler* audio = NULL;
 
 #	ifdef ALSA
 	const char* exception;
 	snd_pcm_hw_params_t* hw_params = NULL;
+	snd_pcm_sw_params_t* sw_params = NULL;
 	int err;
 	char error_message[1000];
-	static const unsigned int channels = 1;
+	unsigned int channels = 1;
+	unsigned int format_index;
+	snd_pcm_uframes_t period;
+	int dir = 0;
+	const unsigned int n_formats = sizeof(alsa_formats)
+			/ sizeof(alsa_formats[0]);
 
 	audio = malloc(sizeof(LingotAudioHandler));
 	audio->read_buffer = NULL;
 	audio->audio_system = AUDIO_SYSTEM_ALSA;
+	audio->alsa_mmap = 0;
+	audio->alsa_poll_fds = NULL;
+	audio->alsa_poll_fds_count = 0;
 
 	if (sample_rate >= 44100) {
 		audio->read_buffer_size_samples = 1024;
@@ -76,6 +92,13 @@ LingotAudioHandler* lingot_audio_alsa_new(char* device, int sample_rate) {
 
 		strcpy(audio->device, device);
 
+		// we wait in poll(), the reads must not block.
+		if ((err = snd_pcm_nonblock(audio->capture_handle, 1)) < 0) {
+			snprintf(error_message, sizeof(error_message), "%s\n%s",
+			_("Cannot set non-blocking mode."), snd_strerror(err));
+			throw(error_message);
+		}
+
 		if ((err = snd_pcm_hw_params_malloc(&hw_params)) < 0) {
 			snprintf(error_message, sizeof(error_message), "%s\n%s",
 			_("Cannot initialize hardware parameter structure."),
@@ -91,20 +114,36 @@ LingotAudioHandler* lingot_audio_alsa_new(char* device, int sample_rate) {
 			throw(error_message);
 		}
 
-		if ((err = snd_pcm_hw_params_set_access(audio->capture_handle,
+		// if the device allows it, we convert the samples straight from its
+		// buffer, otherwise they are copied by snd_pcm_readi() first.
+		if (snd_pcm_hw_params_set_access(audio->capture_handle, hw_params,
+				SND_PCM_ACCESS_MMAP_INTERLEAVED) == 0) {
+			audio->alsa_mmap = 1;
+		} else if ((err = snd_pcm_hw_params_set_access(audio->capture_handle,
 				hw_params, SND_PCM_ACCESS_RW_INTERLEAVED)) < 0) {
 			snprintf(error_message, sizeof(error_message), "%s\n%s",
 			_("Cannot set access type."), snd_strerror(err));
 			throw(error_message);
 		}
 
+		// we capture in the format of the card if possible, the samples
+		// are converted in a single pass anyway.
+		for (format_index = 0; format_index < n_formats - 1; format_index++) {
+			if (snd_pcm_hw_params_test_format(audio->capture_handle,
+					hw_params, alsa_formats[format_index]) == 0) {
+				break;
+			}
+		}
+
 		if ((err = snd_pcm_hw_params_set_format(audio->capture_handle,
-				hw_params, sample_format)) < 0) {
+				hw_params, alsa_formats[format_index])) < 0) {
 			snprintf(error_message, sizeof(error_message), "%s\n%s",
 			_("Cannot set sample format."), snd_strerror(err));
 			throw(error_message);
 		}
 
+		audio->sample_format = sample_formats[format_index];
+
 		unsigned int rate = sample_rate;
 
 		if ((err = snd_pcm_hw_params_set_rate_near(audio->capture_handle,
@@ -116,19 +155,54 @@ LingotAudioHandler* lingot_audio_alsa_new(char* device, int sample_rate) {
 
 		audio->real_sample_rate = rate;
 
-		if ((err = snd_pcm_hw_params_set_channels(audio->capture_handle,
-				hw_params, channels)) < 0) {
+		// some cards can't capture a single channel, then we take the
+		// first one of each frame.
+		if ((err = snd_pcm_hw_params_set_channels_near(audio->capture_handle,
+				hw_params, &channels)) < 0) {
 			snprintf(error_message, sizeof(error_message), "%s\n%s",
 			_("Cannot set channel number."), snd_strerror(err));
 			throw(error_message);
 		}
 
+		// we process a period at a time.
+		period = (period_size > 0) ?
+				period_size : audio->read_buffer_size_samples;
+		if ((err = snd_pcm_hw_params_set_period_size_near(
+				audio->capture_handle, hw_params, &period, &dir)) < 0) {
+			snprintf(error_message, sizeof(error_message), "%s\n%s",
+			_("Cannot set period size."), snd_strerror(err));
+			throw(error_message);
+		}
+
+		if ((periods > 0)
+				&& ((err = snd_pcm_hw_params_set_periods_near(
+						audio->capture_handle, hw_params, &periods, &dir)) < 0)) {
+			snprintf(error_message, sizeof(error_message), "%s\n%s",
+			_("Cannot set number of periods."), snd_strerror(err));
+			throw(error_message);
+		}
+
 		if ((err = snd_pcm_hw_params(audio->capture_handle, hw_params)) < 0) {
 			snprintf(error_message, sizeof(error_message), "%s\n%s",
 			_("Cannot set parameters."), snd_strerror(err));
 			throw(error_message);
 		}
 
+		// the status carries timestamps only if asked, we need them to
+		// estimate the frames lost in an overrun.
+		if (((err = snd_pcm_sw_params_malloc(&sw_params)) < 0)
+				|| ((err = snd_pcm_sw_params_current(audio->capture_handle,
+						sw_params)) < 0)
+				|| ((err = snd_pcm_sw_params_set_tstamp_mode(
+						audio->capture_handle, sw_params,
+						SND_PCM_TSTAMP_ENABLE)) < 0)
+				|| ((err = snd_pcm_sw_params(audio->capture_handle, sw_params))
+						< 0)) {
+			snprintf(error_message, sizeof(error_message), "%s\n%s",
+			_("Cannot set software parameters."), snd_strerror(err));
+			throw(error_message);
+		}
+
 		if ((err = snd_pcm_prepare(audio->capture_handle)) < 0) {
 			snprintf(error_message, sizeof(error_message), "%s\n%s",
 			_("Cannot prepare audio interface for use."),
@@ -136,12 +210,29 @@ LingotAudioHandler* lingot_audio_alsa_new(char* device, int sample_rate) {
 			throw(error_message);
 		}
 
-		audio->bytes_per_sample = snd_pcm_format_size(sample_format, 1);
+		snd_pcm_hw_params_get_period_size(hw_params, &period, &dir);
+		snd_pcm_hw_params_get_periods(hw_params, &periods, &dir);
+		audio->read_buffer_size_samples = period;
+		audio->periods = periods;
+
+		audio->frame_channels = channels;
+		audio->bytes_per_sample = snd_pcm_format_size(
+				alsa_formats[format_index], 1);
 		audio->read_buffer_size_bytes = channels
 				* audio->read_buffer_size_samples * audio->bytes_per_sample;
 
-		audio->read_buffer = malloc(audio->read_buffer_size_bytes);
-		memset(audio->read_buffer, 0, audio->read_buffer_size_bytes);
+		// no intermediate buffer with mmap.
+		if (!audio->alsa_mmap) {
+			audio->read_buffer = malloc(audio->read_buffer_size_bytes);
+			memset(audio->read_buffer, 0, audio->read_buffer_size_bytes);
+		}
+
+		audio->alsa_poll_fds_count = snd_pcm_poll_descriptors_count(
+				audio->capture_handle);
+		audio->alsa_poll_fds = malloc(
+				audio->alsa_poll_fds_count * sizeof(struct pollfd));
+		snd_pcm_poll_descriptors(audio->capture_handle, audio->alsa_poll_fds,
+				audio->alsa_poll_fds_count);
 	}catch {
 		if (audio->capture_handle != NULL)
 			snd_pcm_close(audio->capture_handle);
@@ -152,6 +243,8 @@ LingotAudioHandler* lingot_audio_alsa_new(char* device, int sample_rate) {
 
 	if (hw_params != NULL)
 		snd_pcm_hw_params_free(hw_params);
+	if (sw_params != NULL)
+		snd_pcm_sw_params_free(sw_params);
 
 #	else
 	lingot_msg_add_error(
@@ -165,52 +258,160 @@ void lingot_audio_alsa_destroy(LingotAudioHandler* audio) {
 #	ifdef ALSA
 	if (audio != NULL) {
 		snd_pcm_close(audio->capture_handle);
+		free(audio->alsa_poll_fds);
 	}
 #	endif
 }
 
-int lingot_audio_alsa_read(LingotAudioHandler* audio) {
-	int samples_read = -1;
-#	ifdef ALSA
-	samples_read = snd_pcm_readi(audio->capture_handle, audio->read_buffer,
-			audio->read_buffer_size_samples);
-
-	if (samples_read < 0) {
-		char buff[250];
-		snprintf(buff, sizeof(buff), "%s\n%s",
-		_("Read from audio interface failed."),
-				snd_strerror(samples_read));
-		lingot_msg_add_error_with_code(buff, -samples_read);
-	} else {
-		int i;
-		// float point conversion
-		switch (sample_format) {
-		case SND_PCM_FORMAT_S16: {
-			int16_t* read_buffer = (int16_t*) audio->read_buffer;
-			for (i = 0; i < samples_read; i++) {
-				audio->flt_read_buffer[i] = read_buffer[i];
-			}
-			break;
-		}
-		case SND_PCM_FORMAT_FLOAT: {
-			float* read_buffer = (float*) audio->read_buffer;
-			for (i = 0; i < samples_read; i++) {
-				audio->flt_read_buffer[i] = read_buffer[i] * FLT_SAMPLE_SCALE;
-			}
-			break;
+#ifdef ALSA
+static void lingot_audio_alsa_read_error(int err) {
+	char buff[250];
+	snprintf(buff, sizeof(buff), "%s\n%s",
+	_("Read from audio interface failed."), snd_strerror(err));
+	lingot_msg_add_error_with_code(buff, -err);
+}
+
+// waits until there is a whole period to read, but not for much longer than
+// a period, so the reading thread can be stopped. Returns the available
+// frames, which may be less than a period, or a negative error code.
+static snd_pcm_sframes_t lingot_audio_alsa_wait(LingotAudioHandler* audio) {
+	snd_pcm_t* handle = audio->capture_handle;
+	snd_pcm_sframes_t avail;
+	const int timeout_ms = 1 + (2000 * audio->read_buffer_size_samples)
+			/ audio->real_sample_rate;
+
+	avail = snd_pcm_avail_update(handle);
+	if ((avail >= 0) && (avail < audio->read_buffer_size_samples)) {
+		if ((poll(audio->alsa_poll_fds, audio->alsa_poll_fds_count,
+				timeout_ms) < 0) && (errno != EINTR)) {
+			return -errno;
 		}
-		case SND_PCM_FORMAT_FLOAT64: {
-			double* read_buffer = (double*) audio->read_buffer;
-			for (i = 0; i < samples_read; i++) {
-				audio->flt_read_buffer[i] = read_buffer[i] * FLT_SAMPLE_SCALE;
+		avail = snd_pcm_avail_update(handle);
+	}
+
+	if ((avail > 0) && (avail > audio->read_buffer_size_samples)) {
+		avail = audio->read_buffer_size_samples;
+	}
+
+	return avail;
+}
+
+// converts the available samples, up to a period, straight from the device
+// buffer.
+static snd_pcm_sframes_t lingot_audio_alsa_read_mmap(LingotAudioHandler* audio) {
+	snd_pcm_t* handle = audio->capture_handle;
+	const snd_pcm_channel_area_t* areas;
+	snd_pcm_uframes_t offset;
+	snd_pcm_uframes_t frames;
+	snd_pcm_sframes_t avail;
+	snd_pcm_sframes_t committed;
+	const char* samples;
+	int err;
+
+	if ((avail = lingot_audio_alsa_wait(audio)) <= 0) {
+		return avail;
+	}
+
+	// we may get less samples than available at the end of the buffer, the
+	// rest will come in the next call.
+	frames = avail;
+	if ((err = snd_pcm_mmap_begin(handle, &areas, &offset, &frames)) < 0) {
+		return err;
+	}
+
+	samples = (const char*) areas[0].addr
+			+ (areas[0].first + offset * areas[0].step) / 8;
+	lingot_audio_format_convert(audio->sample_format, samples,
+			audio->frame_channels, 0, frames, audio->flt_read_buffer);
+
+	committed = snd_pcm_mmap_commit(handle, offset, frames);
+	if (committed < 0) {
+		return committed;
+	}
+
+	return ((snd_pcm_uframes_t) committed == frames) ? committed : -EPIPE;
+}
+
+// reads the available samples, up to a period, and converts them.
+static snd_pcm_sframes_t lingot_audio_alsa_read_rw(LingotAudioHandler* audio) {
+	snd_pcm_sframes_t frames;
+
+	if ((frames = lingot_audio_alsa_wait(audio)) <= 0) {
+		return frames;
+	}
+
+	frames = snd_pcm_readi(audio->capture_handle, audio->read_buffer, frames);
+	if (frames == -EAGAIN) {
+		return 0;
+	}
+
+	if (frames > 0) {
+		lingot_audio_format_convert(audio->sample_format, audio->read_buffer,
+				audio->frame_channels, 0, frames, audio->flt_read_buffer);
+	}
+
+	return frames;
+}
+
+// brings the capture back after an overrun or a suspension, accounting it.
+// Other errors can't be recovered.
+static int lingot_audio_alsa_recover(LingotAudioHandler* audio, int err) {
+	snd_pcm_status_t* status;
+	snd_timestamp_t now, xrun;
+	double lost_time;
+
+	if (err == -EPIPE) {
+		// the device stopped capturing when it overran, we'll lose all the
+		// frames since then until it restarts. The trigger timestamp is the
+		// one of the overrun, and the status one is now, as the timestamps
+		// were enabled on opening (they are zero otherwise). Stopping the
+		// process for a second (kill -STOP, then -CONT) should account
+		// about a second of frames.
+		snd_pcm_status_alloca(&status);
+		if ((snd_pcm_status(audio->capture_handle, status) == 0)
+				&& (snd_pcm_status_get_state(status) == SND_PCM_STATE_XRUN)) {
+			snd_pcm_status_get_tstamp(status, &now);
+			snd_pcm_status_get_trigger_tstamp(status, &xrun);
+			lost_time = (now.tv_sec - xrun.tv_sec)
+					+ 1e-6 * (now.tv_usec - xrun.tv_usec);
+			if (lost_time > 0.0) {
+				__atomic_add_fetch(&audio->lost_frames,
+						(unsigned long) (lost_time * audio->real_sample_rate),
+						__ATOMIC_RELAXED);
 			}
-			break;
-		}
-		default:
-			break;
 		}
+		__atomic_add_fetch(&audio->overruns, 1, __ATOMIC_RELAXED);
+	}
+
+	if (snd_pcm_recover(audio->capture_handle, err, 1) < 0) {
+		lingot_audio_alsa_read_error(err);
+		return -1;
+	}
+
+	__atomic_add_fetch(&audio->recovered_errors, 1, __ATOMIC_RELAXED);
+	return 0;
+}
+#endif
+
+int lingot_audio_alsa_read(LingotAudioHandler* audio) {
+	int samples_read = -1;
+#	ifdef ALSA
+	snd_pcm_sframes_t result = 0;
+
+	// the capture is started here, also after a recovery, as we don't
+	// block in a read that would start it.
+	if (snd_pcm_state(audio->capture_handle) == SND_PCM_STATE_PREPARED) {
+		result = snd_pcm_start(audio->capture_handle);
+	}
+
+	if (result >= 0) {
+		result = audio->alsa_mmap ?
+				lingot_audio_alsa_read_mmap(audio) :
+				lingot_audio_alsa_read_rw(audio);
 	}
 
+	samples_read =
+			(result >= 0) ? result : lingot_audio_alsa_recover(audio, result);
 #	endif
 
 	return samples_read;
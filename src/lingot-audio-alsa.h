@@ -27,7 +27,8 @@
 
 #include "lingot-audio.h"
 
-LingotAudioHandler* lingot_audio_alsa_new(char* device, int sample_rate);
+LingotAudioHandler* lingot_audio_alsa_new(char* device, int sample_rate,
+		unsigned int period_size, unsigned int periods);
 void lingot_audio_alsa_destroy(LingotAudioHandler*);
 int lingot_audio_alsa_read(LingotAudioHandler*);
 LingotAudioSystemProperties* lingot_audio_alsa_get_audio_system_properties(
@@ -0,0 +1,360 @@
+/*
+ * lingot, a musical instrument tuner.
+ *
+ * Copyright (C) 2004-2013  Ibán Cereijo Graña.
+ * Copyright (C) 2004-2008  Jairo Chapela Martínez.
+
+ *
+ * This file is part of lingot.
+ *
+ * lingot is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * lingot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with lingot; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "lingot-defs.h"
+#include "lingot-audio-file.h"
+#include "lingot-i18n.h"
+#include "lingot-msg.h"
+
+static const char* raw_format_names[] = { "s16", "s24", "s32", "float",
+		"double", NULL };
+static const sample_format_t raw_formats[] = { SAMPLE_FORMAT_S16,
+		SAMPLE_FORMAT_S24_3LE, SAMPLE_FORMAT_S32, SAMPLE_FORMAT_FLOAT32,
+		SAMPLE_FORMAT_FLOAT64 };
+
+static uint16_t lingot_audio_file_read_16(const unsigned char* p) {
+	return p[0] | (p[1] << 8);
+}
+
+static uint32_t lingot_audio_file_read_32(const unsigned char* p) {
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+// finds the format and the samples of a WAV file. Returns NULL on success,
+// or the reason why it cannot be read.
+static const char* lingot_audio_file_parse_wav(LingotAudioHandler* audio) {
+	LingotAudioFile* file = audio->file;
+	const unsigned char* map = file->map;
+	const unsigned char* chunk;
+	const unsigned char* fmt = NULL;
+	size_t offset = 12;
+	size_t available;
+	uint32_t chunk_size, fmt_size = 0, data_size = 0;
+	unsigned int tag, bits;
+
+	while ((offset + 8 <= file->map_size) && (file->data == NULL)) {
+		chunk = map + offset;
+		chunk_size = lingot_audio_file_read_32(chunk + 4);
+		// the format must be whole, we read all of it.
+		if (!memcmp(chunk, "fmt ", 4) && (chunk_size >= 16)
+				&& (offset + 8 + (size_t) chunk_size <= file->map_size)) {
+			fmt = chunk + 8;
+			fmt_size = chunk_size;
+		} else if (!memcmp(chunk, "data", 4)) {
+			file->data = chunk + 8;
+			data_size = chunk_size;
+		}
+		// chunks are word aligned.
+		offset += 8 + (size_t) chunk_size + (chunk_size & 1);
+	}
+
+	if ((fmt == NULL) || (file->data == NULL)) {
+		return _("Invalid WAV file.");
+	}
+
+	tag = lingot_audio_file_read_16(fmt);
+	audio->frame_channels = lingot_audio_file_read_16(fmt + 2);
+	audio->real_sample_rate = lingot_audio_file_read_32(fmt + 4);
+	bits = lingot_audio_file_read_16(fmt + 14);
+	if ((tag == 0xFFFE) && (fmt_size >= 26)) {
+		// WAVE_FORMAT_EXTENSIBLE, the tag is at the start of the subformat.
+		tag = lingot_audio_file_read_16(fmt + 24);
+	}
+
+	if ((tag == 1) && (bits == 16)) {
+		audio->sample_format = SAMPLE_FORMAT_S16;
+	} else if ((tag == 1) && (bits == 24)) {
+		audio->sample_format = SAMPLE_FORMAT_S24_3LE;
+	} else if ((tag == 1) && (bits == 32)) {
+		audio->sample_format = SAMPLE_FORMAT_S32;
+	} else if ((tag == 3) && (bits == 32)) {
+		audio->sample_format = SAMPLE_FORMAT_FLOAT32;
+	} else if ((tag == 3) && (bits == 64)) {
+		audio->sample_format = SAMPLE_FORMAT_FLOAT64;
+	} else {
+		return _("Unsupported WAV sample format.");
+	}
+
+	if ((audio->frame_channels == 0) || (audio->real_sample_rate == 0)) {
+		return _("Invalid WAV file.");
+	}
+
+	// the size of the data chunk is not reliable in unfinished recordings.
+	available = map + file->map_size - file->data;
+	if ((data_size == 0) || (data_size > available)) {
+		data_size = available;
+	}
+	file->frames = data_size
+			/ (audio->frame_channels
+					* lingot_audio_format_size(audio->sample_format));
+
+	return NULL;
+}
+
+LingotAudioHandler* lingot_audio_file_new(char* device, int sample_rate,
+		unsigned int period_size, unsigned int periods) {
+
+	LingotAudioHandler* audio = NULL;
+	LingotAudioFile* file = NULL;
+	const char* exception;
+	char error_message[1000];
+	char* options = strdup(device);
+	char* saveptr = NULL;
+	char* path;
+	char* option;
+	char* value;
+	struct stat file_stat;
+	unsigned int i;
+
+	audio = malloc(sizeof(LingotAudioHandler));
+	file = malloc(sizeof(LingotAudioFile));
+	audio->audio_system = AUDIO_SYSTEM_FILE;
+	audio->synth = NULL;
+	audio->file = file;
+	audio->read_buffer = NULL;
+	snprintf(audio->device, sizeof(audio->device), "%s", device);
+
+	file->fd = -1;
+	file->map = MAP_FAILED;
+	file->map_size = 0;
+	file->data = NULL;
+	file->frames = 0;
+	file->position = 0;
+	file->paced = 1;
+	file->loop = 0;
+
+	// raw files defaults.
+	audio->sample_format = SAMPLE_FORMAT_S16;
+	audio->frame_channels = 1;
+	audio->real_sample_rate = (sample_rate > 0) ? sample_rate : 44100;
+
+	try
+	{
+		path = strtok_r(options, ",", &saveptr);
+		if (path == NULL) {
+			throw(_("No audio file given."));
+		}
+
+		for (option = strtok_r(NULL, ", ", &saveptr); option != NULL;
+				option = strtok_r(NULL, ", ", &saveptr)) {
+			value = strchr(option, '=');
+			if (value != NULL) {
+				*value++ = '\0';
+			}
+
+			if (!strcmp(option, "loop") && (value == NULL)) {
+				file->loop = 1;
+			} else if (value == NULL) {
+				break;
+			} else if (!strcmp(option, "pace")) {
+				file->paced = !strcmp(value, "realtime");
+				if (!file->paced && strcmp(value, "fast")) {
+					break;
+				}
+			} else if (!strcmp(option, "format")) {
+				for (i = 0; raw_format_names[i] != NULL; i++) {
+					if (!strcmp(value, raw_format_names[i])) {
+						break;
+					}
+				}
+				if (raw_format_names[i] == NULL) {
+					break;
+				}
+				audio->sample_format = raw_formats[i];
+			} else if (!strcmp(option, "channels") && (atoi(value) > 0)) {
+				audio->frame_channels = atoi(value);
+			} else if (!strcmp(option, "rate") && (atoi(value) > 0)) {
+				audio->real_sample_rate = atoi(value);
+			} else {
+				break;
+			}
+		}
+
+		if (option != NULL) {
+			snprintf(error_message, sizeof(error_message),
+					_("Invalid audio file option '%s'"), option);
+			throw(error_message);
+		}
+
+		file->fd = open(path, O_RDONLY);
+		if ((file->fd < 0) || (fstat(file->fd, &file_stat) < 0)) {
+			snprintf(error_message, sizeof(error_message),
+					_("Cannot open audio file '%s'.\n%s"), path,
+					strerror(errno));
+			throw(error_message);
+		}
+
+		file->map_size = file_stat.st_size;
+		if (file->map_size > 0) {
+			file->map = mmap(NULL, file->map_size, PROT_READ, MAP_PRIVATE,
+					file->fd, 0);
+			if (file->map == MAP_FAILED) {
+				snprintf(error_message, sizeof(error_message),
+						_("Cannot open audio file '%s'.\n%s"), path,
+						strerror(errno));
+				throw(error_message);
+			}
+			// read once from start to end.
+			madvise(file->map, file->map_size, MADV_SEQUENTIAL);
+		}
+
+		if (file->map_size == 0) {
+			// nothing to read, see below.
+		} else if ((file->map_size >= 12) && !memcmp(file->map, "RIFF", 4)
+				&& !memcmp((char*) file->map + 8, "WAVE", 4)) {
+			exception = lingot_audio_file_parse_wav(audio);
+			if (exception != NULL) {
+				break;
+			}
+		} else {
+			file->data = file->map;
+			file->frames = file->map_size
+					/ (audio->frame_channels
+							* lingot_audio_format_size(audio->sample_format));
+		}
+
+		if (file->frames == 0) {
+			snprintf(error_message, sizeof(error_message),
+					_("No samples in audio file '%s'."), path);
+			throw(error_message);
+		}
+
+	}catch {
+		lingot_msg_add_error(exception);
+		lingot_audio_file_destroy(audio);
+		free(audio);
+		audio = NULL;
+	}
+
+	free(options);
+
+	if (audio != NULL) {
+		if (period_size > 0) {
+			audio->read_buffer_size_samples = period_size;
+		} else if (audio->real_sample_rate >= 44100) {
+			audio->read_buffer_size_samples = 1024;
+		} else if (audio->real_sample_rate >= 22050) {
+			audio->read_buffer_size_samples = 512;
+		} else {
+			audio->read_buffer_size_samples = 256;
+		}
+		audio->periods = (periods > 0) ? periods : 2;
+		audio->bytes_per_sample = lingot_audio_format_size(
+				audio->sample_format);
+		audio->read_buffer_size_bytes = audio->frame_channels
+				* audio->read_buffer_size_samples * audio->bytes_per_sample;
+	}
+
+	return audio;
+}
+
+void lingot_audio_file_destroy(LingotAudioHandler* audio) {
+	LingotAudioFile* file;
+
+	if ((audio != NULL) && (audio->file != NULL)) {
+		file = audio->file;
+		if (file->map != MAP_FAILED) {
+			munmap(file->map, file->map_size);
+		}
+		if (file->fd >= 0) {
+			close(file->fd);
+		}
+		free(file);
+		audio->file = NULL;
+	}
+}
+
+int lingot_audio_file_read(LingotAudioHandler* audio) {
+	LingotAudioFile* file = audio->file;
+	const size_t frame_size = audio->frame_channels * audio->bytes_per_sample;
+	int samples_read = 0;
+	unsigned long n;
+
+	if (file->paced) {
+		lingot_audio_pace(audio);
+	}
+
+	// a whole period, from the start again if we loop.
+	while (samples_read < audio->read_buffer_size_samples) {
+		if (file->position == file->frames) {
+			if (!file->loop) {
+				break;
+			}
+			file->position = 0;
+		}
+
+		n = audio->read_buffer_size_samples - samples_read;
+		if (n > file->frames - file->position) {
+			n = file->frames - file->position;
+		}
+
+		lingot_audio_format_convert(audio->sample_format,
+				file->data + file->position * frame_size,
+				audio->frame_channels, 0, n,
+				audio->flt_read_buffer + samples_read);
+		file->position += n;
+		samples_read += n;
+	}
+
+	if (samples_read == 0) {
+		lingot_msg_add_info(_("End of the audio file"));
+		samples_read = -1;
+	}
+
+	return samples_read;
+}
+
+LingotAudioSystemProperties* lingot_audio_file_get_audio_system_properties(
+		audio_system_t audio_system) {
+
+	LingotAudioSystemProperties* properties =
+			(LingotAudioSystemProperties*) malloc(
+					1 * sizeof(LingotAudioSystemProperties));
+
+	// the sample rate of a WAV file is the one in the file.
+	properties->forced_sample_rate = 0;
+	properties->n_sample_rates = 5;
+	properties->sample_rates = malloc(properties->n_sample_rates * sizeof(int));
+	properties->sample_rates[0] = 8000;
+	properties->sample_rates[1] = 11025;
+	properties->sample_rates[2] = 22050;
+	properties->sample_rates[3] = 44100;
+	properties->sample_rates[4] = 48000;
+
+	// the file name is typed in.
+	properties->n_devices = 0;
+	properties->devices = NULL;
+
+	return properties;
+}
@@ -0,0 +1,69 @@
+/*
+ * lingot, a musical instrument tuner.
+ *
+ * Copyright (C) 2004-2013  Ibán Cereijo Graña.
+ * Copyright (C) 2004-2008  Jairo Chapela Martínez.
+
+ *
+ * This file is part of lingot.
+ *
+ * lingot is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * lingot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with lingot; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef __LINGOT_AUDIO_FILE_H__
+#define __LINGOT_AUDIO_FILE_H__
+
+#include <stddef.h>
+
+#include "lingot-audio.h"
+
+// audio source reading a WAV or raw PCM file, to replay recorded material
+// through the same path as a capture. The device string is the file name,
+// optionally followed by comma separated options:
+//
+//   pace=realtime|fast        paced at the sample rate or as fast as possible
+//   loop                      starts over at the end of the file
+//   format=s16|s24|s32|float|double    raw files only (s16)
+//   channels=<n>              raw files only (1)
+//   rate=<Hz>                 raw files only (the requested sample rate)
+//
+// Files starting with a RIFF/WAVE header are read as WAV, any other file as
+// raw PCM. The file is mapped in memory and the samples are converted
+// straight from the mapping, one period at a time.
+
+typedef struct _LingotAudioFile LingotAudioFile;
+
+struct _LingotAudioFile {
+
+	int fd;
+	void* map;
+	size_t map_size;
+
+	const unsigned char* data; // first frame
+	unsigned long frames;
+	unsigned long position; // next frame to read
+
+	int paced;
+	int loop;
+};
+
+LingotAudioHandler* lingot_audio_file_new(char* device, int sample_rate,
+		unsigned int period_size, unsigned int periods);
+void lingot_audio_file_destroy(LingotAudioHandler*);
+int lingot_audio_file_read(LingotAudioHandler*);
+LingotAudioSystemProperties* lingot_audio_file_get_audio_system_properties(
+		audio_system_t);
+
+#endif
@@ -0,0 +1,265 @@
+/*
+ * lingot, a musical instrument tuner.
+ *
+ * Copyright (C) 2004-2013  Ibán Cereijo Graña.
+ * Copyright (C) 2004-2008  Jairo Chapela Martínez.
+
+ *
+ * This file is part of lingot.
+ *
+ * lingot is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * lingot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with lingot; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "lingot-audio-format.h"
+
+// on x86 every kernel is built for AVX2 and for the baseline, and the
+// dynamic loader picks the right one for the CPU.
+#if defined(__x86_64__) && defined(__GNUC__) && (__GNUC__ >= 6) \
+	&& defined(__linux__)
+#define LINGOT_AUDIO_FORMAT_DISPATCH __attribute__ ((target_clones ("avx2", "default")))
+#else
+#define LINGOT_AUDIO_FORMAT_DISPATCH
+#endif
+
+// 8 samples at once.
+typedef int16_t lingot_audio_format_v8s __attribute__ ((vector_size (8 * sizeof(int16_t))));
+typedef int32_t lingot_audio_format_v8i __attribute__ ((vector_size (8 * sizeof(int32_t))));
+typedef float lingot_audio_format_v8f __attribute__ ((vector_size (8 * sizeof(float))));
+typedef double lingot_audio_format_v8d __attribute__ ((vector_size (8 * sizeof(double))));
+typedef FLT lingot_audio_format_v8 __attribute__ ((vector_size (8 * sizeof(FLT))));
+typedef uint8_t lingot_audio_format_v32b __attribute__ ((vector_size (32)));
+
+// scales to FLT_SAMPLE_SCALE full scale. The 24 bits samples are converted
+// as the upper bytes of a 32 bits one.
+static const FLT lingot_audio_format_scale_s32 = 1.0 / 65536.0;
+static const FLT lingot_audio_format_scale_float = FLT_SAMPLE_SCALE;
+
+// the samples of files are only aligned to 2 bytes, so all of them are
+// loaded through memcpy, which compiles to a plain load where it is allowed.
+static inline int16_t lingot_audio_format_s16(const uint8_t* in) {
+	int16_t x;
+	memcpy(&x, in, sizeof(x));
+	return x;
+}
+
+static inline int32_t lingot_audio_format_s24(const uint8_t* in) {
+	return (int32_t) (((uint32_t) in[0] << 8) | ((uint32_t) in[1] << 16)
+			| ((uint32_t) in[2] << 24));
+}
+
+static inline int32_t lingot_audio_format_s32(const uint8_t* in) {
+	int32_t x;
+	memcpy(&x, in, sizeof(x));
+	return x;
+}
+
+static inline float lingot_audio_format_float32(const uint8_t* in) {
+	float x;
+	memcpy(&x, in, sizeof(x));
+	return x;
+}
+
+static inline double lingot_audio_format_float64(const uint8_t* in) {
+	double x;
+	memcpy(&x, in, sizeof(x));
+	return x;
+}
+
+LINGOT_AUDIO_FORMAT_DISPATCH
+static void lingot_audio_format_convert_s16(const uint8_t* in,
+		unsigned int n, FLT* out) {
+	lingot_audio_format_v8s x;
+	lingot_audio_format_v8 y;
+	unsigned int i;
+
+	for (i = 0; i + 8 <= n; i += 8) {
+		memcpy(&x, &in[2 * i], sizeof(x));
+		y = __builtin_convertvector(x, lingot_audio_format_v8);
+		memcpy(&out[i], &y, sizeof(y));
+	}
+	for (; i < n; i++) {
+		out[i] = lingot_audio_format_s16(&in[2 * i]);
+	}
+}
+
+LINGOT_AUDIO_FORMAT_DISPATCH
+static void lingot_audio_format_convert_s24_3le(const uint8_t* in,
+		unsigned int n, FLT* out) {
+	unsigned int i = 0;
+
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+	// the 3 bytes of each sample go to the upper bytes of a 32 bits lane,
+	// the lowest one is taken from the zero vector.
+	static const lingot_audio_format_v32b zero = { 0 };
+	static const lingot_audio_format_v32b mask = { //
+			32, 0, 1, 2, 32, 3, 4, 5, 32, 6, 7, 8, 32, 9, 10, 11, //
+					32, 12, 13, 14, 32, 15, 16, 17, 32, 18, 19, 20, 32, 21, 22, 23 };
+	lingot_audio_format_v32b x;
+	lingot_audio_format_v8 y;
+
+	// 8 samples are 24 bytes, but we load 32, so we stop before the end.
+	for (; i + 11 <= n; i += 8) {
+		memcpy(&x, &in[3 * i], sizeof(x));
+		x = __builtin_shuffle(x, zero, mask);
+		y = __builtin_convertvector((lingot_audio_format_v8i) x,
+				lingot_audio_format_v8);
+		y *= lingot_audio_format_scale_s32;
+		memcpy(&out[i], &y, sizeof(y));
+	}
+#endif
+
+	for (; i < n; i++) {
+		out[i] = lingot_audio_format_s24(&in[3 * i])
+				* lingot_audio_format_scale_s32;
+	}
+}
+
+LINGOT_AUDIO_FORMAT_DISPATCH
+static void lingot_audio_format_convert_s32(const uint8_t* in,
+		unsigned int n, FLT* out) {
+	lingot_audio_format_v8i x;
+	lingot_audio_format_v8 y;
+	unsigned int i;
+
+	for (i = 0; i + 8 <= n; i += 8) {
+		memcpy(&x, &in[4 * i], sizeof(x));
+		y = __builtin_convertvector(x, lingot_audio_format_v8);
+		y *= lingot_audio_format_scale_s32;
+		memcpy(&out[i], &y, sizeof(y));
+	}
+	for (; i < n; i++) {
+		out[i] = lingot_audio_format_s32(&in[4 * i])
+				* lingot_audio_format_scale_s32;
+	}
+}
+
+LINGOT_AUDIO_FORMAT_DISPATCH
+static void lingot_audio_format_convert_float32(const uint8_t* in,
+		unsigned int n, FLT* out) {
+	lingot_audio_format_v8f x;
+	lingot_audio_format_v8 y;
+	unsigned int i;
+
+	for (i = 0; i + 8 <= n; i += 8) {
+		memcpy(&x, &in[4 * i], sizeof(x));
+		y = __builtin_convertvector(x, lingot_audio_format_v8);
+		y *= lingot_audio_format_scale_float;
+		memcpy(&out[i], &y, sizeof(y));
+	}
+	for (; i < n; i++) {
+		out[i] = lingot_audio_format_float32(&in[4 * i])
+				* lingot_audio_format_scale_float;
+	}
+}
+
+LINGOT_AUDIO_FORMAT_DISPATCH
+static void lingot_audio_format_convert_float64(const uint8_t* in,
+		unsigned int n, FLT* out) {
+	lingot_audio_format_v8d x;
+	lingot_audio_format_v8 y;
+	unsigned int i;
+
+	for (i = 0; i + 8 <= n; i += 8) {
+		memcpy(&x, &in[8 * i], sizeof(x));
+		y = __builtin_convertvector(x, lingot_audio_format_v8);
+		y *= lingot_audio_format_scale_float;
+		memcpy(&out[i], &y, sizeof(y));
+	}
+	for (; i < n; i++) {
+		out[i] = lingot_audio_format_float64(&in[8 * i])
+				* lingot_audio_format_scale_float;
+	}
+}
+
+// channel selection out of interleaved frames. The loads are strided, so
+// there is little to gain from explicit vectors here, but we still do it
+// in a single pass.
+LINGOT_AUDIO_FORMAT_DISPATCH
+static void lingot_audio_format_convert_interleaved(sample_format_t format,
+		const void* in, unsigned int channels, unsigned int channel,
+		unsigned int n, FLT* out) {
+	const unsigned int size = lingot_audio_format_size(format);
+	const unsigned int stride = size * channels;
+	const uint8_t* x = (const uint8_t*) in + size * channel;
+	unsigned int i;
+
+	switch (format) {
+	case SAMPLE_FORMAT_S16:
+		for (i = 0; i < n; i++) {
+			out[i] = lingot_audio_format_s16(&x[i * stride]);
+		}
+		break;
+	case SAMPLE_FORMAT_S24_3LE:
+		for (i = 0; i < n; i++) {
+			out[i] = lingot_audio_format_s24(&x[i * stride])
+					* lingot_audio_format_scale_s32;
+		}
+		break;
+	case SAMPLE_FORMAT_S32:
+		for (i = 0; i < n; i++) {
+			out[i] = lingot_audio_format_s32(&x[i * stride])
+					* lingot_audio_format_scale_s32;
+		}
+		break;
+	case SAMPLE_FORMAT_FLOAT32:
+		for (i = 0; i < n; i++) {
+			out[i] = lingot_audio_format_float32(&x[i * stride])
+					* lingot_audio_format_scale_float;
+		}
+		break;
+	case SAMPLE_FORMAT_FLOAT64:
+		for (i = 0; i < n; i++) {
+			out[i] = lingot_audio_format_float64(&x[i * stride])
+					* lingot_audio_format_scale_float;
+		}
+		break;
+	}
+}
+
+unsigned int lingot_audio_format_size(sample_format_t format) {
+	static const unsigned int sizes[] = { 2, 3, 4, 4, 8 };
+	return sizes[format];
+}
+
+void lingot_audio_format_convert(sample_format_t format, const void* in,
+		unsigned int channels, unsigned int channel, unsigned int n, FLT* out) {
+
+	if (channels > 1) {
+		lingot_audio_format_convert_interleaved(format, in, channels, channel,
+				n, out);
+		return;
+	}
+
+	switch (format) {
+	case SAMPLE_FORMAT_S16:
+		lingot_audio_format_convert_s16(in, n, out);
+		break;
+	case SAMPLE_FORMAT_S24_3LE:
+		lingot_audio_format_convert_s24_3le(in, n, out);
+		break;
+	case SAMPLE_FORMAT_S32:
+		lingot_audio_format_convert_s32(in, n, out);
+		break;
+	case SAMPLE_FORMAT_FLOAT32:
+		lingot_audio_format_convert_float32(in, n, out);
+		break;
+	case SAMPLE_FORMAT_FLOAT64:
+		lingot_audio_format_convert_float64(in, n, out);
+		break;
+	}
+}
@@ -0,0 +1,57 @@
+/*
+ * lingot, a musical instrument tuner.
+ *
+ * Copyright (C) 2004-2013  Ibán Cereijo Graña.
+ * Copyright (C) 2004-2008  Jairo Chapela Martínez.
+
+ *
+ * This file is part of lingot.
+ *
+ * lingot is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * lingot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with lingot; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef __LINGOT_AUDIO_FORMAT_H__
+#define __LINGOT_AUDIO_FORMAT_H__
+
+#include "lingot-defs.h"
+
+#define FLT_SAMPLE_SCALE	32767.0
+
+/*
+ Conversion of the captured samples to FLT, shared by all the audio systems.
+
+ The samples are scaled so the full scale is FLT_SAMPLE_SCALE, whatever the
+ format. One channel can be taken out of interleaved frames in the same
+ pass. The kernels are vectorized, and on x86 the widest version the CPU
+ supports is selected at runtime.
+ */
+
+typedef enum sample_format_t {
+	SAMPLE_FORMAT_S16 = 0, // native endian.
+	SAMPLE_FORMAT_S24_3LE = 1, // packed in 3 bytes, little endian.
+	SAMPLE_FORMAT_S32 = 2, // native endian.
+	SAMPLE_FORMAT_FLOAT32 = 3, // native endian, full scale is 1.0.
+	SAMPLE_FORMAT_FLOAT64 = 4 // native endian, full scale is 1.0.
+} sample_format_t;
+
+// bytes per sample of the given format.
+unsigned int lingot_audio_format_size(sample_format_t format);
+
+// converts n frames of 'channels' interleaved samples in the given format,
+// taking only the given channel.
+void lingot_audio_format_convert(sample_format_t format, const void* in,
+		unsigned int channels, unsigned int channel, unsigned int n, FLT* out);
+
+#endif //__LINGOT_AUDIO_FORMAT_H__
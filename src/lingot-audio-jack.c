@@ -28,30 +28,62 @@
 #include "lingot-audio-jack.h"
 #include "lingot-i18n.h"
 #include "lingot-msg.h"
+#include "lingot-rt-debug.h"
 
 #ifdef JACK
 #include <jack/jack.h>
 
 // persistent JACK client to obtain hardware parameters
 jack_client_t* client = NULL;
-pthread_mutex_t stop_mutex = PTHREAD_MUTEX_INITIALIZER;
 
 // this array allows us to reconnect the client to the last ports it was
 // connected in a previous session
 #define MAX_LAST_PORTS 10
 char last_ports[MAX_LAST_PORTS][80];
 
+/*
+ The process callbacks run in the JACK realtime thread, so they must not
+ block: no locks and no allocation. The running flag is atomic, and
+ jack_deactivate() waits for the current cycle before returning, so the
+ handler can't be stopped under our feet. The samples go to the core
+ through its lock-free ring buffer.
+ */
+
 int lingot_audio_jack_process(jack_nframes_t nframes, void* param) {
 	LingotAudioHandler* audio = param;
-	audio->nframes = nframes;
 
-	pthread_mutex_lock(&stop_mutex);
-	if (audio->running) {
+	lingot_rt_debug_enter();
+	if (__atomic_load_n(&audio->running, __ATOMIC_ACQUIRE)) {
+		audio->nframes = nframes;
 		lingot_audio_jack_read(audio);
 		audio->process_callback(audio->flt_read_buffer,
 				audio->read_buffer_size_samples, audio->process_callback_arg);
 	}
-	pthread_mutex_unlock(&stop_mutex);
+	lingot_rt_debug_leave();
+
+	return 0;
+}
+
+// multi-channel capture, each port buffer goes straight to its stream, all
+// of them in the same period and the same JACK thread.
+int lingot_audio_jack_process_multichannel(jack_nframes_t nframes,
+		void* param) {
+	LingotAudioHandler* audio = param;
+	unsigned int channel;
+	float* in;
+
+	lingot_rt_debug_enter();
+	if (__atomic_load_n(&audio->running, __ATOMIC_ACQUIRE)) {
+		for (channel = 0; channel < audio->channels; channel++) {
+			in = jack_port_get_buffer(audio->jack_input_ports[channel],
+					nframes);
+			lingot_audio_format_convert(audio->sample_format, in, 1, 0,
+					nframes, audio->flt_read_buffer);
+			audio->process_callback(audio->flt_read_buffer, nframes,
+					audio->process_callback_args[channel]);
+		}
+	}
+	lingot_rt_debug_leave();
 
 	return 0;
 }
@@ -61,13 +93,25 @@ int lingot_audio_jack_process(jack_nframes_t nframes, void* param) {
 void lingot_audio_jack_shutdown(void* param) {
 	LingotAudioHandler* audio = param;
 	lingot_msg_add_error(_("Missing connection with JACK audio server"));
-	pthread_mutex_lock(&stop_mutex);
-	audio->interrupted = 1;
-	pthread_mutex_unlock(&stop_mutex);
+	__atomic_store_n(&audio->interrupted, 1, __ATOMIC_RELEASE);
+}
+
+// the server recovers from its own xruns, we only account for them. The
+// delay reported by the server gives an estimation of the frames lost.
+static int lingot_audio_jack_xrun(void* param) {
+	LingotAudioHandler* audio = param;
+	unsigned long lost = (unsigned long) (jack_get_xrun_delayed_usecs(
+			audio->jack_client) * 1e-6 * audio->real_sample_rate);
+	__atomic_add_fetch(&audio->overruns, 1, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&audio->recovered_errors, 1, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&audio->lost_frames, lost, __ATOMIC_RELAXED);
+	return 0;
 }
 #endif
 
-LingotAudioHandler* lingot_audio_jack_new(char* device, int sample_rate) {
+// opens the client and registers one input port per channel.
+static LingotAudioHandler* lingot_audio_jack_open(char* device, int sample_rate,
+		unsigned int channels, unsigned int period_size) {
 
 	LingotAudioHandler* audio = NULL;
 
@@ -80,13 +124,23 @@ LingotAudioHandler* lingot_audio_jack_new(char* device, int sample_rate) {
 	jack_options_t options = JackNoStartServer;
 	jack_status_t status;
 
+	// the ports are indexed by channel, starting at the first one.
+	if (channels < 1) {
+		lingot_msg_add_error(_("At least one JACK input port is needed"));
+		return NULL;
+	}
+
 	audio = malloc(sizeof(LingotAudioHandler));
 	strcpy(audio->device, "");
 
 	audio->read_buffer = 0x0;
 	audio->read_buffer_size_bytes = -1;
 	audio->bytes_per_sample = -1;
+	audio->sample_format = SAMPLE_FORMAT_FLOAT32;
+	audio->frame_channels = 1;
 	audio->audio_system = AUDIO_SYSTEM_JACK;
+	audio->channels = channels;
+	audio->jack_input_ports = calloc(channels, sizeof(jack_port_t*));
 	audio->jack_client = jack_client_open(client_name, options, &status,
 			server_name);
 
@@ -105,26 +159,58 @@ LingotAudioHandler* lingot_audio_jack_new(char* device, int sample_rate) {
 		}
 
 		jack_on_shutdown(audio->jack_client, lingot_audio_jack_shutdown, audio);
+		jack_set_xrun_callback(audio->jack_client, lingot_audio_jack_xrun,
+				audio);
 
 		audio->real_sample_rate = jack_get_sample_rate(audio->jack_client);
+
+		// the period belongs to the server and is shared by all its clients,
+		// we only ask for a different one if it was requested. The client
+		// gets each period as soon as it is captured.
+		if ((period_size > 0)
+				&& (period_size != jack_get_buffer_size(audio->jack_client))
+				&& jack_set_buffer_size(audio->jack_client, period_size)) {
+			fprintf(stderr, "JACK: cannot set the period size to %u\n",
+					period_size);
+		}
 		audio->read_buffer_size_samples = jack_get_buffer_size(
 				audio->jack_client);
+		audio->periods = 1;
 
 		//	printf("engine sample rate: %" PRIu32 "\n", jack_get_sample_rate(
 		//			audio->jack_client));
 		//	printf("buffer size: %" PRIu32 "\n", jack_get_buffer_size(
 		//			audio->jack_client));
 
-		audio->jack_input_port = jack_port_register(audio->jack_client, "input",
-		JACK_DEFAULT_AUDIO_TYPE, JackPortIsInput, 0);
+		if (channels == 1) {
+			audio->jack_input_ports[0] = jack_port_register(audio->jack_client,
+					"input", JACK_DEFAULT_AUDIO_TYPE, JackPortIsInput, 0);
+		} else {
+			unsigned int i;
+			char port_name[32];
+			for (i = 0; i < channels; i++) {
+				snprintf(port_name, sizeof(port_name), "input_%u", i + 1);
+				audio->jack_input_ports[i] = jack_port_register(
+						audio->jack_client, port_name, JACK_DEFAULT_AUDIO_TYPE,
+						JackPortIsInput, 0);
+				if (audio->jack_input_ports[i] == NULL) {
+					break;
+				}
+			}
+		}
+		audio->jack_input_port = audio->jack_input_ports[0];
 
-		if ((audio->jack_input_port == NULL)) {
+		if ((audio->jack_input_ports[channels - 1] == NULL)) {
 			throw(_("No more JACK ports available"));
 		}
 
 		snprintf(audio->device, sizeof(audio->device), "%s", device);
 
 	}catch {
+		if (audio->jack_client != NULL) {
+			jack_client_close(audio->jack_client);
+		}
+		free(audio->jack_input_ports);
 		free(audio);
 		audio = NULL;
 		lingot_msg_add_error(exception);
@@ -141,6 +227,16 @@ LingotAudioHandler* lingot_audio_jack_new(char* device, int sample_rate) {
 	return audio;
 }
 
+LingotAudioHandler* lingot_audio_jack_new(char* device, int sample_rate,
+		unsigned int period_size) {
+	return lingot_audio_jack_open(device, sample_rate, 1, period_size);
+}
+
+LingotAudioHandler* lingot_audio_jack_new_multichannel(char* device,
+		int sample_rate, unsigned int channels) {
+	return lingot_audio_jack_open(device, sample_rate, channels, 0);
+}
+
 void lingot_audio_jack_destroy(LingotAudioHandler* audio) {
 #	ifdef JACK
 	if (audio != NULL) {
@@ -148,16 +244,16 @@ void lingot_audio_jack_destroy(LingotAudioHandler* audio) {
 		//		jack_deactivate(audio->jack_client);
 		jack_client_close(audio->jack_client);
 		client = NULL;
+		free(audio->jack_input_ports);
 	}
 #	endif
 }
 
 int lingot_audio_jack_read(LingotAudioHandler* audio) {
 #	ifdef JACK
-	register int i;
 	float* in = jack_port_get_buffer(audio->jack_input_port, audio->nframes);
-	for (i = 0; i < audio->nframes; i++)
-		audio->flt_read_buffer[i] = in[i] * FLT_SAMPLE_SCALE;
+	lingot_audio_format_convert(audio->sample_format, in, 1, 0,
+			audio->nframes, audio->flt_read_buffer);
 	return 0;
 #	else
 	return -1;
@@ -273,8 +369,10 @@ int lingot_audio_jack_start(LingotAudioHandler* audio) {
 	int index = 0;
 	const char **ports = NULL;
 	const char* exception;
-	jack_set_process_callback(audio->jack_client, lingot_audio_jack_process,
-			audio);
+	jack_set_process_callback(audio->jack_client,
+			(audio->channels > 1) ?
+					lingot_audio_jack_process_multichannel :
+					lingot_audio_jack_process, audio);
 
 	try
 	{
@@ -288,7 +386,29 @@ int lingot_audio_jack_start(LingotAudioHandler* audio) {
 			throw(_("No active capture ports"));
 		}
 
-		if (!strcmp(audio->device, "default")) {
+		if (audio->channels > 1) {
+			// the channels are connected to consecutive capture ports,
+			// from the first one or from the requested one.
+			unsigned int i;
+			if (strcmp(audio->device, "default")) {
+				while (ports[index] && strcmp(ports[index], audio->device)) {
+					index++;
+				}
+				if (ports[index] == NULL) {
+					char buff[512];
+					snprintf(buff, sizeof(buff),
+							_("Cannot connect to requested port '%s'"),
+							audio->device);
+					throw(buff);
+				}
+			}
+			for (i = 0; (i < audio->channels) && ports[index + i]; i++) {
+				if (jack_connect(audio->jack_client, ports[index + i],
+						jack_port_name(audio->jack_input_ports[i]))) {
+					throw(_("Cannot connect input ports"));
+				}
+			}
+		} else if (!strcmp(audio->device, "default")) {
 			// try to connect the client to the ports is was connected before
 			int j = 0;
 			int connections = 0;
@@ -362,9 +482,11 @@ void lingot_audio_jack_stop(LingotAudioHandler* audio) {
 		}
 	}
 
-	pthread_mutex_lock(&stop_mutex);
+	// the process callback may be running, it will see the running flag
+	// cleared in its next cycle, and jack_deactivate() waits for it.
+	__atomic_store_n(&audio->running, 0, __ATOMIC_RELEASE);
 	jack_deactivate(audio->jack_client);
-	pthread_mutex_unlock(&stop_mutex);
+	lingot_rt_debug_report();
 #	else
 	lingot_msg_add_error(
 			_("The application has not been built with JACK support"));
@@ -27,7 +27,10 @@
 
 #include "lingot-audio.h"
 
-LingotAudioHandler* lingot_audio_jack_new(char* device, int sample_rate);
+LingotAudioHandler* lingot_audio_jack_new(char* device, int sample_rate,
+		unsigned int period_size);
+LingotAudioHandler* lingot_audio_jack_new_multichannel(char* device,
+		int sample_rate, unsigned int channels);
 void lingot_audio_jack_destroy(LingotAudioHandler*);
 int lingot_audio_jack_read(LingotAudioHandler*);
 LingotAudioSystemProperties* lingot_audio_jack_get_audio_system_properties(
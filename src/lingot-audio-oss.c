@@ -40,7 +40,8 @@
 #include <stdlib.h>
 #endif
 
-LingotAudioHandler* lingot_audio_oss_new(char* device, int sample_rate) {
+LingotAudioHandler* lingot_audio_oss_new(char* device, int sample_rate,
+		unsigned int period_size, unsigned int periods) {
 
 	LingotAudioHandler* audio = NULL;
 
@@ -55,6 +56,7 @@ LingotAudioHandler* lingot_audio_oss_new(char* device, int sample_rate) {
 
 	char error_message[100];
 	const char* exception;
+	audio_buf_info buffer_info;
 
 	audio = malloc(sizeof(LingotAudioHandler));
 
@@ -94,14 +96,19 @@ LingotAudioHandler* lingot_audio_oss_new(char* device, int sample_rate) {
 			throw(error_message);
 		}
 
+		// the fragments are the periods of OSS, a power of two in bytes.
 		int fragment_size = 1;
 		int DMA_buffer_size = 512;
 		int param = 0;
 
+		if (period_size > 0) {
+			DMA_buffer_size = period_size * channels * 2;
+		}
+
 		for (param = 0; fragment_size < DMA_buffer_size; param++)
 			fragment_size <<= 1;
 
-		param |= 0x00ff0000;
+		param |= ((periods > 0) ? periods : 0x00ff) << 16;
 
 		if (ioctl(audio->dsp, SNDCTL_DSP_SETFRAGMENT, &param) < 0) {
 			snprintf(error_message, sizeof(error_message), "%s\n%s",
@@ -116,9 +123,27 @@ LingotAudioHandler* lingot_audio_oss_new(char* device, int sample_rate) {
 		}
 
 		audio->real_sample_rate = sample_rate;
+		audio->sample_format = SAMPLE_FORMAT_S16;
+		audio->frame_channels = channels;
 		audio->bytes_per_sample = 2;
-		audio->read_buffer_size_bytes = audio->read_buffer_size_samples
-				* audio->bytes_per_sample;
+
+		// we read a fragment at a time when it was requested. The buffer
+		// is reported in blocks of the size we read.
+		if (ioctl(audio->dsp, SNDCTL_DSP_GETISPACE, &buffer_info) < 0) {
+			buffer_info.fragsize = fragment_size;
+			buffer_info.fragstotal = param >> 16;
+		}
+		if (period_size > 0) {
+			audio->read_buffer_size_samples = buffer_info.fragsize
+					/ (channels * audio->bytes_per_sample);
+		}
+		audio->read_buffer_size_bytes = channels
+				* audio->read_buffer_size_samples * audio->bytes_per_sample;
+		audio->periods = buffer_info.fragstotal * buffer_info.fragsize
+				/ audio->read_buffer_size_bytes;
+		if (audio->periods < 1) {
+			audio->periods = 1;
+		}
 
 		audio->read_buffer = malloc(audio->read_buffer_size_bytes);
 		memset(audio->read_buffer, 0, audio->read_buffer_size_bytes);
@@ -162,13 +187,11 @@ int lingot_audio_oss_read(LingotAudioHandler* audio) {
 		lingot_msg_add_error(buff);
 	} else {
 
-		samples_read = bytes_read / audio->bytes_per_sample;
+		samples_read = bytes_read
+				/ (audio->frame_channels * audio->bytes_per_sample);
 		// float point conversion
-		int i;
-		const int16_t* read_buffer = (int16_t*) audio->read_buffer;
-		for (i = 0; i < samples_read; i++) {
-			audio->flt_read_buffer[i] = read_buffer[i];
-		}
+		lingot_audio_format_convert(audio->sample_format, audio->read_buffer,
+				audio->frame_channels, 0, samples_read, audio->flt_read_buffer);
 	}
 #endif
 
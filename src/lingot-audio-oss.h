@@ -27,7 +27,8 @@
 
 #include "lingot-audio.h"
 
-LingotAudioHandler* lingot_audio_oss_new(char* device, int sample_rate);
+LingotAudioHandler* lingot_audio_oss_new(char* device, int sample_rate,
+		unsigned int period_size, unsigned int periods);
 void lingot_audio_oss_destroy(LingotAudioHandler*);
 int lingot_audio_oss_read(LingotAudioHandler*);
 LingotAudioSystemProperties* lingot_audio_oss_get_audio_system_properties(
@@ -23,6 +23,8 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "lingot-defs.h"
 #include "lingot-audio-pulseaudio.h"
@@ -34,18 +36,157 @@
 #endif
 
 #ifdef PULSEAUDIO
-static int channels = 1;
-static pa_sample_spec ss;
+// the stream is read in the mainloop thread, as soon as the server hands
+// each fragment, and every callback runs with the mainloop lock held.
+static void lingot_audio_pulseaudio_stream_read_callback(pa_stream* stream,
+		size_t nbytes, void* userdata) {
+	LingotAudioHandler* audio = userdata;
+	const void* data;
+	const size_t frame_size = audio->frame_channels * audio->bytes_per_sample;
+	unsigned int samples, block;
+	const char* in;
+
+	while (pa_stream_readable_size(stream) > 0) {
+		if (pa_stream_peek(stream, &data, &nbytes) < 0) {
+			break;
+		}
+
+		if (nbytes == 0) {
+			break;
+		}
+
+		samples = nbytes / frame_size;
+		if (data == NULL) {
+			// a hole in the stream.
+			__atomic_add_fetch(&audio->lost_frames, samples, __ATOMIC_RELAXED);
+		} else if (__atomic_load_n(&audio->running, __ATOMIC_ACQUIRE)) {
+			// fragments can be larger than the buffer we convert into.
+			for (in = data; samples > 0; samples -= block) {
+				block = samples;
+				if (block > audio->read_buffer_size_samples) {
+					block = audio->read_buffer_size_samples;
+				}
+				lingot_audio_format_convert(audio->sample_format, in,
+						audio->frame_channels, 0, block,
+						audio->flt_read_buffer);
+				audio->process_callback(audio->flt_read_buffer, block,
+						audio->process_callback_arg);
+				in += block * frame_size;
+			}
+		}
+
+		pa_stream_drop(stream);
+	}
+}
+
+// the server has overwritten samples we did not read in time, the stream
+// goes on by itself.
+static void lingot_audio_pulseaudio_stream_overflow_callback(
+		pa_stream* stream, void* userdata) {
+	LingotAudioHandler* audio = userdata;
+	__atomic_add_fetch(&audio->overruns, 1, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&audio->recovered_errors, 1, __ATOMIC_RELAXED);
+}
+
+static void lingot_audio_pulseaudio_stream_state_callback(pa_stream* stream,
+		void* userdata) {
+	LingotAudioHandler* audio = userdata;
+
+	switch (pa_stream_get_state(stream)) {
+	case PA_STREAM_FAILED:
+		if (__atomic_load_n(&audio->running, __ATOMIC_ACQUIRE)) {
+			lingot_msg_add_error(
+					_("Missing connection with PulseAudio server"));
+			__atomic_store_n(&audio->interrupted, 1, __ATOMIC_RELEASE);
+		}
+		// fall through
+	case PA_STREAM_READY:
+	case PA_STREAM_TERMINATED:
+		pa_threaded_mainloop_signal(audio->pa_mainloop, 0);
+		break;
+	default:
+		break;
+	}
+}
+
+static void lingot_audio_pulseaudio_connection_state_callback(
+		pa_context* context, void* userdata) {
+	LingotAudioHandler* audio = userdata;
+
+	switch (pa_context_get_state(context)) {
+	case PA_CONTEXT_FAILED:
+		if (__atomic_load_n(&audio->running, __ATOMIC_ACQUIRE)) {
+			lingot_msg_add_error(
+					_("Missing connection with PulseAudio server"));
+			__atomic_store_n(&audio->interrupted, 1, __ATOMIC_RELEASE);
+		}
+		// fall through
+	case PA_CONTEXT_READY:
+	case PA_CONTEXT_TERMINATED:
+		pa_threaded_mainloop_signal(audio->pa_mainloop, 0);
+		break;
+	default:
+		break;
+	}
+}
+
+static void lingot_audio_pulseaudio_success_callback(pa_stream* stream,
+		int success, void* userdata) {
+	LingotAudioHandler* audio = userdata;
+	pa_threaded_mainloop_signal(audio->pa_mainloop, 0);
+}
+
+// runs an operation on the stream and waits for it, with the mainloop lock
+// held.
+static void lingot_audio_pulseaudio_wait_operation(LingotAudioHandler* audio,
+		pa_operation* operation) {
+	if (operation != NULL) {
+		while (pa_operation_get_state(operation) == PA_OPERATION_RUNNING) {
+			pa_threaded_mainloop_wait(audio->pa_mainloop);
+		}
+		pa_operation_unref(operation);
+	}
+}
+
+// disconnects and releases everything the handler holds of the server.
+static void lingot_audio_pulseaudio_close(LingotAudioHandler* audio) {
+	if (audio->pa_mainloop != NULL) {
+		pa_threaded_mainloop_stop(audio->pa_mainloop);
+	}
+	if (audio->pa_stream != NULL) {
+		pa_stream_disconnect(audio->pa_stream);
+		pa_stream_unref(audio->pa_stream);
+		audio->pa_stream = NULL;
+	}
+	if (audio->pa_context != NULL) {
+		pa_context_disconnect(audio->pa_context);
+		pa_context_unref(audio->pa_context);
+		audio->pa_context = NULL;
+	}
+	if (audio->pa_mainloop != NULL) {
+		pa_threaded_mainloop_free(audio->pa_mainloop);
+		audio->pa_mainloop = NULL;
+	}
+}
 #endif
 
-LingotAudioHandler* lingot_audio_pulseaudio_new(char* device, int sample_rate) {
+LingotAudioHandler* lingot_audio_pulseaudio_new(char* device, int sample_rate,
+		unsigned int period_size, unsigned int periods) {
 
 	LingotAudioHandler* audio = NULL;
 
 #	ifdef PULSEAUDIO
+	const char* exception;
+	char error_message[512];
+	pa_buffer_attr buff;
+	const pa_buffer_attr* negotiated;
+	pa_context_state_t context_state;
+	pa_stream_state_t stream_state;
 
 	audio = malloc(sizeof(LingotAudioHandler));
-	audio->pa_client = 0;
+	audio->pa_mainloop = NULL;
+	audio->pa_context = NULL;
+	audio->pa_stream = NULL;
 	strcpy(audio->device, "");
 	audio->read_buffer = NULL;
 
@@ -53,58 +194,136 @@ LingotAudioHandler* lingot_audio_pulseaudio_new(char* device, int sample_rate) {
 	audio->real_sample_rate = sample_rate;
 
 	audio->audio_system = AUDIO_SYSTEM_PULSEAUDIO;
-	if (sample_rate >= 44100) {
-		audio->read_buffer_size_samples = 2048;
-	} else if (sample_rate >= 22050) {
+	if (period_size > 0) {
+		audio->read_buffer_size_samples = period_size;
+	} else if (sample_rate >= 44100) {
 		audio->read_buffer_size_samples = 1024;
-	} else {
+	} else if (sample_rate >= 22050) {
 		audio->read_buffer_size_samples = 512;
+	} else {
+		audio->read_buffer_size_samples = 256;
 	}
 
-	int error;
-
-//	ss.format = PA_SAMPLE_S16NE;
-	ss.format = PA_SAMPLE_FLOAT32; // TODO: config?
-	ss.channels = channels;
-	ss.rate = sample_rate;
-
-	printf("sr %i, real sr %i, format = %i\n", ss.rate, audio->real_sample_rate,
-			ss.format);
-
-	audio->bytes_per_sample = pa_sample_size(&ss);
-	audio->read_buffer_size_bytes = channels * audio->read_buffer_size_samples
-			* audio->bytes_per_sample;
-
-	pa_buffer_attr buff;
-	buff.maxlength = -1;
+	audio->frame_channels = 1;
+//	audio->pa_sample_spec.format = PA_SAMPLE_S16NE;
+	audio->pa_sample_spec.format = PA_SAMPLE_FLOAT32; // TODO: config?
+	audio->pa_sample_spec.channels = audio->frame_channels;
+	audio->pa_sample_spec.rate = sample_rate;
+
+	audio->sample_format = SAMPLE_FORMAT_FLOAT32;
+	audio->bytes_per_sample = pa_sample_size(&audio->pa_sample_spec);
+	audio->read_buffer_size_bytes = audio->frame_channels
+			* audio->read_buffer_size_samples * audio->bytes_per_sample;
+
+	// the server hands a fragment per period, and keeps no more than the
+	// requested periods before overwriting them. With ADJUST_LATENCY the
+	// source latency is adjusted to the fragment too.
+	audio->periods = (periods > 0) ? periods : 4;
 	buff.fragsize = audio->read_buffer_size_bytes;
+	buff.maxlength = audio->periods * audio->read_buffer_size_bytes;
+	buff.tlength = (uint32_t) -1;
+	buff.prebuf = (uint32_t) -1;
+	buff.minreq = (uint32_t) -1;
 
 	const char* device_name = device;
 	if (!strcmp(device_name, "default") || !strcmp(device_name, "")) {
 		device_name = NULL;
 	}
 
-	audio->pa_client = pa_simple_new(NULL, // Use the default server.
-			"Lingot", // Our application's name.
-			PA_STREAM_RECORD, //
-			device_name, //
-			"Lingot record thread", // Description of our stream.
-			&ss, // sample format.
-			NULL, // Use default channel map
-			&buff, //
-			&error);
-
-	if (!audio->pa_client) {
-		char buff[512];
-		snprintf(buff, sizeof(buff), "%s\n%s",
-				_("Error creating PulseAudio client."),
-				pa_strerror(error));
-		lingot_msg_add_error_with_code(buff, error);
+	try
+	{
+		audio->pa_mainloop = pa_threaded_mainloop_new();
+		if (audio->pa_mainloop == NULL) {
+			throw(_("Error creating PulseAudio client."));
+		}
+
+		audio->pa_context = pa_context_new(
+				pa_threaded_mainloop_get_api(audio->pa_mainloop), "Lingot");
+		if (audio->pa_context == NULL) {
+			throw(_("Error creating PulseAudio client."));
+		}
+
+		pa_context_set_state_callback(audio->pa_context,
+				lingot_audio_pulseaudio_connection_state_callback, audio);
+
+		pa_threaded_mainloop_lock(audio->pa_mainloop);
+
+		if ((pa_context_connect(audio->pa_context, NULL, 0, NULL) < 0)
+				|| (pa_threaded_mainloop_start(audio->pa_mainloop) < 0)) {
+			pa_threaded_mainloop_unlock(audio->pa_mainloop);
+			snprintf(error_message, sizeof(error_message), "%s\n%s",
+					_("Error creating PulseAudio client."),
+					pa_strerror(pa_context_errno(audio->pa_context)));
+			throw(error_message);
+		}
+
+		while (((context_state = pa_context_get_state(audio->pa_context))
+				!= PA_CONTEXT_READY) && PA_CONTEXT_IS_GOOD(context_state)) {
+			pa_threaded_mainloop_wait(audio->pa_mainloop);
+		}
+
+		if (context_state == PA_CONTEXT_READY) {
+			audio->pa_stream = pa_stream_new(audio->pa_context,
+					"Lingot record thread", &audio->pa_sample_spec, NULL);
+		}
+
+		if (audio->pa_stream == NULL) {
+			pa_threaded_mainloop_unlock(audio->pa_mainloop);
+			snprintf(error_message, sizeof(error_message), "%s\n%s",
+					_("Error creating PulseAudio client."),
+					pa_strerror(pa_context_errno(audio->pa_context)));
+			throw(error_message);
+		}
+
+		pa_stream_set_state_callback(audio->pa_stream,
+				lingot_audio_pulseaudio_stream_state_callback, audio);
+		pa_stream_set_read_callback(audio->pa_stream,
+				lingot_audio_pulseaudio_stream_read_callback, audio);
+		pa_stream_set_overflow_callback(audio->pa_stream,
+				lingot_audio_pulseaudio_stream_overflow_callback, audio);
+
+		// the stream is kept corked until the capture starts.
+		if (pa_stream_connect_record(audio->pa_stream, device_name, &buff,
+				PA_STREAM_ADJUST_LATENCY | PA_STREAM_START_CORKED) < 0) {
+			stream_state = PA_STREAM_FAILED;
+		} else {
+			while (((stream_state = pa_stream_get_state(audio->pa_stream))
+					!= PA_STREAM_READY) && PA_STREAM_IS_GOOD(stream_state)) {
+				pa_threaded_mainloop_wait(audio->pa_mainloop);
+			}
+		}
+
+		if (stream_state != PA_STREAM_READY) {
+			pa_threaded_mainloop_unlock(audio->pa_mainloop);
+			snprintf(error_message, sizeof(error_message), "%s\n%s",
+					_("Error creating PulseAudio client."),
+					pa_strerror(pa_context_errno(audio->pa_context)));
+			throw(error_message);
+		}
+
+		// the server may have chosen other fragment size.
+		negotiated = pa_stream_get_buffer_attr(audio->pa_stream);
+		if ((negotiated != NULL) && (negotiated->fragsize > 0)) {
+			audio->read_buffer_size_samples = negotiated->fragsize
+					/ (audio->frame_channels * audio->bytes_per_sample);
+			audio->read_buffer_size_bytes = audio->frame_channels
+					* audio->read_buffer_size_samples
+					* audio->bytes_per_sample;
+			audio->periods = negotiated->maxlength / negotiated->fragsize;
+			if (audio->periods < 1) {
+				audio->periods = 1;
+			}
+		}
+
+		pa_threaded_mainloop_unlock(audio->pa_mainloop);
+
+		snprintf(audio->device, sizeof(audio->device), "%s", device);
+
+	}catch {
+		lingot_audio_pulseaudio_close(audio);
 		free(audio);
 		audio = NULL;
-	} else {
-		audio->read_buffer = malloc(audio->read_buffer_size_bytes);
-		memset(audio->read_buffer, 0, audio->read_buffer_size_bytes);
+		lingot_msg_add_error(exception);
 	}
 
 #	else
@@ -119,70 +338,48 @@ void lingot_audio_pulseaudio_destroy(LingotAudioHandler* audio) {
 
 #	ifdef PULSEAUDIO
 	if (audio != NULL) {
-		if (audio->pa_client != 0x0) {
-			pa_simple_free(audio->pa_client);
-			audio->pa_client = 0x0;
-		}
+		lingot_audio_pulseaudio_close(audio);
 	}
 #	endif
 }
 
-int lingot_audio_pulseaudio_read(LingotAudioHandler* audio) {
+int lingot_audio_pulseaudio_start(LingotAudioHandler* audio) {
+	int result = 0;
 
-	int samples_read = -1;
 #	ifdef PULSEAUDIO
-	int error;
-
-	const size_t sample_size = pa_sample_size(&ss);
-	const unsigned int block_size = channels * audio->read_buffer_size_samples
-			* sample_size;
-
-	int result = pa_simple_read(audio->pa_client, audio->read_buffer,
-			block_size, &error);
-
-//	printf("result = %i\n", result);
-	if (result < 0) {
-		char buff[512];
-		snprintf(buff, sizeof(buff), "%s\n%s",
-				_("Read from audio interface failed."),
-				pa_strerror(error));
-		lingot_msg_add_error_with_code(buff, error);
+	pa_threaded_mainloop_lock(audio->pa_mainloop);
+	if (pa_stream_get_state(audio->pa_stream) != PA_STREAM_READY) {
+		result = -1;
 	} else {
-
-		samples_read = audio->read_buffer_size_samples;
-		int i;
-		switch (ss.format) {
-		case PA_SAMPLE_S16LE: {
-			int16_t* read_buffer = (int16_t*) audio->read_buffer;
-			for (i = 0; i < samples_read; i++) {
-				audio->flt_read_buffer[i] = read_buffer[i];
-			}
-			break;
-		}
-		case PA_SAMPLE_FLOAT32: {
-			float* read_buffer = (float*) audio->read_buffer;
-			for (i = 0; i < samples_read; i++) {
-				audio->flt_read_buffer[i] = read_buffer[i] * FLT_SAMPLE_SCALE;
-			}
-			break;
-		}
-		default:
-			break;
-		}
-
+		lingot_audio_pulseaudio_wait_operation(audio,
+				pa_stream_cork(audio->pa_stream, 0,
+						lingot_audio_pulseaudio_success_callback, audio));
 	}
+	pa_threaded_mainloop_unlock(audio->pa_mainloop);
 
+	if (result < 0) {
+		lingot_msg_add_error(_("Missing connection with PulseAudio server"));
+	}
 #	endif
 
-	return samples_read;
+	return result;
 }
 
-void lingot_audio_pulseaudio_cancel(LingotAudioHandler* audio) {
-#ifdef PULSEAUDIO
-	// warning: memory leak?
-	// TODO: avoid it by using the async API
-	audio->pa_client = 0x0;
-#endif
+void lingot_audio_pulseaudio_stop(LingotAudioHandler* audio) {
+#	ifdef PULSEAUDIO
+	// once we hold the lock no read callback is running, and the next ones
+	// will see the handler stopped.
+	pa_threaded_mainloop_lock(audio->pa_mainloop);
+	if (pa_stream_get_state(audio->pa_stream) == PA_STREAM_READY) {
+		lingot_audio_pulseaudio_wait_operation(audio,
+				pa_stream_cork(audio->pa_stream, 1,
+						lingot_audio_pulseaudio_success_callback, audio));
+		lingot_audio_pulseaudio_wait_operation(audio,
+				pa_stream_flush(audio->pa_stream,
+						lingot_audio_pulseaudio_success_callback, audio));
+	}
+	pa_threaded_mainloop_unlock(audio->pa_mainloop);
+#	endif
 }
 
 #ifdef PULSEAUDIO
@@ -193,14 +390,17 @@ struct device_name_node_t {
 	struct device_name_node_t* next;
 };
 
-static pa_context *context = NULL;
-static pa_mainloop_api *mainloop_api = NULL;
-static pa_proplist *proplist = NULL;
+// state of a query of the capture devices, handed to its callbacks.
+struct device_query_t {
+	pa_mainloop_api* mainloop_api;
+	struct device_name_node_t* device_names_last;
+};
 
-static void lingot_audio_pulseaudio_mainloop_quit(int ret);
+static void lingot_audio_pulseaudio_mainloop_quit(struct device_query_t* query,
+		int ret);
 static void lingot_audio_pulseaudio_context_drain_complete(pa_context *c,
 		void *userdata);
-static void lingot_audio_pulseaudio_drain();
+static void lingot_audio_pulseaudio_drain(pa_context *c);
 static void lingot_audio_pulseaudio_get_source_info_callback(pa_context *c,
 		const pa_source_info *i, int is_last, void *userdata);
 static void lingot_audio_pulseaudio_context_state_callback(pa_context *c,
@@ -229,16 +429,15 @@ LingotAudioSystemProperties* lingot_audio_pulseaudio_get_audio_system_properties
 	struct device_name_node_t* device_names_first =
 			(struct device_name_node_t*) malloc(
 					sizeof(struct device_name_node_t));
-	struct device_name_node_t* device_names_last = device_names_first;
+	struct device_query_t query;
 	// the first record is the default source
 	char buff[512];
 	snprintf(buff, sizeof(buff), "%s <default>", _("Default Source"));
 	device_names_first->name = strdup(buff);
 	device_names_first->next = NULL;
 
-	context = NULL;
-	mainloop_api = NULL;
-	proplist = NULL;
+	pa_context *context = NULL;
+	pa_proplist *proplist = NULL;
 	pa_mainloop *m = NULL;
 	int ret = 1;
 	char *server = NULL;
@@ -250,21 +449,21 @@ LingotAudioSystemProperties* lingot_audio_pulseaudio_get_audio_system_properties
 		fprintf(stderr, "PulseAudio: pa_mainloop_new() failed.\n");
 	} else {
 
-		mainloop_api = pa_mainloop_get_api(m);
+		query.mainloop_api = pa_mainloop_get_api(m);
+		query.device_names_last = device_names_first;
 
 //		//!pa_assert_se(pa_signal_init(mainloop_api) == 0);
 //		pa_signal_new(SIGINT, exit_signal_callback, NULL);
 //		pa_signal_new(SIGTERM, exit_signal_callback, NULL);
 //		pa_disable_sigpipe();
 
-		if (!(context = pa_context_new_with_proplist(mainloop_api, NULL,
+		if (!(context = pa_context_new_with_proplist(query.mainloop_api, NULL,
 				proplist))) {
 			fprintf(stderr, "PulseAudio: pa_context_new() failed.\n");
 		} else {
 
 			pa_context_set_state_callback(context,
-					lingot_audio_pulseaudio_context_state_callback,
-					&device_names_last);
+					lingot_audio_pulseaudio_context_state_callback, &query);
 			if (pa_context_connect(context, server, 0, NULL) < 0) {
 				fprintf(stderr, "PulseAudio: pa_context_connect() failed: %s",
 						pa_strerror(pa_context_errno(context)));
@@ -325,8 +524,9 @@ LingotAudioSystemProperties* lingot_audio_pulseaudio_get_audio_system_properties
 
 #ifdef PULSEAUDIO
 
-static void lingot_audio_pulseaudio_mainloop_quit(int ret) {
-	mainloop_api->quit(mainloop_api, ret);
+static void lingot_audio_pulseaudio_mainloop_quit(struct device_query_t* query,
+		int ret) {
+	query->mainloop_api->quit(query->mainloop_api, ret);
 }
 
 static void lingot_audio_pulseaudio_context_drain_complete(pa_context *c,
@@ -334,34 +534,32 @@ static void lingot_audio_pulseaudio_context_drain_complete(pa_context *c,
 	pa_context_disconnect(c);
 }
 
-static void lingot_audio_pulseaudio_drain() {
+static void lingot_audio_pulseaudio_drain(pa_context *c) {
 	pa_operation *o;
 
-	if (!(o = pa_context_drain(context,
+	if (!(o = pa_context_drain(c,
 			lingot_audio_pulseaudio_context_drain_complete, NULL)))
-		pa_context_disconnect(context);
+		pa_context_disconnect(c);
 	else
 		pa_operation_unref(o);
 }
 
 static void lingot_audio_pulseaudio_get_source_info_callback(pa_context *c,
 		const pa_source_info *i, int is_last, void *userdata) {
+	struct device_query_t* query = (struct device_query_t*) userdata;
 
 	if (is_last < 0) {
 		fprintf(stderr, "PulseAudio: failed to get source information: %s",
 				pa_strerror(pa_context_errno(c)));
-		lingot_audio_pulseaudio_mainloop_quit(1);
+		lingot_audio_pulseaudio_mainloop_quit(query, 1);
 		return;
 	}
 
 	if (is_last) {
-		lingot_audio_pulseaudio_drain();
+		lingot_audio_pulseaudio_drain(c);
 		return;
 	}
 
-	struct device_name_node_t** device_names_last =
-			(struct device_name_node_t**) userdata;
-
 	char buff[512];
 	snprintf(buff, sizeof(buff), "%s <%s>", i->description, i->name);
 
@@ -373,16 +571,18 @@ static void lingot_audio_pulseaudio_get_source_info_callback(pa_context *c,
 
 	struct device_name_node_t* new_name_node =
 			(struct device_name_node_t*) malloc(
-					sizeof(struct device_name_node_t*));
+					sizeof(struct device_name_node_t));
 	new_name_node->name = strdup(buff);
 	new_name_node->next = NULL;
 
-	(*device_names_last)->next = new_name_node;
-	*device_names_last = new_name_node;
+	query->device_names_last->next = new_name_node;
+	query->device_names_last = new_name_node;
 }
 
 static void lingot_audio_pulseaudio_context_state_callback(pa_context *c,
 		void *userdata) {
+	struct device_query_t* query = (struct device_query_t*) userdata;
+
 	switch (pa_context_get_state(c)) {
 	case PA_CONTEXT_CONNECTING:
 	case PA_CONTEXT_AUTHORIZING:
@@ -397,14 +597,14 @@ static void lingot_audio_pulseaudio_context_state_callback(pa_context *c,
 		break;
 
 	case PA_CONTEXT_TERMINATED:
-		lingot_audio_pulseaudio_mainloop_quit(0);
+		lingot_audio_pulseaudio_mainloop_quit(query, 0);
 		break;
 
 	case PA_CONTEXT_FAILED:
 	default:
 		fprintf(stderr, "PulseAudio: connection failure: %s\n",
 				pa_strerror(pa_context_errno(c)));
-		lingot_audio_pulseaudio_mainloop_quit(1);
+		lingot_audio_pulseaudio_mainloop_quit(query, 1);
 		break;
 	}
 }
@@ -27,12 +27,13 @@
 
 #include "lingot-audio.h"
 
-LingotAudioHandler* lingot_audio_pulseaudio_new(char* device, int sample_rate);
+LingotAudioHandler* lingot_audio_pulseaudio_new(char* device, int sample_rate,
+		unsigned int period_size, unsigned int periods);
 void lingot_audio_pulseaudio_destroy(LingotAudioHandler*);
-int lingot_audio_pulseaudio_read(LingotAudioHandler*);
 LingotAudioSystemProperties* lingot_audio_pulseaudio_get_audio_system_properties(
 		audio_system_t);
 
-void lingot_audio_pulseaudio_cancel(LingotAudioHandler* audio);
+int lingot_audio_pulseaudio_start(LingotAudioHandler* audio);
+void lingot_audio_pulseaudio_stop(LingotAudioHandler* audio);
 
 #endif
@@ -0,0 +1,285 @@
+/*
+ * lingot, a musical instrument tuner.
+ *
+ * Copyright (C) 2004-2013  Ibán Cereijo Graña.
+ * Copyright (C) 2004-2008  Jairo Chapela Martínez.
+
+ *
+ * This file is part of lingot.
+ *
+ * lingot is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * lingot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with lingot; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "lingot-defs.h"
+#include "lingot-audio-synth.h"
+#include "lingot-i18n.h"
+#include "lingot-msg.h"
+
+// reads the options of the signal from the device string. Returns 0 on
+// success.
+static int lingot_audio_synth_parse(LingotAudioSynth* synth,
+		const char* device) {
+	char* options = strdup(device);
+	char* saveptr = NULL;
+	char* option;
+	char* value;
+	char buff[512];
+	char* end;
+	int result = 0;
+	long n;
+	double a = 0.0, b = 0.0;
+
+	synth->frequency = 440.0;
+	synth->level = pow(10.0, -6.0 / 20.0);
+	synth->harmonics = 4;
+	synth->inharmonicity = 0.0;
+	synth->vibrato_rate = 0.0;
+	synth->vibrato_depth = 0.0;
+	synth->noise = 0.0;
+	synth->tone_duration = 0.0;
+	synth->gap_duration = 0.0;
+	synth->paced = 1;
+	synth->noise_state = 0x9e3779b97f4a7c15ULL;
+
+	for (option = strtok_r(options, ", ", &saveptr); option != NULL;
+			option = strtok_r(NULL, ", ", &saveptr)) {
+
+		value = strchr(option, '=');
+		if (value != NULL) {
+			*value++ = '\0';
+		}
+
+		if (!strcmp(option, "default")) {
+			continue;
+		} else if ((value == NULL) || (*value == '\0')) {
+			result = -1;
+		} else if (!strcmp(option, "freq")) {
+			synth->frequency = atof(value);
+			result = (synth->frequency > 0.0) ? 0 : -1;
+		} else if (!strcmp(option, "level")) {
+			synth->level = pow(10.0, atof(value) / 20.0);
+		} else if (!strcmp(option, "harmonics")) {
+			n = strtol(value, &end, 10);
+			result = ((*end == '\0') && (n >= 1)
+					&& (n <= SYNTH_MAX_HARMONICS)) ? 0 : -1;
+			synth->harmonics = (result == 0) ? n : 1;
+		} else if (!strcmp(option, "inharmonicity")) {
+			synth->inharmonicity = atof(value);
+			result = (synth->inharmonicity >= 0.0) ? 0 : -1;
+		} else if (!strcmp(option, "vibrato")) {
+			result = (sscanf(value, "%lf:%lf", &a, &b) == 2) ? 0 : -1;
+			synth->vibrato_rate = a;
+			synth->vibrato_depth = b;
+		} else if (!strcmp(option, "noise")) {
+			synth->noise = pow(10.0, atof(value) / 20.0);
+		} else if (!strcmp(option, "gap")) {
+			result = ((sscanf(value, "%lf:%lf", &a, &b) == 2) && (a > 0.0)
+					&& (b >= 0.0)) ? 0 : -1;
+			synth->tone_duration = a;
+			synth->gap_duration = b;
+		} else if (!strcmp(option, "pace")) {
+			synth->paced = !strcmp(value, "realtime");
+			result = (synth->paced || !strcmp(value, "fast")) ? 0 : -1;
+		} else if (!strcmp(option, "seed")) {
+			// xorshift cannot start from 0.
+			synth->noise_state = strtoull(value, NULL, 0) | 1;
+		} else {
+			result = -1;
+		}
+
+		if (result < 0) {
+			snprintf(buff, sizeof(buff),
+					_("Invalid synthesizer option '%s'"), option);
+			lingot_msg_add_error(buff);
+			break;
+		}
+	}
+
+	free(options);
+	return result;
+}
+
+LingotAudioHandler* lingot_audio_synth_new(char* device, int sample_rate,
+		unsigned int period_size, unsigned int periods) {
+
+	LingotAudioHandler* audio = NULL;
+	LingotAudioSynth* synth = malloc(sizeof(LingotAudioSynth));
+
+	synth->phases = NULL;
+	if (lingot_audio_synth_parse(synth, device) < 0) {
+		free(synth);
+		return NULL;
+	}
+
+	synth->phases = calloc(synth->harmonics, sizeof(double));
+	if (synth->phases == NULL) {
+		lingot_msg_add_error(_("Not enough memory for the synthesizer"));
+		free(synth);
+		return NULL;
+	}
+
+	synth->vibrato_phase = 0.0;
+	synth->position = 0;
+
+	if (sample_rate <= 0) {
+		sample_rate = 44100;
+	}
+
+	audio = malloc(sizeof(LingotAudioHandler));
+	audio->audio_system = AUDIO_SYSTEM_SYNTH;
+	audio->synth = synth;
+	audio->file = NULL;
+	snprintf(audio->device, sizeof(audio->device), "%s", device);
+	audio->real_sample_rate = sample_rate;
+
+	if (period_size > 0) {
+		audio->read_buffer_size_samples = period_size;
+	} else if (sample_rate >= 44100) {
+		audio->read_buffer_size_samples = 1024;
+	} else if (sample_rate >= 22050) {
+		audio->read_buffer_size_samples = 512;
+	} else {
+		audio->read_buffer_size_samples = 256;
+	}
+	audio->periods = (periods > 0) ? periods : 2;
+
+	// the samples are generated straight in the floating point buffer.
+	audio->read_buffer = NULL;
+#	ifdef LINGOT_FLOAT
+	audio->sample_format = SAMPLE_FORMAT_FLOAT32;
+#	else
+	audio->sample_format = SAMPLE_FORMAT_FLOAT64;
+#	endif
+	audio->frame_channels = 1;
+	audio->bytes_per_sample = lingot_audio_format_size(audio->sample_format);
+	audio->read_buffer_size_bytes = audio->read_buffer_size_samples
+			* audio->bytes_per_sample;
+
+	return audio;
+}
+
+void lingot_audio_synth_destroy(LingotAudioHandler* audio) {
+	if ((audio != NULL) && (audio->synth != NULL)) {
+		free(audio->synth->phases);
+		free(audio->synth);
+		audio->synth = NULL;
+	}
+}
+
+int lingot_audio_synth_read(LingotAudioHandler* audio) {
+	LingotAudioSynth* synth = audio->synth;
+	const int samples = audio->read_buffer_size_samples;
+	const double dt = 1.0 / audio->real_sample_rate;
+	const unsigned long tone_samples = synth->tone_duration
+			* audio->real_sample_rate;
+	const unsigned long cycle_samples = tone_samples
+			+ (unsigned long) (synth->gap_duration * audio->real_sample_rate);
+	FLT* out = audio->flt_read_buffer;
+	double f[SYNTH_MAX_HARMONICS];
+	double amplitude[SYNTH_MAX_HARMONICS];
+	double norm = 0.0;
+	double vibrato, sample, noise;
+	unsigned int k;
+	int i;
+
+	if (synth->paced) {
+		lingot_audio_pace(audio);
+	}
+
+	// partials of a stiff string, with amplitudes decaying as 1/k and the
+	// peak of their sum at the requested level.
+	for (k = 0; k < synth->harmonics; k++) {
+		f[k] = (k + 1) * synth->frequency
+				* sqrt(1.0 + synth->inharmonicity * (k + 1) * (k + 1));
+		amplitude[k] = 1.0 / (k + 1);
+		norm += amplitude[k];
+	}
+	for (k = 0; k < synth->harmonics; k++) {
+		amplitude[k] *= synth->level / norm;
+	}
+
+	for (i = 0; i < samples; i++, synth->position++) {
+		vibrato = 1.0;
+		if (synth->vibrato_depth != 0.0) {
+			vibrato = pow(2.0,
+					synth->vibrato_depth / 1200.0
+							* sin(2.0 * M_PI * synth->vibrato_phase));
+			synth->vibrato_phase += synth->vibrato_rate * dt;
+			synth->vibrato_phase -= floor(synth->vibrato_phase);
+		}
+
+		sample = 0.0;
+		if ((cycle_samples == 0)
+				|| ((synth->position % cycle_samples) < tone_samples)) {
+			for (k = 0; k < synth->harmonics; k++) {
+				sample += amplitude[k] * sin(2.0 * M_PI * synth->phases[k]);
+			}
+		}
+
+		// the partials keep running during the gaps.
+		for (k = 0; k < synth->harmonics; k++) {
+			synth->phases[k] += f[k] * vibrato * dt;
+			synth->phases[k] -= floor(synth->phases[k]);
+		}
+
+		if (synth->noise > 0.0) {
+			// xorshift64*, uniform in [-1, 1).
+			synth->noise_state ^= synth->noise_state >> 12;
+			synth->noise_state ^= synth->noise_state << 25;
+			synth->noise_state ^= synth->noise_state >> 27;
+			noise = (double) ((synth->noise_state * 0x2545f4914f6cdd1dULL)
+					>> 11) * (2.0 / 9007199254740992.0) - 1.0;
+			sample += synth->noise * noise;
+		}
+
+		out[i] = FLT_SAMPLE_SCALE * sample;
+	}
+
+	return samples;
+}
+
+LingotAudioSystemProperties* lingot_audio_synth_get_audio_system_properties(
+		audio_system_t audio_system) {
+
+	LingotAudioSystemProperties* properties =
+			(LingotAudioSystemProperties*) malloc(
+					1 * sizeof(LingotAudioSystemProperties));
+
+	properties->forced_sample_rate = 0;
+	properties->n_sample_rates = 5;
+	properties->sample_rates = malloc(properties->n_sample_rates * sizeof(int));
+	properties->sample_rates[0] = 8000;
+	properties->sample_rates[1] = 11025;
+	properties->sample_rates[2] = 22050;
+	properties->sample_rates[3] = 44100;
+	properties->sample_rates[4] = 48000;
+
+	// a few signals as examples.
+	properties->n_devices = 4;
+	properties->devices = malloc(properties->n_devices * sizeof(char*));
+	properties->devices[0] = strdup("default");
+	properties->devices[1] = strdup(
+			"freq=82.41,harmonics=8,inharmonicity=0.0001");
+	properties->devices[2] = strdup(
+			"freq=440,vibrato=5:30,noise=-50,gap=1:0.5");
+	properties->devices[3] = strdup("freq=440,pace=fast");
+
+	return properties;
+}
@@ -0,0 +1,79 @@
+/*
+ * lingot, a musical instrument tuner.
+ *
+ * Copyright (C) 2004-2013  Ibán Cereijo Graña.
+ * Copyright (C) 2004-2008  Jairo Chapela Martínez.
+
+ *
+ * This file is part of lingot.
+ *
+ * lingot is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * lingot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with lingot; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef __LINGOT_AUDIO_SYNTH_H__
+#define __LINGOT_AUDIO_SYNTH_H__
+
+#include <stdint.h>
+
+#include "lingot-audio.h"
+
+// synthetic audio source, for tests and benchmarks without a sound device.
+// The signal is described in the device string as comma separated options:
+//
+//   freq=<Hz>                 fundamental frequency (440)
+//   level=<dBFS>              peak level of the tone (-6)
+//   harmonics=<n>             number of partials, with 1/k amplitudes, up to
+//                             SYNTH_MAX_HARMONICS (4)
+//   inharmonicity=<B>         stiff string partials, k f sqrt(1 + B k^2) (0)
+//   vibrato=<Hz>:<cents>      vibrato rate and depth (none)
+//   noise=<dBFS>              white noise level (none)
+//   gap=<seconds>:<seconds>   tone and silence durations (no silence)
+//   pace=realtime|fast        paced at the sample rate or as fast as possible
+//   seed=<n>                  seed of the noise generator
+//
+// "default" stands for all the defaults, a 440 Hz tone paced in real time.
+
+#define SYNTH_MAX_HARMONICS	64
+
+typedef struct _LingotAudioSynth LingotAudioSynth;
+
+struct _LingotAudioSynth {
+
+	double frequency;
+	double level; // linear, full scale 1.0
+	unsigned int harmonics;
+	double inharmonicity;
+	double vibrato_rate;
+	double vibrato_depth; // cents
+	double noise; // linear, full scale 1.0
+	double tone_duration;
+	double gap_duration;
+	int paced;
+
+	// generator state.
+	double* phases; // of each partial, in cycles
+	double vibrato_phase; // in cycles
+	unsigned long position; // samples generated
+	uint64_t noise_state;
+};
+
+LingotAudioHandler* lingot_audio_synth_new(char* device, int sample_rate,
+		unsigned int period_size, unsigned int periods);
+void lingot_audio_synth_destroy(LingotAudioHandler*);
+int lingot_audio_synth_read(LingotAudioHandler*);
+LingotAudioSystemProperties* lingot_audio_synth_get_audio_system_properties(
+		audio_system_t);
+
+#endif
@@ -36,38 +36,100 @@
 #include "lingot-audio-alsa.h"
 #include "lingot-audio-jack.h"
 #include "lingot-audio-pulseaudio.h"
+#include "lingot-audio-synth.h"
+#include "lingot-audio-file.h"
+#include "lingot-i18n.h"
+#include "lingot-msg.h"
+
+// initialization common to every audio system.
+static void lingot_audio_init(LingotAudioHandler* audio,
+		LingotAudioProcessCallback process_callback,
+		void *process_callback_arg) {
+	// audio source read in floating point format.
+	audio->flt_read_buffer = malloc(
+			audio->read_buffer_size_samples * sizeof(FLT));
+	memset(audio->flt_read_buffer, 0,
+			audio->read_buffer_size_samples * sizeof(FLT));
+	audio->flt_read_buffer_lent = 0;
+	audio->process_callback = process_callback;
+	audio->process_callback_arg = process_callback_arg;
+	audio->channels = 1;
+	audio->process_callback_args = NULL;
+	audio->interrupted = 0;
+	audio->running = 0;
+	audio->thread_input_read_done = 0;
+	audio->overruns = 0;
+	audio->recovered_errors = 0;
+	audio->lost_frames = 0;
+	audio->late_periods = 0;
+	audio->deadline.tv_sec = 0;
+	audio->deadline.tv_nsec = 0;
+	audio->latency = 1e3 * audio->periods * audio->read_buffer_size_samples
+			/ audio->real_sample_rate;
+}
 
 LingotAudioHandler* lingot_audio_new(audio_system_t audio_system, char* device,
-		int sample_rate, LingotAudioProcessCallback process_callback,
+		int sample_rate, unsigned int period_size, unsigned int periods,
+		LingotAudioProcessCallback process_callback,
 		void *process_callback_arg) {
 
 	LingotAudioHandler* result = NULL;
 
 	switch (audio_system) {
 	case AUDIO_SYSTEM_OSS:
-		result = lingot_audio_oss_new(device, sample_rate);
+		result = lingot_audio_oss_new(device, sample_rate, period_size,
+				periods);
 		break;
 	case AUDIO_SYSTEM_ALSA:
-		result = lingot_audio_alsa_new(device, sample_rate);
+		result = lingot_audio_alsa_new(device, sample_rate, period_size,
+				periods);
 		break;
 	case AUDIO_SYSTEM_JACK:
-		result = lingot_audio_jack_new(device, sample_rate);
+		result = lingot_audio_jack_new(device, sample_rate, period_size);
 		break;
 	case AUDIO_SYSTEM_PULSEAUDIO:
-		result = lingot_audio_pulseaudio_new(device, sample_rate);
+		result = lingot_audio_pulseaudio_new(device, sample_rate, period_size,
+				periods);
+		break;
+	case AUDIO_SYSTEM_SYNTH:
+		result = lingot_audio_synth_new(device, sample_rate, period_size,
+				periods);
+		break;
+	case AUDIO_SYSTEM_FILE:
+		result = lingot_audio_file_new(device, sample_rate, period_size,
+				periods);
+		break;
+	}
+
+	if (result != NULL ) {
+		lingot_audio_init(result, process_callback, process_callback_arg);
+	}
+
+	return result;
+}
+
+LingotAudioHandler* lingot_audio_new_multichannel(audio_system_t audio_system,
+		char* device, int sample_rate, unsigned int channels,
+		LingotAudioProcessCallback process_callback,
+		void** process_callback_args) {
+
+	LingotAudioHandler* result = NULL;
+
+	switch (audio_system) {
+	case AUDIO_SYSTEM_JACK:
+		result = lingot_audio_jack_new_multichannel(device, sample_rate,
+				channels);
+		break;
+	default:
+		lingot_msg_add_error(
+				_("Multi-channel capture is only available with JACK"));
 		break;
 	}
 
 	if (result != NULL ) {
-		// audio source read in floating point format.
-		result->flt_read_buffer = malloc(
-				result->read_buffer_size_samples * sizeof(FLT));
-		memset(result->flt_read_buffer, 0,
-				result->read_buffer_size_samples * sizeof(FLT));
-		result->process_callback = process_callback;
-		result->process_callback_arg = process_callback_arg;
-		result->interrupted = 0;
-		result->running = 0;
+		lingot_audio_init(result, process_callback, NULL);
+		result->channels = channels;
+		result->process_callback_args = process_callback_args;
 	}
 
 	return result;
@@ -89,12 +151,18 @@ void lingot_audio_destroy(LingotAudioHandler* audio) {
 		case AUDIO_SYSTEM_PULSEAUDIO:
 			lingot_audio_pulseaudio_destroy(audio);
 			break;
+		case AUDIO_SYSTEM_SYNTH:
+			lingot_audio_synth_destroy(audio);
+			break;
+		case AUDIO_SYSTEM_FILE:
+			lingot_audio_file_destroy(audio);
+			break;
 		default:
 			perror("unknown audio system\n");
 			break;
 		}
 
-		if (audio->flt_read_buffer != 0x0) {
+		if ((audio->flt_read_buffer != 0x0) && !audio->flt_read_buffer_lent) {
 			free(audio->flt_read_buffer);
 			audio->flt_read_buffer = 0x0;
 		}
@@ -107,6 +175,14 @@ void lingot_audio_destroy(LingotAudioHandler* audio) {
 	}
 }
 
+void lingot_audio_lend_buffer(LingotAudioHandler* audio, FLT* buffer) {
+	if (!audio->flt_read_buffer_lent) {
+		free(audio->flt_read_buffer);
+	}
+	audio->flt_read_buffer = buffer;
+	audio->flt_read_buffer_lent = 1;
+}
+
 int lingot_audio_read(LingotAudioHandler* audio) {
 	int samples_read = -1;
 
@@ -118,8 +194,11 @@ int lingot_audio_read(LingotAudioHandler* audio) {
 		case AUDIO_SYSTEM_ALSA:
 			samples_read = lingot_audio_alsa_read(audio);
 			break;
-		case AUDIO_SYSTEM_PULSEAUDIO:
-			samples_read = lingot_audio_pulseaudio_read(audio);
+		case AUDIO_SYSTEM_SYNTH:
+			samples_read = lingot_audio_synth_read(audio);
+			break;
+		case AUDIO_SYSTEM_FILE:
+			samples_read = lingot_audio_file_read(audio);
 			break;
 		default:
 			perror("unknown audio system\n");
@@ -170,6 +249,46 @@ int lingot_audio_read(LingotAudioHandler* audio) {
 	return samples_read;
 }
 
+int lingot_audio_pace_at(LingotAudioHandler* audio,
+		const struct timespec* now) {
+	const long period_ns = (long) (1e9 * audio->read_buffer_size_samples
+			/ audio->real_sample_rate);
+	double late;
+
+	if (audio->deadline.tv_sec == 0) {
+		audio->deadline = *now;
+	}
+
+	audio->deadline.tv_nsec += period_ns;
+	while (audio->deadline.tv_nsec >= 1000000000L) {
+		audio->deadline.tv_nsec -= 1000000000L;
+		audio->deadline.tv_sec++;
+	}
+
+	late = (now->tv_sec - audio->deadline.tv_sec)
+			+ 1e-9 * (now->tv_nsec - audio->deadline.tv_nsec);
+	if (late > 1e-9 * period_ns * audio->periods) {
+		// the source doesn't skip anything, it is not an overrun.
+		__atomic_add_fetch(&audio->late_periods,
+				(unsigned long) (1e9 * late / period_ns), __ATOMIC_RELAXED);
+		audio->deadline = *now;
+		return 0;
+	}
+
+	return 1;
+}
+
+void lingot_audio_pace(LingotAudioHandler* audio) {
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	if (lingot_audio_pace_at(audio, &now)) {
+		while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME,
+				&audio->deadline, NULL) == EINTR) {
+		}
+	}
+}
+
 LingotAudioSystemProperties* lingot_audio_get_audio_system_properties(
 		audio_system_t audio_system) {
 	LingotAudioSystemProperties* result;
@@ -188,6 +307,12 @@ LingotAudioSystemProperties* lingot_audio_get_audio_system_properties(
 		result = lingot_audio_pulseaudio_get_audio_system_properties(
 				audio_system);
 		break;
+	case AUDIO_SYSTEM_SYNTH:
+		result = lingot_audio_synth_get_audio_system_properties(audio_system);
+		break;
+	case AUDIO_SYSTEM_FILE:
+		result = lingot_audio_file_get_audio_system_properties(audio_system);
+		break;
 	default:
 		perror("unknown audio system\n");
 		result = NULL;
@@ -226,13 +351,14 @@ void lingot_audio_run_reading_thread(LingotAudioHandler* audio) {
 		if (samples_read < 0) {
 			audio->running = 0;
 			audio->interrupted = 1;
-		} else {
+		} else if (samples_read > 0) {
 			audio->process_callback(audio->flt_read_buffer, samples_read,
 					audio->process_callback_arg);
 		}
 	}
 
 	pthread_mutex_lock(&audio->thread_input_read_mutex);
+	audio->thread_input_read_done = 1;
 	pthread_cond_broadcast(&audio->thread_input_read_cond);
 	pthread_mutex_unlock(&audio->thread_input_read_mutex);
 
@@ -246,6 +372,9 @@ int lingot_audio_start(LingotAudioHandler* audio) {
 	case AUDIO_SYSTEM_JACK:
 		result = lingot_audio_jack_start(audio);
 		break;
+	case AUDIO_SYSTEM_PULSEAUDIO:
+		result = lingot_audio_pulseaudio_start(audio);
+		break;
 	default:
 		pthread_attr_init(&audio->thread_input_read_attr);
 
@@ -254,6 +383,9 @@ int lingot_audio_start(LingotAudioHandler* audio) {
 		pthread_mutex_init(&audio->thread_input_read_mutex, NULL );
 		pthread_cond_init(&audio->thread_input_read_cond, NULL );
 		pthread_attr_init(&audio->thread_input_read_attr);
+		audio->thread_input_read_done = 0;
+		// before the thread starts, or it could find it stopped and quit.
+		__atomic_store_n(&audio->running, 1, __ATOMIC_RELEASE);
 		pthread_create(&audio->thread_input_read,
 				&audio->thread_input_read_attr,
 				(void* (*)(void*)) lingot_audio_run_reading_thread, audio);
@@ -261,7 +393,8 @@ int lingot_audio_start(LingotAudioHandler* audio) {
 	}
 
 	if (result == 0) {
-		audio->running = 1;
+		// seen by the JACK realtime thread without locks.
+		__atomic_store_n(&audio->running, 1, __ATOMIC_RELEASE);
 	}
 
 	return result;
@@ -271,19 +404,12 @@ int lingot_audio_start(LingotAudioHandler* audio) {
 void lingot_audio_cancel(LingotAudioHandler* audio) {
 	// TODO: avoid
 	fprintf(stderr, "warning: cancelling audio thread\n");
-	switch (audio->audio_system) {
-	case AUDIO_SYSTEM_PULSEAUDIO:
-		lingot_audio_pulseaudio_cancel(audio);
-		break;
-	default:
-		break;
-	}
 }
 
 void lingot_audio_stop(LingotAudioHandler* audio) {
 	void* thread_result;
 
-	int result;
+	int result = 0;
 	struct timeval tout, tout_abs;
 	struct timespec tout_tspec;
 
@@ -292,26 +418,27 @@ void lingot_audio_stop(LingotAudioHandler* audio) {
 	tout.tv_usec = 500000;
 
 	if (audio->running == 1) {
-		audio->running = 0;
+		// seen by the callbacks of the audio servers without locks.
+		__atomic_store_n(&audio->running, 0, __ATOMIC_RELEASE);
 		switch (audio->audio_system) {
 		case AUDIO_SYSTEM_JACK:
 			lingot_audio_jack_stop(audio);
 			break;
-//		case AUDIO_SYSTEM_PULSEAUDIO:
-//			pthread_join(audio->thread_input_read, &thread_result);
-//			pthread_attr_destroy(&audio->thread_input_read_attr);
-//			pthread_mutex_destroy(&audio->thread_input_read_mutex);
-//			pthread_cond_destroy(&audio->thread_input_read_cond);
-//			break;
+		case AUDIO_SYSTEM_PULSEAUDIO:
+			lingot_audio_pulseaudio_stop(audio);
+			break;
 		default:
 			timeradd(&tout, &tout_abs, &tout_abs);
 			tout_tspec.tv_sec = tout_abs.tv_sec;
 			tout_tspec.tv_nsec = 1000 * tout_abs.tv_usec;
 
 			// watchdog timer
+			// the thread may have finished before we wait.
 			pthread_mutex_lock(&audio->thread_input_read_mutex);
-			result = pthread_cond_timedwait(&audio->thread_input_read_cond,
-					&audio->thread_input_read_mutex, &tout_tspec);
+			while (!audio->thread_input_read_done && (result != ETIMEDOUT)) {
+				result = pthread_cond_timedwait(&audio->thread_input_read_cond,
+						&audio->thread_input_read_mutex, &tout_tspec);
+			}
 			pthread_mutex_unlock(&audio->thread_input_read_mutex);
 
 			if (result == ETIMEDOUT) {
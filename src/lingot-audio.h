@@ -25,6 +25,9 @@
 #ifndef __LINGOT_AUDIO_H__
 #define __LINGOT_AUDIO_H__
 
+#include <time.h>
+#include <pthread.h>
+
 #ifdef ALSA
 #include <alsa/asoundlib.h>
 #endif
@@ -34,18 +37,17 @@
 #endif
 
 #ifdef PULSEAUDIO
-#include <pulse/simple.h>
+#include <pulse/pulseaudio.h>
 #endif
 
 #include "lingot-config.h"
+#include "lingot-audio-format.h"
 
 typedef void (*LingotAudioProcessCallback)(FLT* read_buffer,
 		int read_buffer_size_samples, void *arg);
 
 typedef struct _LingotAudioHandler LingotAudioHandler;
 
-#define FLT_SAMPLE_SCALE	32767.0
-
 struct _LingotAudioHandler {
 
 	int audio_system;
@@ -54,30 +56,62 @@ struct _LingotAudioHandler {
 	LingotAudioProcessCallback process_callback;
 	void* process_callback_arg;
 
+	// channels of a multi-channel capture, each one handed to the process
+	// callback with its own argument. 1 and NULL in the usual capture.
+	unsigned int channels;
+	void** process_callback_args;
+
 #	ifdef OSS
 	int dsp; // file handler.
 #	endif
 #	ifdef ALSA
 	snd_pcm_t *capture_handle;
+	// whether the samples are converted straight from the device buffer,
+	// through mmap, or read with snd_pcm_readi().
+	int alsa_mmap;
+	struct pollfd* alsa_poll_fds;
+	int alsa_poll_fds_count;
 #	endif
 #	ifdef JACK
 	jack_port_t *jack_input_port;
+	jack_port_t **jack_input_ports; // one per channel.
 	jack_client_t *jack_client;
 	int nframes;
 #	endif
 #	ifdef PULSEAUDIO
-	pa_simple *pa_client;
+	// the stream is read in the thread of the mainloop.
+	pa_threaded_mainloop *pa_mainloop;
+	pa_context *pa_context;
+	pa_stream *pa_stream;
+	pa_sample_spec pa_sample_spec;
 #	endif
+	// sources available without a device.
+	struct _LingotAudioSynth* synth;
+	struct _LingotAudioFile* file;
+	// those without a device clock are paced with lingot_audio_pace().
+	struct timespec deadline; // of the next period
 #	if !defined(OSS) && !defined(ALSA) && !defined(PULSEAUDIO) && !defined(JACK)
 #	error "No audio system has been enabled"
 #	endif
 
+	// negotiated with the device: the samples of a period, read at a time,
+	// and the periods its buffer holds.
 	int read_buffer_size_samples;
 	int read_buffer_size_bytes;
+	unsigned int periods;
+
+	// capture latency, in milliseconds, of a full device buffer.
+	double latency;
 
 	void* read_buffer;
 	FLT* flt_read_buffer;
 
+	// format of the captured samples, and channels in each captured frame.
+	// Only the first channel is analyzed.
+	sample_format_t sample_format;
+	unsigned int frame_channels;
+	int flt_read_buffer_lent; // whether it belongs to the consumer.
+
 	unsigned int real_sample_rate;
 
 	short bytes_per_sample;
@@ -87,6 +121,7 @@ struct _LingotAudioHandler {
 	pthread_attr_t thread_input_read_attr;
 	pthread_cond_t thread_input_read_cond;
 	pthread_mutex_t thread_input_read_mutex;
+	int thread_input_read_done;
 
 	// indicates whether the audio thread is running
 	int running;
@@ -94,6 +129,18 @@ struct _LingotAudioHandler {
 	// indicates whether the thread was interrupted (by the audio server, not
 	// by the user)
 	int interrupted;
+
+	// capture problems overcome without stopping the capture: overruns of
+	// the device buffer, errors recovered (overruns included) and an
+	// estimate of the frames lost in them. They are updated with atomics
+	// from the audio thread, see lingot_core_get_stats().
+	unsigned long overruns;
+	unsigned long recovered_errors;
+	unsigned long lost_frames;
+
+	// periods a reader of a paced source (synthesizer, file) fell behind
+	// by more than the buffer. Nothing is lost then, the source just waits.
+	unsigned long late_periods;
 };
 
 typedef struct _LingotAudioSystemProperties LingotAudioSystemProperties;
@@ -113,14 +160,48 @@ LingotAudioSystemProperties* lingot_audio_get_audio_system_properties(
 		audio_system_t audio_system);
 void lingot_audio_audio_system_properties_destroy(LingotAudioSystemProperties*);
 
-// creates an audio handler
+// creates an audio handler. The period size (in samples) and the number of
+// periods per buffer are only a request, 0 lets the audio system choose.
 LingotAudioHandler* lingot_audio_new(audio_system_t audio_system, char* device,
-		int sample_rate, LingotAudioProcessCallback process_callback,
+		int sample_rate, unsigned int period_size, unsigned int periods,
+		LingotAudioProcessCallback process_callback,
 		void *process_callback_arg);
 
+// creates an audio handler capturing several channels, which are handed
+// separately to the process callback, each one with its argument in
+// process_callback_args. Only available with JACK.
+LingotAudioHandler* lingot_audio_new_multichannel(audio_system_t audio_system,
+		char* device, int sample_rate, unsigned int channels,
+		LingotAudioProcessCallback process_callback,
+		void** process_callback_args);
+
 // destroys an audio handler
 void lingot_audio_destroy(LingotAudioHandler*);
 
+// makes the audio handler convert the captured samples straight into the
+// given buffer, of read_buffer_size_samples samples at least, which is the
+// one handed to the process callback. The buffer still belongs to the
+// caller, which can modify it in the callback. It must be called before
+// starting the capture.
+void lingot_audio_lend_buffer(LingotAudioHandler*, FLT* buffer);
+
+// reads a block of samples into the floating point buffer, as the reading
+// thread does. Returns the samples read, or a negative value on error. The
+// audio systems driven by their own callbacks (JACK, PulseAudio) are not
+// read this way.
+int lingot_audio_read(LingotAudioHandler*);
+
+// waits for the next period to be due, as a device would, for the sources
+// that have no clock of their own. If the reader falls behind by more than
+// the buffer, it counts the periods of delay as late and starts over from
+// now.
+void lingot_audio_pace(LingotAudioHandler*);
+
+// the accounting of lingot_audio_pace() for a reader arriving at 'now', on
+// the CLOCK_MONOTONIC time line. It advances the deadline, and returns 1 if
+// the reader has to wait for it, or 0 if it was late.
+int lingot_audio_pace_at(LingotAudioHandler*, const struct timespec* now);
+
 int lingot_audio_start(LingotAudioHandler*);
 void lingot_audio_stop(LingotAudioHandler*);
 
@@ -54,7 +54,7 @@ void lingot_config_scale_allocate(LingotScale* scale, unsigned short int notes)
 	for (i = 0; i < notes; i++) {
 		scale->note_name[i] = 0x0;
 	}
-	scale->offset_cents = malloc(notes * sizeof(FLT));
+	scale->offset_cents = malloc(notes * sizeof(double));
 	scale->offset_ratios[0] = malloc(notes * sizeof(short int));
 	scale->offset_ratios[1] = malloc(notes * sizeof(short int));
 }
@@ -160,13 +160,13 @@ int lingot_config_scale_get_note_index(const LingotScale* scale, int index) {
 	return index2;
 }
 
-FLT lingot_config_scale_get_absolute_offset(const LingotScale* scale, int index) {
+double lingot_config_scale_get_absolute_offset(const LingotScale* scale, int index) {
 	return lingot_config_scale_get_octave(scale, index) * 1200.0
 			+ scale->offset_cents[lingot_config_scale_get_note_index(scale,
 					index)];
 }
 
-FLT lingot_config_scale_get_frequency(const LingotScale* scale, int index) {
+double lingot_config_scale_get_frequency(const LingotScale* scale, int index) {
 	return scale->base_frequency
 			* pow(2.0,
 					lingot_config_scale_get_absolute_offset(scale, index)
@@ -175,12 +175,12 @@ FLT lingot_config_scale_get_frequency(const LingotScale* scale, int index) {
 
 // TODO: test
 int lingot_config_scale_get_closest_note_index(const LingotScale* scale,
-FLT freq, FLT deviation, FLT* error_cents) {
+double freq, double deviation, double* error_cents) {
 
 	short note_index = 0;
 	short int index;
 
-	FLT offset = 1200.0 * log2(freq / scale->base_frequency) - deviation;
+	double offset = 1200.0 * log2(freq / scale->base_frequency) - deviation;
 	int octave = 0;
 	octave = floor(offset / 1200);
 	offset = fmod(offset, 1200.0);
@@ -191,8 +191,8 @@ FLT freq, FLT deviation, FLT* error_cents) {
 	index = floor(scale->notes * offset / 1200.0);
 
 	// TODO: bisection?, avoid loop?
-	FLT pitch_inf;
-	FLT pitch_sup;
+	double pitch_inf;
+	double pitch_sup;
 	int n = 0;
 	for (;;) {
 		n++;
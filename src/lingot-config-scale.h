@@ -32,14 +32,14 @@ typedef struct _LingotScale LingotScale;
 struct _LingotScale {
 	char* name; // name of the scale
 	unsigned short int notes; // number of notes
-	FLT* offset_cents; // offset in cents
+	double* offset_cents; // offset in cents
 	short int* offset_ratios[2]; // offset in ratios (pairs of integers)
-	FLT base_frequency; // frequency of the first note
+	double base_frequency; // frequency of the first note
 	char** note_name; // note names
 
 	// -- internal parameters --
 
-	FLT max_offset_rounded; // round version of maximum offset in cents
+	double max_offset_rounded; // round version of maximum offset in cents
 };
 
 LingotScale* lingot_config_scale_new();
@@ -52,8 +52,8 @@ void lingot_config_scale_copy(LingotScale* dst, LingotScale* src);
 void lingot_config_scale_restore_default_values(LingotScale* scale);
 int lingot_config_scale_get_note_index(const LingotScale* scale, int index);
 int lingot_config_scale_get_octave(const LingotScale* scale, int index);
-FLT lingot_config_scale_get_frequency(const LingotScale* scale, int index);
+double lingot_config_scale_get_frequency(const LingotScale* scale, int index);
 int lingot_config_scale_get_closest_note_index(const LingotScale* scale,
-		FLT freq, FLT deviation, FLT* error_cents);
+		double freq, double deviation, double* error_cents);
 
 #endif /* LINGOT_CONFIG_SCALE_H_ */
@@ -36,12 +36,13 @@
 
 #define MAX(a, b) (((a) > (b)) ? (a) : (b))
 
-#define N_MAX_OPTIONS 30
+#define N_MAX_OPTIONS 40
 
 LingotConfigParameterSpec parameters[N_MAX_OPTIONS];
 unsigned int parameters_count = 0;
 
-const char* audio_systems[] = { "OSS", "ALSA", "JACK", "PulseAudio", NULL };
+const char* audio_systems[] = { "OSS", "ALSA", "JACK", "PulseAudio", "Synth",
+		"File", NULL };
 
 // converts an audio_system_t to a string
 const char* audio_system_t_to_str(audio_system_t audio_system) {
@@ -61,6 +62,26 @@ audio_system_t str_to_audio_system_t(char* audio_system) {
 	return result;
 }
 
+const char* decimation_filters[] = { "IIR", "FIR", "MULTISTAGE", NULL };
+
+// converts a decimation_filter_t to a string
+const char* decimation_filter_t_to_str(decimation_filter_t decimation_filter) {
+	return decimation_filters[decimation_filter];
+}
+
+// converts a string to a decimation_filter_t
+decimation_filter_t str_to_decimation_filter_t(char* decimation_filter) {
+	decimation_filter_t result = -1;
+	int i;
+	for (i = 0; decimation_filters[i] != NULL; i++) {
+		if (!strcmp(decimation_filter, decimation_filters[i])) {
+			result = i;
+			break;
+		}
+	}
+	return result;
+}
+
 //----------------------------------------------------------------------------
 
 static void lingot_config_add_string_parameter_spec(LingotConfigParameterId id,
@@ -102,6 +123,7 @@ static void lingot_config_add_double_parameter_spec(LingotConfigParameterId id,
 void lingot_config_create_parameter_specs() {
 
 	int i = 0;
+	parameters_count = 0;
 	for (i = 0; i < N_MAX_OPTIONS; i++) {
 		parameters[i].id = -1;
 		parameters[i].type = -1;
@@ -128,6 +150,10 @@ void lingot_config_create_parameter_specs() {
 	lingot_config_add_string_parameter_spec(
 			LINGOT_PARAMETER_ID_AUDIO_DEV_PULSEAUDIO, "AUDIO_DEV_PULSEAUDIO",
 			512, 0);
+	lingot_config_add_string_parameter_spec(LINGOT_PARAMETER_ID_AUDIO_DEV_SYNTH,
+			"AUDIO_DEV_SYNTH", 512, 0);
+	lingot_config_add_string_parameter_spec(LINGOT_PARAMETER_ID_AUDIO_DEV_FILE,
+			"AUDIO_DEV_FILE", 512, 0);
 	lingot_config_add_double_parameter_spec(LINGOT_PARAMETER_ID_MIN_SNR,
 			"MIN_SNR", "dB", 0.0, 40.0, 0);
 	lingot_config_add_double_parameter_spec(
@@ -149,6 +175,28 @@ void lingot_config_create_parameter_specs() {
 	lingot_config_add_double_parameter_spec(
 			LINGOT_PARAMETER_ID_MAXIMUM_FREQUENCY, "MAXIMUM_FREQUENCY", "Hz",
 			0.0, 22050.0, 0);
+	lingot_config_add_double_parameter_spec(LINGOT_PARAMETER_ID_NOISE_GATE,
+			"NOISE_GATE", "dBFS", -120.0, 0.0, 0);
+	lingot_config_add_integer_parameter_spec(LINGOT_PARAMETER_ID_PERIOD_SIZE,
+			"PERIOD_SIZE", "samples", 0, 16384, 0);
+	lingot_config_add_integer_parameter_spec(LINGOT_PARAMETER_ID_PERIODS,
+			"PERIODS", NULL, 0, 32, 0);
+	lingot_config_add_string_parameter_spec(LINGOT_PARAMETER_ID_RECORD_FILE,
+			"RECORD_FILE", 512, 0);
+	lingot_config_add_double_parameter_spec(LINGOT_PARAMETER_ID_RECORD_SECONDS,
+			"RECORD_SECONDS", "seconds", 1.0, 3600.0, 0);
+	lingot_config_add_integer_parameter_spec(LINGOT_PARAMETER_ID_RECORD_FILES,
+			"RECORD_FILES", NULL, 1, 1000, 0);
+
+	parameters[LINGOT_PARAMETER_ID_DECIMATION_FILTER].id =
+			LINGOT_PARAMETER_ID_DECIMATION_FILTER;
+	parameters[LINGOT_PARAMETER_ID_DECIMATION_FILTER].type =
+			LINGOT_PARAMETER_TYPE_DECIMATION_FILTER;
+	parameters[LINGOT_PARAMETER_ID_DECIMATION_FILTER].name =
+			"DECIMATION_FILTER";
+	parameters[LINGOT_PARAMETER_ID_DECIMATION_FILTER].units = NULL;
+	parameters[LINGOT_PARAMETER_ID_DECIMATION_FILTER].deprecated = 0;
+	parameters_count++;
 
 	// ----------- obsolete -----------
 	lingot_config_add_double_parameter_spec(LINGOT_PARAMETER_ID_GAIN, "GAIN",
@@ -223,9 +271,17 @@ void lingot_config_restore_default_values(LingotConfig* config) {
 	sprintf(config->audio_dev[AUDIO_SYSTEM_ALSA], "%s", "default");
 	sprintf(config->audio_dev[AUDIO_SYSTEM_JACK], "%s", "default");
 	sprintf(config->audio_dev[AUDIO_SYSTEM_PULSEAUDIO], "%s", "default");
+	sprintf(config->audio_dev[AUDIO_SYSTEM_SYNTH], "%s", "default");
+	sprintf(config->audio_dev[AUDIO_SYSTEM_FILE], "%s", "");
 
 	config->sample_rate = 44100; // Hz
 	config->oversampling = 21;
+	config->decimation_filter = DECIMATION_FILTER_MULTISTAGE;
+	config->period_size = 0; // automatic
+	config->periods = 0; // automatic
+	sprintf(config->record_file, "%s", ""); // not recording
+	config->record_seconds = 60.0;
+	config->record_files = 10;
 	config->root_frequency_error = 0.0; // Hz
 	config->min_frequency = 82.407; // Hz (E2)
 	config->max_frequency = 329.6276; // Hz (E4)
@@ -236,6 +292,7 @@ void lingot_config_restore_default_values(LingotConfig* config) {
 	config->calculation_rate = 15.0; // Hz
 	config->visualization_rate = 24.0; // Hz
 	config->min_overall_SNR = 20.0; // dB
+	config->noise_gate = -70.0; // dBFS
 
 	config->peak_number = 8; // peaks
 	config->peak_half_width = 1; // samples
@@ -248,6 +305,16 @@ void lingot_config_restore_default_values(LingotConfig* config) {
 
 //----------------------------------------------------------------------------
 
+static int lingot_config_is_prime(unsigned int n) {
+	unsigned int d;
+	for (d = 2; d * d <= n; d++) {
+		if (n % d == 0) {
+			return 0;
+		}
+	}
+	return (n > 1);
+}
+
 void lingot_config_update_internal_params(LingotConfig* config) {
 
 	// derived parameters.
@@ -271,6 +338,21 @@ void lingot_config_update_internal_params(LingotConfig* config) {
 		config->oversampling = 1;
 	}
 
+	// the multistage decimator factors the oversampling into prime stages,
+	// a large prime would give a single expensive stage, so we take the
+	// nearest composite factor below, which is the prime minus one (even).
+	// Never above, as the decimated rate must stay over twice the internal
+	// maximum frequency. The analysis rate grows a bit, the resolution of
+	// the FFT drops a bit.
+	if ((config->decimation_filter == DECIMATION_FILTER_MULTISTAGE)
+			&& (config->oversampling > 3)
+			&& lingot_config_is_prime(config->oversampling)) {
+		fprintf(stderr,
+				"warning: the oversampling factor %i is prime, using %i for the multistage decimator\n",
+				config->oversampling, config->oversampling - 1);
+		config->oversampling--;
+	}
+
 	printf("config: sample rate = %i\n", config->sample_rate);
 	printf("config: oversampling = %i\n", config->oversampling);
 	if (config->optimize_internal_parameters) {
@@ -330,6 +412,10 @@ static void lingot_config_map_parameters(LingotConfig* config, void* params[]) {
 							&config->audio_dev[AUDIO_SYSTEM_JACK] }, //
 					{ .id = LINGOT_PARAMETER_ID_AUDIO_DEV_PULSEAUDIO, .value =
 							&config->audio_dev[AUDIO_SYSTEM_PULSEAUDIO] }, //
+					{ .id = LINGOT_PARAMETER_ID_AUDIO_DEV_SYNTH, .value =
+							&config->audio_dev[AUDIO_SYSTEM_SYNTH] }, //
+					{ .id = LINGOT_PARAMETER_ID_AUDIO_DEV_FILE, .value =
+							&config->audio_dev[AUDIO_SYSTEM_FILE] }, //
 					{ .id = LINGOT_PARAMETER_ID_ROOT_FREQUENCY_ERROR, .value =
 							&config->root_frequency_error }, //
 					{ .id = LINGOT_PARAMETER_ID_FFT_SIZE, .value =
@@ -346,6 +432,20 @@ static void lingot_config_map_parameters(LingotConfig* config, void* params[]) {
 							&config->min_frequency }, //
 					{ .id = LINGOT_PARAMETER_ID_MAXIMUM_FREQUENCY, .value =
 							&config->max_frequency }, //
+					{ .id = LINGOT_PARAMETER_ID_DECIMATION_FILTER, .value =
+							&config->decimation_filter }, //
+					{ .id = LINGOT_PARAMETER_ID_NOISE_GATE, .value =
+							&config->noise_gate }, //
+					{ .id = LINGOT_PARAMETER_ID_PERIOD_SIZE, .value =
+							&config->period_size }, //
+					{ .id = LINGOT_PARAMETER_ID_PERIODS, .value =
+							&config->periods }, //
+					{ .id = LINGOT_PARAMETER_ID_RECORD_FILE, .value =
+							&config->record_file }, //
+					{ .id = LINGOT_PARAMETER_ID_RECORD_SECONDS, .value =
+							&config->record_seconds }, //
+					{ .id = LINGOT_PARAMETER_ID_RECORD_FILES, .value =
+							&config->record_files }, //
 					{ .id = -1, .value = NULL }, // null terminated
 			};
 
@@ -404,6 +504,11 @@ void lingot_config_save(LingotConfig* config, char* filename) {
 				fprintf(fp, "%s",
 						audio_system_t_to_str(*((audio_system_t*) param)));
 				break;
+			case LINGOT_PARAMETER_TYPE_DECIMATION_FILTER:
+				fprintf(fp, "%s",
+						decimation_filter_t_to_str(
+								*((decimation_filter_t*) param)));
+				break;
 			}
 
 			if (parameters[i].units != NULL) {
@@ -454,6 +559,7 @@ void lingot_config_load(LingotConfig* config, char* filename) {
 	int parse_errors = 0;
 	int scale_errors = 0;
 	LingotScale* scale = NULL;
+	char* line_end;
 
 	// restore default values for non specified parameters
 	lingot_config_restore_default_values(config);
@@ -486,6 +592,7 @@ void lingot_config_load(LingotConfig* config, char* filename) {
 		}
 
 		// tokens into the line.
+		line_end = char_buffer + strlen(char_buffer);
 		char_buffer_pointer = strtok(char_buffer, delim);
 
 		if (!char_buffer_pointer) {
@@ -633,7 +740,35 @@ void lingot_config_load(LingotConfig* config, char* filename) {
 
 		if (param != NULL) {
 			// take the attribute value.
-			char_buffer_pointer = strtok(NULL, delim);
+			if (parameters[option_index].type
+					== LINGOT_PARAMETER_TYPE_STRING) {
+				// strings are the rest of the line after the '=', trimmed,
+				// as they can contain the delimiters (device options like
+				// freq=440 or paths with spaces).
+				char_buffer_pointer += strlen(char_buffer_pointer);
+				if (char_buffer_pointer < line_end) {
+					char_buffer_pointer++;
+				}
+				char_buffer_pointer += strspn(char_buffer_pointer, " \t");
+				if (*char_buffer_pointer == '=') {
+					char_buffer_pointer++;
+				}
+				char_buffer_pointer += strspn(char_buffer_pointer, " \t");
+				nl = line_end;
+				while ((nl > char_buffer_pointer)
+						&& strchr(" \t\r\n", nl[-1])) {
+					nl--;
+				}
+				*nl = '\0';
+
+				// strings can be empty.
+				if (*char_buffer_pointer == '\0') {
+					((char*) param)[0] = '\0';
+					continue;
+				}
+			} else {
+				char_buffer_pointer = strtok(NULL, delim);
+			}
 
 			if (!char_buffer_pointer) {
 				fprintf(stderr,
@@ -646,6 +781,7 @@ void lingot_config_load(LingotConfig* config, char* filename) {
 			int int_value;
 			double double_value;
 			audio_system_t audio_system_value;
+			decimation_filter_t decimation_filter_value;
 
 			// asign the value to the parameter.
 			switch (parameters[option_index].type) {
@@ -728,6 +864,21 @@ void lingot_config_load(LingotConfig* config, char* filename) {
 					parse_errors = 1;
 				}
 				break;
+			case LINGOT_PARAMETER_TYPE_DECIMATION_FILTER:
+				decimation_filter_value = str_to_decimation_filter_t(
+						char_buffer_pointer);
+				if (decimation_filter_value != (decimation_filter_t) -1) {
+					*((decimation_filter_t*) param) = decimation_filter_value;
+				} else {
+					fprintf(stderr,
+							"error: parse error at line %i, '%s = %s': invalid value (allowed values are IIR, FIR and MULTISTAGE), assuming default value %s\n",
+							line, parameters[option_index].name,
+							char_buffer_pointer,
+							decimation_filter_t_to_str(
+									*((decimation_filter_t*) param)));
+					parse_errors = 1;
+				}
+				break;
 			}
 		}
 	}
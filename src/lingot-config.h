@@ -35,6 +35,8 @@ typedef enum LingotConfigParameterId {
 	LINGOT_PARAMETER_ID_AUDIO_DEV_ALSA, //
 	LINGOT_PARAMETER_ID_AUDIO_DEV_JACK, //
 	LINGOT_PARAMETER_ID_AUDIO_DEV_PULSEAUDIO, //
+	LINGOT_PARAMETER_ID_AUDIO_DEV_SYNTH, //
+	LINGOT_PARAMETER_ID_AUDIO_DEV_FILE, //
 	LINGOT_PARAMETER_ID_ROOT_FREQUENCY_ERROR, //
 	LINGOT_PARAMETER_ID_FFT_SIZE, //
 	LINGOT_PARAMETER_ID_TEMPORAL_WINDOW, //
@@ -43,6 +45,13 @@ typedef enum LingotConfigParameterId {
 	LINGOT_PARAMETER_ID_VISUALIZATION_RATE, //
 	LINGOT_PARAMETER_ID_MINIMUM_FREQUENCY, //
 	LINGOT_PARAMETER_ID_MAXIMUM_FREQUENCY, //
+	LINGOT_PARAMETER_ID_DECIMATION_FILTER, //
+	LINGOT_PARAMETER_ID_NOISE_GATE, //
+	LINGOT_PARAMETER_ID_PERIOD_SIZE, //
+	LINGOT_PARAMETER_ID_PERIODS, //
+	LINGOT_PARAMETER_ID_RECORD_FILE, //
+	LINGOT_PARAMETER_ID_RECORD_SECONDS, //
+	LINGOT_PARAMETER_ID_RECORD_FILES, //
 	// ------- obsolete ---------
 	LINGOT_PARAMETER_ID_MIN_FREQUENCY, //
 	LINGOT_PARAMETER_ID_GAIN, //
@@ -62,7 +71,8 @@ typedef enum LingotConfigParameterType {
 	LINGOT_PARAMETER_TYPE_STRING,
 	LINGOT_PARAMETER_TYPE_INTEGER,
 	LINGOT_PARAMETER_TYPE_FLOAT,
-	LINGOT_PARAMETER_TYPE_AUDIO_SYSTEM
+	LINGOT_PARAMETER_TYPE_AUDIO_SYSTEM,
+	LINGOT_PARAMETER_TYPE_DECIMATION_FILTER
 } LingotConfigParameterType;
 
 typedef struct _LingotConfigParameterSpec LingotConfigParameterSpec;
@@ -89,7 +99,9 @@ typedef enum audio_system_t {
 	AUDIO_SYSTEM_OSS = 0,
 	AUDIO_SYSTEM_ALSA = 1,
 	AUDIO_SYSTEM_JACK = 2,
-	AUDIO_SYSTEM_PULSEAUDIO = 3
+	AUDIO_SYSTEM_PULSEAUDIO = 3,
+	AUDIO_SYSTEM_SYNTH = 4,
+	AUDIO_SYSTEM_FILE = 5
 } audio_system_t;
 
 typedef enum window_type_t {
@@ -98,6 +110,14 @@ typedef enum window_type_t {
 	HAMMING = 2
 } window_type_t;
 
+typedef enum decimation_filter_t {
+	DECIMATION_FILTER_IIR = 0, // Chebyshev, applied on every input sample
+	DECIMATION_FILTER_FIR = 1, // polyphase FIR, only on the kept samples
+	// cascade of FIR, one per prime factor. A prime oversampling factor is
+	// lowered by one to get several stages, with a warning.
+	DECIMATION_FILTER_MULTISTAGE = 2
+} decimation_filter_t;
+
 typedef struct _LingotConfig LingotConfig;
 
 // Configuration struct. Determines the tuner behaviour.
@@ -106,9 +126,21 @@ struct _LingotConfig {
 
 	audio_system_t audio_system;
 
-	char audio_dev[4][512];
+	char audio_dev[6][512];
 	int sample_rate; // soundcard sample rate.
 	unsigned int oversampling; // oversampling factor.
+	decimation_filter_t decimation_filter; // antialiasing filter type.
+
+	// capture period requested to the audio system, 0 for automatic.
+	unsigned int period_size; // samples
+	unsigned int periods; // periods per buffer
+
+	// recording of the captured audio, in files of record_seconds named
+	// <record_file>-<n>.wav, keeping the last record_files of them. Not
+	// recording with an empty record_file.
+	char record_file[512];
+	FLT record_seconds;
+	unsigned int record_files;
 
 	FLT root_frequency_error; // deviation of the above root frequency.
 
@@ -134,6 +166,10 @@ struct _LingotConfig {
 	FLT min_overall_SNR; // dB
 	FLT min_SNR; // dB
 
+	// level under which the input is considered silence, and the analysis
+	// is skipped.
+	FLT noise_gate; // dBFS
+
 	window_type_t window_type;
 
 	// frequency finding algorithm configuration
@@ -161,6 +197,10 @@ struct _LingotConfig {
 const char* audio_system_t_to_str(audio_system_t audio_system);
 // converts a string to an audio_system_t
 audio_system_t str_to_audio_system_t(char* audio_system);
+// converts a decimation_filter_t to a string
+const char* decimation_filter_t_to_str(decimation_filter_t decimation_filter);
+// converts a string to a decimation_filter_t
+decimation_filter_t str_to_decimation_filter_t(char* decimation_filter);
 
 void lingot_config_create_parameter_specs();
 LingotConfigParameterSpec lingot_config_get_parameter_spec(
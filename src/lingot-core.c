@@ -30,6 +30,10 @@
 #include <sys/time.h>
 #include <time.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/eventfd.h>
 
 #ifndef LIBFFTW
 #include "lingot-complex.h"
@@ -42,37 +46,130 @@
 #include "lingot-i18n.h"
 #include "lingot-msg.h"
 
-int
-lingot_core_read_callback(FLT* read_buffer, int samples_read, void *arg);
-
 void lingot_core_run_computation_thread(LingotCore* core);
 
-int decimation_input_index = 0;
-
-LingotCore* lingot_core_new(LingotConfig* conf) {
+static LingotCore* lingot_core_new_empty(LingotConfig* conf) {
 
-	char buff[1000];
 	LingotCore* core = malloc(sizeof(LingotCore));
 
 	core->conf = conf;
 	core->running = 0;
 	core->audio = NULL;
+	core->recorder = NULL;
 	core->spd_fft = NULL;
 	core->noise_level = NULL;
 	core->SPL = NULL;
 	core->flt_read_buffer = NULL;
-	core->temporal_buffer = NULL;
-	core->windowed_temporal_buffer = NULL;
+	core->temporal_ring_buffer = NULL;
+	core->snapshot_retries = 0;
 	core->windowed_fft_buffer = NULL;
 	core->hamming_window_temporal = NULL;
 	core->hamming_window_fft = NULL;
-	core->antialiasing_filter = NULL;
+	core->decimator = NULL;
+	core->fftplan = NULL;
+	core->thread_computation_done = 0;
+	core->hop_eventfd = -1;
+	core->hop_size = 1;
+	core->hop_pending = 0;
+	core->skipped_hops = 0;
+	core->analyses = 0;
+	core->blocks = 0;
+	core->gate_threshold = 0.0;
+	core->gate_hold = 0;
+	core->gate_open = 0;
+
+	core->frequency_locker.locked = 0;
+	core->frequency_locker.current_frequency = -1.0;
+	core->frequency_locker.hits_counter = 0;
+	core->frequency_locker.rehits_counter = 0;
+	core->frequency_locker.rehits_up_counter = 0;
+	core->frequency_locker.old_multiplier = 0.0;
+	core->frequency_locker.old_multiplier2 = 0.0;
 
 #ifdef DRAW_MARKERS
 	core->markers_size = 0;
 	core->markers_size2 = 0;
 #endif
 
+	return core;
+}
+
+// allocates the analysis buffers, for audio blocks of up to read_buffer_size
+// samples.
+static void lingot_core_allocate(LingotCore* core, int read_buffer_size) {
+
+	char buff[1000];
+	LingotConfig* conf = core->conf;
+
+	if (conf->temporal_buffer_size < conf->fft_size) {
+		conf->temporal_window = ((double) conf->fft_size
+				* conf->oversampling) / conf->sample_rate;
+		conf->temporal_buffer_size = conf->fft_size;
+		lingot_config_update_internal_params(conf);
+		snprintf(buff, sizeof(buff),
+				_(
+						"The temporal buffer is smaller than FFT size. It has been increased to %0.3f seconds"),
+				conf->temporal_window);
+		lingot_msg_add_warning(buff);
+	}
+
+	// Since the SPD is symmetrical, we only store the 1st half.
+	int spd_size = (core->conf->fft_size / 2);
+
+	core->spd_fft = malloc(spd_size * sizeof(FLT));
+	core->noise_level = malloc(spd_size * sizeof(FLT));
+	core->SPL = malloc(spd_size * sizeof(FLT));
+
+	memset(core->spd_fft, 0, spd_size * sizeof(FLT));
+	memset(core->noise_level, 0, spd_size * sizeof(FLT));
+	memset(core->SPL, 0, spd_size * sizeof(FLT));
+
+	// audio source read in floating point format. The audio handler
+	// converts the samples straight into it.
+	core->flt_read_buffer = malloc(read_buffer_size * sizeof(FLT));
+	memset(core->flt_read_buffer, 0, read_buffer_size * sizeof(FLT));
+
+	// stored samples, shared with the audio thread. The extra room gives
+	// the audio thread space to keep writing while the computation
+	// thread is reading the newest temporal_buffer_size samples.
+	core->temporal_ring_buffer = lingot_ring_buffer_new(
+			2 * core->conf->temporal_buffer_size);
+
+	core->hamming_window_temporal = NULL;
+	core->hamming_window_fft = NULL;
+
+	if (conf->window_type != NONE) {
+		core->hamming_window_temporal = malloc(
+				(core->conf->temporal_buffer_size) * sizeof(FLT));
+		core->hamming_window_fft = malloc((core->conf->fft_size) * sizeof(FLT));
+
+		lingot_signal_window(core->conf->temporal_buffer_size,
+				core->hamming_window_temporal, conf->window_type);
+		lingot_signal_window(core->conf->fft_size, core->hamming_window_fft,
+				conf->window_type);
+	}
+
+	core->windowed_fft_buffer = malloc((core->conf->fft_size) * sizeof(FLT));
+	memset(core->windowed_fft_buffer, 0, core->conf->fft_size * sizeof(FLT));
+
+	core->fftplan = lingot_fft_plan_create(core->windowed_fft_buffer,
+			core->conf->fft_size);
+
+	core->decimator = lingot_decimator_new(conf->decimation_filter,
+			conf->oversampling);
+
+	// at the lowest level the gate is disabled.
+	if (conf->noise_gate <= -120.0) {
+		core->gate_threshold = -1.0;
+	} else {
+		core->gate_threshold = FLT_SAMPLE_SCALE * FLT_SAMPLE_SCALE
+				* pow(10.0, conf->noise_gate / 10.0);
+	}
+}
+
+LingotCore* lingot_core_new(LingotConfig* conf) {
+
+	LingotCore* core = lingot_core_new_empty(conf);
 	int requested_sample_rate = conf->sample_rate;
 
 	if (conf->sample_rate <= 0) {
@@ -81,6 +178,7 @@ LingotCore* lingot_core_new(LingotConfig* conf) {
 
 	core->audio = lingot_audio_new(conf->audio_system,
 			conf->audio_dev[conf->audio_system], conf->sample_rate,
+			conf->period_size, conf->periods,
 			(LingotAudioProcessCallback) lingot_core_read_callback, core);
 
 	if (core->audio != NULL) {
@@ -94,93 +192,47 @@ LingotCore* lingot_core_new(LingotConfig* conf) {
 //			lingot_msg_add_warning(buff);
 		}
 
-		if (conf->temporal_buffer_size < conf->fft_size) {
-			conf->temporal_window = ((double) conf->fft_size
-					* conf->oversampling) / conf->sample_rate;
-			conf->temporal_buffer_size = conf->fft_size;
-			lingot_config_update_internal_params(conf);
-			snprintf(buff, sizeof(buff),
-					_(
-							"The temporal buffer is smaller than FFT size. It has been increased to %0.3f seconds"),
-					conf->temporal_window);
-			lingot_msg_add_warning(buff);
+#		ifdef LINGOT_PRINT_STATS
+		printf("audio: %i samples per period, %u periods, %.1f ms latency\n",
+				core->audio->read_buffer_size_samples, core->audio->periods,
+				core->audio->latency);
+#		endif
+
+		lingot_core_allocate(core, core->audio->read_buffer_size_samples);
+		lingot_audio_lend_buffer(core->audio, core->flt_read_buffer);
+
+		// one analysis every calculation_rate-th of a second of audio.
+		core->hop_size = (unsigned int) floor(
+				0.5 + conf->sample_rate
+						/ (conf->oversampling * conf->calculation_rate));
+		if (core->hop_size < 1) {
+			core->hop_size = 1;
 		}
+		core->hop_eventfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+		if (core->hop_eventfd < 0) {
+			perror("eventfd");
+			lingot_audio_destroy(core->audio);
+			core->audio = NULL;
+		} else {
+			core->running = 1;
+		}
+	}
 
-		// Since the SPD is symmetrical, we only store the 1st half.
-		int spd_size = (core->conf->fft_size / 2);
-
-		core->spd_fft = malloc(spd_size * sizeof(FLT));
-		core->noise_level = malloc(spd_size * sizeof(FLT));
-		core->SPL = malloc(spd_size * sizeof(FLT));
-
-		memset(core->spd_fft, 0, spd_size * sizeof(FLT));
-		memset(core->noise_level, 0, spd_size * sizeof(FLT));
-		memset(core->SPL, 0, spd_size * sizeof(FLT));
+	if ((core->audio != NULL) && (conf->record_file[0] != '\0')) {
+		core->recorder = lingot_recorder_new(conf->record_file,
+				conf->sample_rate, core->audio->read_buffer_size_samples,
+				conf->record_seconds, conf->record_files);
+	}
 
-		// audio source read in floating point format.
-		core->flt_read_buffer = malloc(
-				core->audio->read_buffer_size_samples * sizeof(FLT));
-		memset(core->flt_read_buffer, 0,
-				core->audio->read_buffer_size_samples * sizeof(FLT));
+	core->freq = 0.0;
+	return core;
+}
 
-		// stored samples.
-		core->temporal_buffer = malloc(
-				(core->conf->temporal_buffer_size) * sizeof(FLT));
-		memset(core->temporal_buffer, 0,
-				core->conf->temporal_buffer_size * sizeof(FLT));
-
-		core->hamming_window_temporal = NULL;
-		core->hamming_window_fft = NULL;
-
-		if (conf->window_type != NONE) {
-			core->hamming_window_temporal = malloc(
-					(core->conf->temporal_buffer_size) * sizeof(FLT));
-			core->hamming_window_fft = malloc(
-					(core->conf->fft_size) * sizeof(FLT));
-
-			lingot_signal_window(core->conf->temporal_buffer_size,
-					core->hamming_window_temporal, conf->window_type);
-			lingot_signal_window(core->conf->fft_size, core->hamming_window_fft,
-					conf->window_type);
-		}
+LingotCore* lingot_core_new_stream(LingotConfig* conf, int read_buffer_size) {
 
-		core->windowed_temporal_buffer = malloc(
-				(core->conf->temporal_buffer_size) * sizeof(FLT));
-		memset(core->windowed_temporal_buffer, 0,
-				core->conf->temporal_buffer_size * sizeof(FLT));
-		core->windowed_fft_buffer = malloc(
-				(core->conf->fft_size) * sizeof(FLT));
-		memset(core->windowed_fft_buffer, 0,
-				core->conf->fft_size * sizeof(FLT));
-
-		core->fftplan = lingot_fft_plan_create(core->windowed_fft_buffer,
-				core->conf->fft_size);
-
-		/*
-		 * 8 order Chebyshev filters, with wc=0.9/i (normalised respect to
-		 * Pi). We take 0.9 instead of 1 to leave a 10% of safety margin,
-		 * in order to avoid aliased frequencies near to w=Pi, due to non
-		 * ideality of the filter.
-		 *
-		 * The cut frequencies wc=Pi/i, with i=1..20, correspond with the
-		 * oversampling factor, avoiding aliasing at decimation.
-		 *
-		 * Why Chebyshev filters?, for a given order, those filters yield
-		 * abrupt falls than other ones as Butterworth, making the most of
-		 * the order. Although Chebyshev filters affect more to the phase,
-		 * it doesn't matter due to the analysis is made on the signal
-		 * power distribution (only magnitude).
-		 */
-		core->antialiasing_filter = lingot_filter_cheby_design(8, 0.5,
-				0.9 / core->conf->oversampling);
-
-		pthread_mutex_init(&core->temporal_buffer_mutex, NULL);
-
-		// ------------------------------------------------------------
-
-		core->running = 1;
-	}
+	LingotCore* core = lingot_core_new_empty(conf);
 
+	lingot_core_allocate(core, read_buffer_size);
 	core->freq = 0.0;
 	return core;
 }
@@ -191,24 +243,33 @@ LingotCore* lingot_core_new(LingotConfig* conf) {
 void lingot_core_destroy(LingotCore* core) {
 
 	if (core->audio != NULL) {
-		lingot_fft_plan_destroy(core->fftplan);
 		lingot_audio_destroy(core->audio);
 		core->audio = 0x0;
+	}
+
+	// once the audio is gone nothing else is pushed.
+	if (core->recorder != NULL) {
+		lingot_recorder_destroy(core->recorder);
+		core->recorder = NULL;
+	}
+
+	if (core->hop_eventfd >= 0) {
+		close(core->hop_eventfd);
+	}
+
+	if (core->fftplan != NULL) {
+		lingot_fft_plan_destroy(core->fftplan);
 
 		free(core->spd_fft);
 		free(core->noise_level);
 		free(core->SPL);
 		free(core->flt_read_buffer);
-		free(core->temporal_buffer);
+		lingot_ring_buffer_destroy(core->temporal_ring_buffer);
 
 		if (core->hamming_window_fft != NULL) {
 			free(core->hamming_window_temporal);
 		}
 
-		if (core->windowed_temporal_buffer != NULL) {
-			free(core->windowed_temporal_buffer);
-		}
-
 		if (core->hamming_window_fft != NULL) {
 			free(core->hamming_window_fft);
 		}
@@ -217,11 +278,9 @@ void lingot_core_destroy(LingotCore* core) {
 			free(core->windowed_fft_buffer);
 		}
 
-		if (core->antialiasing_filter != NULL) {
-			lingot_filter_destroy(core->antialiasing_filter);
+		if (core->decimator != NULL) {
+			lingot_decimator_destroy(core->decimator);
 		}
-
-		pthread_mutex_destroy(&core->temporal_buffer_mutex);
 	}
 
 	free(core);
@@ -233,14 +292,15 @@ void lingot_core_destroy(LingotCore* core) {
 // decimation and appends it to the buffer
 int lingot_core_read_callback(FLT* read_buffer, int samples_read, void *arg) {
 
-	unsigned int i, decimation_output_index; // loop variables.
+	unsigned int i; // loop variables.
 	int decimation_output_len;
-	FLT* decimation_in;
-	FLT* decimation_out;
+	unsigned int room;
+	FLT* decimated;
+	int gate_was_open;
+	FLT power = 0.0;
+	uint64_t hops = 0;
 	LingotCore* core = (LingotCore*) arg;
-	const LingotConfig* conf = core->conf;
 
-	memcpy(core->flt_read_buffer, read_buffer, samples_read * sizeof(FLT));
 //	double omega = 2.0 * M_PI * 100.0;
 //	double T = 1.0 / conf->sample_rate;
 //	static double t = 0.0;
@@ -265,104 +325,75 @@ int lingot_core_read_callback(FLT* read_buffer, int samples_read, void *arg) {
 	// <----------------------------> samples_read
 	//
 
-	decimation_output_len = 1
-			+ (samples_read - (decimation_input_index + 1))
-					/ conf->oversampling;
-
-//#define DUMP
-
-#ifdef DUMP
-	static FILE* fid0 = 0x0;
-	if (fid0 == 0x0) {
-		fid0 = fopen("/tmp/dump_pre_filter.txt", "w");
+	// the recorder takes a copy of the block before we decimate it in
+	// place. It never blocks.
+	if (core->recorder != NULL) {
+		lingot_recorder_push(core->recorder, read_buffer, samples_read);
 	}
 
-	for (i = 0; i < samples_read; i++) {
-		fprintf(fid0, "%f ", core->flt_read_buffer[i]);
+	// decimation with low-pass filtering, straight into the sample history
+	// when the decimator doesn't need more room than the one a reader can
+	// spare. Otherwise we decimate in place and append the result. The ring
+	// buffer is lock-free, the computation thread never makes us wait here.
+	room = lingot_decimator_output_room(core->decimator, samples_read);
+	if (room
+			<= core->temporal_ring_buffer->size
+					- core->conf->temporal_buffer_size) {
+		decimated = lingot_ring_buffer_write_begin(core->temporal_ring_buffer,
+				room);
+		decimation_output_len = lingot_decimator_decimate(core->decimator,
+				read_buffer, samples_read, decimated);
+		lingot_ring_buffer_write_commit(core->temporal_ring_buffer,
+				decimation_output_len);
+	} else {
+		decimated = read_buffer;
+		decimation_output_len = lingot_decimator_decimate(core->decimator,
+				read_buffer, samples_read, decimated);
+		lingot_ring_buffer_write(core->temporal_ring_buffer, decimated,
+				decimation_output_len);
 	}
-#endif
+	__atomic_store_n(&core->blocks, core->blocks + 1, __ATOMIC_RELAXED);
 
-	pthread_mutex_lock(&core->temporal_buffer_mutex);
-
-	/* we shift the temporal window to leave a hollow where place the new piece
-	 of data read. The buffer is actually a queue. */
-	if (conf->temporal_buffer_size > decimation_output_len) {
-		memmove(core->temporal_buffer,
-				&core->temporal_buffer[decimation_output_len],
-				(conf->temporal_buffer_size - decimation_output_len)
-						* sizeof(FLT));
+	// energy of the block, on the decimated signal, as it is cheaper and
+	// only holds the band we analyze.
+	for (i = 0; i < decimation_output_len; i++) {
+		power += decimated[i] * decimated[i];
 	}
 
-	//
-	// previous buffer situation:
-	//
-	//  ------------------------------------------
-	// | xxxxxxxxxxxxxxxxxxxxxx | yyyyy | aaaaaaa |
-	//  ------------------------------------------
-	//                                    <------> samples_read/oversampling
-	//                           <---------------> fft_size
-	//  <----------------------------------------> temporal_buffer_size
-	//
-	// new situation:
-	//
-	//  ------------------------------------------
-	// | xxxxxxxxxxxxxxxxyyyyaa | aaaaa |         |
-	//  ------------------------------------------
-	//
-
-	// decimation with low-pass filtering
-
-	/* we decimate the signal and append it at the end of the buffer. */
-	if (conf->oversampling > 1) {
-
-		decimation_in = core->flt_read_buffer;
-		decimation_out = &core->temporal_buffer[conf->temporal_buffer_size
-				- decimation_output_len];
-
-		// low pass filter to avoid aliasing.
-		lingot_filter_filter(core->antialiasing_filter, samples_read,
-				decimation_in, decimation_in);
-
-		// compression.
-		for (decimation_output_index = 0; decimation_input_index < samples_read;
-				decimation_output_index++, decimation_input_index +=
-						conf->oversampling) {
-			decimation_out[decimation_output_index] =
-					decimation_in[decimation_input_index];
-		}
-		decimation_input_index -= samples_read;
+	// the gate stays open until a whole temporal window of silence has
+	// gone through the sample memory.
+	gate_was_open = core->gate_open;
+	if ((decimation_output_len > 0)
+			&& (power > core->gate_threshold * decimation_output_len)) {
+		core->gate_hold = core->conf->temporal_buffer_size;
+	} else if (core->gate_hold > decimation_output_len) {
+		core->gate_hold -= decimation_output_len;
 	} else {
-		memcpy(
-				&core->temporal_buffer[conf->temporal_buffer_size
-						- decimation_output_len], core->flt_read_buffer,
-				decimation_output_len * sizeof(FLT));
-	}
-	//
-	//  ------------------------------------------
-	// | xxxxxxxxxxxxxxxxyyyyaa | aaaaa | bbbbbbb |
-	//  ------------------------------------------
-	//
-
-	pthread_mutex_unlock(&core->temporal_buffer_mutex);
-
-#ifdef DUMP
-	static FILE* fid1 = 0x0;
-	static FILE* fid2 = 0x0;
-
-	if (fid1 == 0x0) {
-		fid1 = fopen("/tmp/dump_post_filter.txt", "w");
-		fid2 = fopen("/tmp/dump_post.txt", "w");
+		core->gate_hold = 0;
 	}
+	__atomic_store_n(&core->gate_open, core->gate_hold > 0, __ATOMIC_RELEASE);
+
+	// wakes up the computation thread once per hop, right away on an onset,
+	// and once more when the gate closes, to publish the silence. Nothing
+	// is signaled on silence. Writing an eventfd never blocks nor takes a
+	// lock, so it is fine from a realtime thread.
+	if (core->hop_eventfd >= 0) {
+		if (core->gate_open && !gate_was_open) {
+			core->hop_pending = 0;
+			hops = 1;
+		} else if (core->gate_open) {
+			core->hop_pending += decimation_output_len;
+			hops = core->hop_pending / core->hop_size;
+			core->hop_pending -= hops * core->hop_size;
+		} else if (gate_was_open) {
+			hops = 1;
+		}
 
-	for (i = 0; i < samples_read; i++) {
-		fprintf(fid1, "%f ", core->flt_read_buffer[i]);
-	}
-	decimation_out = &core->temporal_buffer[conf->temporal_buffer_size
-	- decimation_output_len];
-	for (i = 0; i < decimation_output_len; i++) {
-		fprintf(fid2, "%f ", decimation_out[i]);
+		if ((hops > 0)
+				&& (write(core->hop_eventfd, &hops, sizeof(hops)) < 0)) {
+			// the counter can only overflow if nobody reads it.
+		}
 	}
-#endif
 
 	return 0;
 }
@@ -418,96 +449,91 @@ FLT* mulFreq1ToFreq, FLT* mulFreq2ToFreq) {
 	return result;
 }
 
-static FLT lingot_core_frequency_locker(FLT freq, FLT minFrequency) {
+static double lingot_core_frequency_locker(LingotFrequencyLocker* locker,
+		double freq, FLT minFrequency) {
 
-	static int locked = 0;
-	static FLT current_frequency = -1.0;
-	static int hits_counter = 0;
-	static int rehits_counter = 0;
-	static int rehits_up_counter = 0;
 	static const int nhits_to_lock = 4;
 	static const int nhits_to_unlock = 5;
 	static const int nhits_to_relock = 6;
 	static const int nhits_to_relock_up = 8;
 	FLT multiplier = 0.0;
 	FLT multiplier2 = 0.0;
-	static FLT old_multiplier = 0.0;
-	static FLT old_multiplier2 = 0.0;
 	int fail = 0;
-	FLT result = 0.0;
+	double result = 0.0;
 
 #ifdef DRAW_MARKERS
 	printf("f = %f\n", freq);
 #endif
 	int consistent_with_current_frequency = 0;
 	consistent_with_current_frequency = lingot_core_frequencies_related(freq,
-			current_frequency, minFrequency, &multiplier, &multiplier2);
+			locker->current_frequency, minFrequency, &multiplier, &multiplier2);
 
-	if (!locked) {
+	if (!locker->locked) {
 
-		if ((freq > 0.0) && (current_frequency == 0.0)) {
+		if ((freq > 0.0) && (locker->current_frequency == 0.0)) {
 			consistent_with_current_frequency = 1;
 			multiplier = 1.0;
 			multiplier2 = 1.0;
 		}
 
-//		printf("filtering frequency %f, current %f\n", freq, current_frequency);
+//		printf("filtering frequency %f, current %f\n", freq, locker->current_frequency);
 
 		if (consistent_with_current_frequency && (multiplier == 1.0)
 				&& (multiplier2 == 1.0)) {
-			current_frequency = freq * multiplier;
+			locker->current_frequency = freq * multiplier;
 
-			if (++hits_counter >= nhits_to_lock) {
-				locked = 1;
+			if (++locker->hits_counter >= nhits_to_lock) {
+				locker->locked = 1;
 #ifdef DRAW_MARKERS
-				printf("locked to frequency %f\n", current_frequency);
+				printf("locked to frequency %f\n",
+						locker->current_frequency);
 #endif
-				hits_counter = 0;
+				locker->hits_counter = 0;
 			}
 		} else {
-			hits_counter = 0;
-			current_frequency = 0.0;
+			locker->hits_counter = 0;
+			locker->current_frequency = 0.0;
 		}
 
 //		result = freq;
 	} else {
 //		printf("c = %i, f = %f, cf = %f, multiplier = %f, multiplier2 = %f\n",
-//				consistent_with_current_frequency, freq, current_frequency,
+//				consistent_with_current_frequency, freq, locker->current_frequency,
 //				multiplier, multiplier2);
 
 		if (consistent_with_current_frequency) {
 			if (fabs(multiplier2 - 1.0) < 1e-5) {
 				result = freq * multiplier;
-				current_frequency = result;
-				rehits_counter = 0;
+				locker->current_frequency = result;
+				locker->rehits_counter = 0;
 
 				if (fabs(multiplier - 1.0) > 1e-5) {
-					if (fabs(multiplier - old_multiplier) < 1e-5) {
+					if (fabs(multiplier - locker->old_multiplier) < 1e-5) {
 #ifdef DRAW_MARKERS
 						printf("SEIN!!!! %f!\n", multiplier);
 #endif
-						if (++rehits_up_counter >= nhits_to_relock_up) {
+						if (++locker->rehits_up_counter >= nhits_to_relock_up) {
 							result = freq;
-							current_frequency = result;
+							locker->current_frequency = result;
 #ifdef DRAW_MARKERS
 							printf("relock UP!! to %f\n\n\n", freq);
 #endif
-							rehits_up_counter = 0;
+							locker->rehits_up_counter = 0;
 							fail = 0;
 						}
 					} else {
-						rehits_up_counter = 0;
+						locker->rehits_up_counter = 0;
 					}
 				} else {
-					rehits_up_counter = 0;
+					locker->rehits_up_counter = 0;
 				}
 			} else {
-				rehits_up_counter = 0;
+				locker->rehits_up_counter = 0;
 #ifdef DRAW_MARKERS
 				printf("%f!\n", multiplier2);
 #endif
 				if (fabs(multiplier2 - 0.5) < 1e-5) {
-					hits_counter--;
+					locker->hits_counter--;
 				}
 				fail = 1;
 				if (freq * multiplier < minFrequency) {
@@ -518,23 +544,24 @@ static FLT lingot_core_frequency_locker(FLT freq, FLT minFrequency) {
 				} else {
 //					result = freq * multiplier;
 //					printf("hop detected!\n");
-//					current_frequency = result;
+//					locker->current_frequency = result;
 
 #ifdef DRAW_MARKERS
-					printf("(%f == %f)?\n", multiplier2, old_multiplier2);
+					printf("(%f == %f)?\n", multiplier2,
+							locker->old_multiplier2);
 #endif
-					if (fabs(multiplier2 - old_multiplier2) < 1e-5) {
+					if (fabs(multiplier2 - locker->old_multiplier2) < 1e-5) {
 #ifdef DRAW_MARKERS
 						printf("match for relock, %f == %f\n", multiplier2,
-								old_multiplier2);
+								locker->old_multiplier2);
 #endif
-						if (++rehits_counter >= nhits_to_relock) {
+						if (++locker->rehits_counter >= nhits_to_relock) {
 							result = freq * multiplier;
-							current_frequency = result;
+							locker->current_frequency = result;
 #ifdef DRAW_MARKERS
 							printf("relock!! to %f\n", freq);
 #endif
-							rehits_counter = 0;
+							locker->rehits_counter = 0;
 							fail = 0;
 						}
 					}
@@ -546,30 +573,65 @@ static FLT lingot_core_frequency_locker(FLT freq, FLT minFrequency) {
 		}
 
 		if (fail) {
-			result = current_frequency;
-			hits_counter++;
-			if (hits_counter >= nhits_to_unlock) {
-				current_frequency = 0.0;
-				locked = 0;
-				hits_counter = 0;
+			result = locker->current_frequency;
+			locker->hits_counter++;
+			if (locker->hits_counter >= nhits_to_unlock) {
+				locker->current_frequency = 0.0;
+				locker->locked = 0;
+				locker->hits_counter = 0;
 #ifdef DRAW_MARKERS
 				printf("unlocked\n");
 #endif
 				result = 0.0;
 			}
 		} else {
-			hits_counter = 0;
+			locker->hits_counter = 0;
 		}
 	}
 
-	old_multiplier = multiplier;
-	old_multiplier2 = multiplier2;
+	locker->old_multiplier = multiplier;
+	locker->old_multiplier2 = multiplier2;
 
 //	if (result != 0.0)
 //		printf("result = %f\n", result);
 	return result;
 }
 
+// copies n samples applying the given window, if any.
+static void lingot_core_window(const FLT* in, const FLT* window, FLT* out,
+		unsigned int n) {
+	register unsigned int i;
+
+	if (window != NULL) {
+		for (i = 0; i < n; i++) {
+			out[i] = in[i] * window[i];
+		}
+	} else {
+		memcpy(out, in, n * sizeof(FLT));
+	}
+}
+
+// floor of the spectrum, in dB.
+static const FLT minSPL = -200;
+
+// publishes the "no signal" result, and forgets the locked frequency.
+static void lingot_core_publish_silence(LingotCore* core) {
+
+	int i;
+	const int spd_size = core->conf->fft_size / 2;
+
+	for (i = 0; i < spd_size; i++) {
+		core->SPL[i] = minSPL;
+	}
+
+	core->frequency_locker.locked = 0;
+	core->frequency_locker.current_frequency = 0.0;
+	core->frequency_locker.hits_counter = 0;
+	core->frequency_locker.rehits_counter = 0;
+	core->frequency_locker.rehits_up_counter = 0;
+	core->freq = 0.0;
+}
+
 void lingot_core_compute_fundamental_fequency(LingotCore* core) {
 
 	register unsigned int i, k; // loop variables.
@@ -579,22 +641,31 @@ void lingot_core_compute_fundamental_fequency(LingotCore* core) {
 	const FLT index2w = 2.0 * M_PI / conf->fft_size; // FFT resolution in rads.
 	const FLT f2w = 2 * M_PI * conf->oversampling / conf->sample_rate;
 	const FLT w2f = 1.0 / f2w;
+	LingotRingBuffer* ring = core->temporal_ring_buffer;
+	const FLT* samples;
+	unsigned long sequence;
+
+	// nothing to analyze on silence.
+	if (!__atomic_load_n(&core->gate_open, __ATOMIC_ACQUIRE)) {
+		lingot_core_publish_silence(core);
+		return;
+	}
+	__atomic_store_n(&core->analyses, core->analyses + 1, __ATOMIC_RELAXED);
 
 // ----------------- TRANSFORMATION TO FREQUENCY DOMAIN ----------------
 
-	pthread_mutex_lock(&core->temporal_buffer_mutex);
-
-// windowing
-	if (conf->window_type != NONE) {
-		for (i = 0; i < conf->fft_size; i++) {
-			core->windowed_fft_buffer[i] =
-					core->temporal_buffer[conf->temporal_buffer_size
-							- conf->fft_size + i] * core->hamming_window_fft[i];
+	// we take a windowed snapshot of the newest fft_size samples straight
+	// from the sample history, without any lock. If the audio thread has
+	// overwritten them meanwhile, we just take them again.
+	for (;;) {
+		samples = lingot_ring_buffer_peek(ring, conf->fft_size, &sequence);
+		lingot_core_window(samples, core->hamming_window_fft,
+				core->windowed_fft_buffer, conf->fft_size);
+		if (lingot_ring_buffer_validate(ring, conf->fft_size, sequence)) {
+			break;
 		}
-	} else {
-		memmove(core->windowed_fft_buffer,
-				&core->temporal_buffer[conf->temporal_buffer_size
-						- conf->fft_size], conf->fft_size * sizeof(FLT));
+		__atomic_store_n(&core->snapshot_retries, core->snapshot_retries + 1,
+				__ATOMIC_RELAXED);
 	}
 
 	int spd_size = (conf->fft_size / 2);
@@ -602,7 +673,6 @@ void lingot_core_compute_fundamental_fequency(LingotCore* core) {
 	// FFT
 	lingot_fft_compute_dft_and_spd(core->fftplan, core->spd_fft, spd_size);
 
-	static const FLT minSPL = -200;
 	for (i = 0; i < spd_size; i++) {
 		core->SPL[i] = 10.0 * log10(core->spd_fft[i]);
 		if (core->SPL[i] < minSPL) {
@@ -637,41 +707,26 @@ void lingot_core_compute_fundamental_fequency(LingotCore* core) {
 			conf->min_overall_SNR, conf->internal_min_frequency, core,
 			&divisor);
 
-	FLT w;
-	FLT w0 =
+	double w;
+	double w0 =
 			(f0 == 0.0) ?
 					0.0 :
 					2 * M_PI * f0 * conf->oversampling / conf->sample_rate;
 	w = w0;
 	Mi = floor(w / index2w);
 
-	if (w != 0.0) {
-		// windowing
-		if (conf->window_type != NONE) {
-			for (i = 0; i < conf->temporal_buffer_size; i++) {
-				core->windowed_temporal_buffer[i] = core->temporal_buffer[i]
-						* core->hamming_window_temporal[i];
-			}
-		} else {
-			memmove(core->windowed_temporal_buffer, core->temporal_buffer,
-					conf->temporal_buffer_size * sizeof(FLT));
-		}
-	}
-
-	pthread_mutex_unlock(&core->temporal_buffer_mutex); // we don't need the read buffer anymore
-
 	if (w != 0.0) {
 
 		//  Maximum finding by Newton-Raphson
 		// -----------------------------------
 
-		FLT wk = -1.0e5;
-		FLT wkm1 = w;
+		double wk = -1.0e5;
+		double wkm1 = w;
 		// first iterator set to the current approximation.
-		FLT d0_SPD = 0.0;
-		FLT d1_SPD = 0.0;
-		FLT d2_SPD = 0.0;
-		FLT d0_SPD_old = 0.0;
+		double d0_SPD = 0.0;
+		double d1_SPD = 0.0;
+		double d2_SPD = 0.0;
+		double d0_SPD_old = 0.0;
 
 //		printf("NR iter: %f ", w * w2f);
 
@@ -680,7 +735,7 @@ void lingot_core_compute_fundamental_fequency(LingotCore* core) {
 			wk = wkm1;
 
 			d0_SPD_old = d0_SPD;
-			lingot_fft_spd_diffs_eval(core->windowed_fft_buffer, // TODO: iterate over this buffer?
+			lingot_fft_spd_diffs_eval(core->windowed_fft_buffer, NULL, // TODO: iterate over this buffer?
 					conf->fft_size, wk, &d0_SPD, &d1_SPD, &d2_SPD);
 
 			wkm1 = wk - d1_SPD / d2_SPD;
@@ -697,33 +752,55 @@ void lingot_core_compute_fundamental_fequency(LingotCore* core) {
 
 		if (wkm1 > 0.0) {
 			w = wkm1; // frequency in rads.
-			wk = -1.0e5;
-			d0_SPD = 0.0;
-//			printf("NR2 iter: %f ", w * w2f);
-
-			for (k = 0;
-					(k <= 1)
-							|| ((k < conf->max_nr_iter)
-									&& (fabs(wk - wkm1) > 1.0e-4)); k++) {
-				wk = wkm1;
-
-				// ! we use the WHOLE temporal window for bigger precision.
-				d0_SPD_old = d0_SPD;
-				lingot_fft_spd_diffs_eval(core->windowed_temporal_buffer,
-						conf->temporal_buffer_size, wk, &d0_SPD, &d1_SPD,
-						&d2_SPD);
-
-				wkm1 = wk - d1_SPD / d2_SPD;
-//				printf(" -> (%f,%g,%g,%g)", wkm1 * w2f, d0_SPD, d1_SPD, d2_SPD);
-
-				if (d0_SPD < d0_SPD_old) {
-//					printf("!!!");
-					wkm1 = 0.0;
-					break;
+
+			// the whole temporal window is only needed for the refinement,
+			// which works straight on the sample history, windowing it on
+			// the fly. We take it ending at the same sample than the FFT
+			// one, and if the audio thread overwrites it meanwhile, we
+			// repeat the refinement on the newest samples.
+			samples = lingot_ring_buffer_peek_at(ring,
+					conf->temporal_buffer_size, sequence);
+
+			for (;;) {
+				wkm1 = w;
+				wk = -1.0e5;
+				d0_SPD = 0.0;
+//				printf("NR2 iter: %f ", w * w2f);
+
+				for (k = 0;
+						(k <= 1)
+								|| ((k < conf->max_nr_iter)
+										&& (fabs(wk - wkm1) > 1.0e-4)); k++) {
+					wk = wkm1;
+
+					// ! we use the WHOLE temporal window for bigger precision.
+					d0_SPD_old = d0_SPD;
+					lingot_fft_spd_diffs_eval(samples,
+							core->hamming_window_temporal,
+							conf->temporal_buffer_size, wk, &d0_SPD, &d1_SPD,
+							&d2_SPD);
+
+					wkm1 = wk - d1_SPD / d2_SPD;
+//					printf(" -> (%f,%g,%g,%g)", wkm1 * w2f, d0_SPD, d1_SPD, d2_SPD);
+
+					if (d0_SPD < d0_SPD_old) {
+//						printf("!!!");
+						wkm1 = 0.0;
+						break;
+					}
+
 				}
+//				printf("\n");
 
+				if (lingot_ring_buffer_validate(ring,
+						conf->temporal_buffer_size, sequence)) {
+					break;
+				}
+				__atomic_store_n(&core->snapshot_retries,
+						core->snapshot_retries + 1, __ATOMIC_RELAXED);
+				samples = lingot_ring_buffer_peek(ring,
+						conf->temporal_buffer_size, &sequence);
 			}
-//			printf("\n");
 
 			if (wkm1 > 0.0) {
 				w = wkm1; // frequency in rads.
@@ -731,36 +808,105 @@ void lingot_core_compute_fundamental_fequency(LingotCore* core) {
 		}
 	}
 
-	FLT freq =
+	double freq =
 			(w == 0.0) ?
 					0.0 :
 					w * conf->sample_rate
 							/ (divisor * 2.0 * M_PI * conf->oversampling); // analog frequency in Hz.
 //	core->freq = freq;
-	core->freq = lingot_core_frequency_locker(freq,
+	core->freq = lingot_core_frequency_locker(&core->frequency_locker, freq,
 			core->conf->internal_min_frequency);
 //	printf("-> %f\n", core->freq);
 }
 
+void lingot_core_get_stats(LingotCore* core, LingotCoreStats* stats) {
+	stats->snapshot_retries = __atomic_load_n(&core->snapshot_retries,
+			__ATOMIC_RELAXED);
+	stats->collisions = __atomic_load_n(
+			&core->temporal_ring_buffer->collisions, __ATOMIC_RELAXED);
+	stats->skipped_hops = __atomic_load_n(&core->skipped_hops,
+			__ATOMIC_RELAXED);
+	stats->analyses = __atomic_load_n(&core->analyses, __ATOMIC_RELAXED);
+	stats->blocks = __atomic_load_n(&core->blocks, __ATOMIC_RELAXED);
+	stats->copies = __atomic_load_n(&core->temporal_ring_buffer->copies,
+			__ATOMIC_RELAXED);
+	stats->copied_bytes = __atomic_load_n(
+			&core->temporal_ring_buffer->copied_bytes, __ATOMIC_RELAXED);
+
+	stats->overruns = 0;
+	stats->recovered_errors = 0;
+	stats->lost_frames = 0;
+	stats->late_periods = 0;
+	if (core->audio != NULL) {
+		stats->overruns = __atomic_load_n(&core->audio->overruns,
+				__ATOMIC_RELAXED);
+		stats->recovered_errors = __atomic_load_n(
+				&core->audio->recovered_errors, __ATOMIC_RELAXED);
+		stats->lost_frames = __atomic_load_n(&core->audio->lost_frames,
+				__ATOMIC_RELAXED);
+		stats->late_periods = __atomic_load_n(&core->audio->late_periods,
+				__ATOMIC_RELAXED);
+	}
+
+	stats->dropped_blocks =
+			(core->recorder != NULL) ?
+					lingot_recorder_get_dropped_blocks(core->recorder) : 0;
+}
+
+#ifdef LINGOT_PRINT_STATS
+static void lingot_core_print_stats(LingotCore* core) {
+	LingotCoreStats stats;
+
+	lingot_core_get_stats(core, &stats);
+	printf("core: %lu snapshot retries, %lu audio thread collisions\n",
+			stats.snapshot_retries, stats.collisions);
+	printf("core: %lu analyses, %lu skipped hops\n", stats.analyses,
+			stats.skipped_hops);
+	if (stats.blocks > 0) {
+		printf("core: %.2f copies and %.0f bytes moved per audio block\n",
+				(double) stats.copies / stats.blocks,
+				(double) stats.copied_bytes / stats.blocks);
+	}
+	if (core->audio != NULL) {
+		printf("audio: %lu overruns, %lu recovered errors, %lu frames lost, "
+				"%lu late periods\n", stats.overruns, stats.recovered_errors,
+				stats.lost_frames, stats.late_periods);
+	}
+	if (core->recorder != NULL) {
+		printf("recorder: %lu blocks dropped\n", stats.dropped_blocks);
+	}
+}
+#endif
+
 /* start running the core in another thread */
 void lingot_core_start(LingotCore* core) {
 
 	int audio_status = 0;
-	decimation_input_index = 0;
 
 	if (core->audio != NULL) {
+		uint64_t hops;
+
+		lingot_decimator_reset(core->decimator);
+		lingot_ring_buffer_reset(core->temporal_ring_buffer);
+		core->hop_pending = 0;
+		core->gate_hold = 0;
+		core->gate_open = 0;
+		core->thread_computation_done = 0;
+		if (read(core->hop_eventfd, &hops, sizeof(hops)) < 0) {
+			// nothing pending from a previous run.
+		}
 		audio_status = lingot_audio_start(core->audio);
 
 		if (audio_status == 0) {
 			pthread_mutex_init(&core->thread_computation_mutex, NULL);
 			pthread_cond_init(&core->thread_computation_cond, NULL);
 
+			core->running = 1;
 			pthread_attr_init(&core->thread_computation_attr);
 			pthread_create(&core->thread_computation,
 					&core->thread_computation_attr,
 					(void* (*)(void*)) lingot_core_run_computation_thread,
 					core);
-			core->running = 1;
 		} else {
 			core->running = 0;
 			lingot_audio_destroy(core->audio);
@@ -774,7 +920,8 @@ void lingot_core_start(LingotCore* core) {
 void lingot_core_stop(LingotCore* core) {
 	void* thread_result;
 
-	int result;
+	int result = 0;
+	uint64_t wake_up = 1;
 	struct timeval tout, tout_abs;
 	struct timespec tout_tspec;
 
@@ -789,10 +936,18 @@ void lingot_core_stop(LingotCore* core) {
 		tout_tspec.tv_sec = tout_abs.tv_sec;
 		tout_tspec.tv_nsec = 1000 * tout_abs.tv_usec;
 
+		// the computation thread may be waiting for a hop that will not
+		// come.
+		if (write(core->hop_eventfd, &wake_up, sizeof(wake_up)) < 0) {
+			perror("eventfd");
+		}
+
 		// watchdog timer
 		pthread_mutex_lock(&core->thread_computation_mutex);
-		result = pthread_cond_timedwait(&core->thread_computation_cond,
-				&core->thread_computation_mutex, &tout_tspec);
+		while (!core->thread_computation_done && (result != ETIMEDOUT)) {
+			result = pthread_cond_timedwait(&core->thread_computation_cond,
+					&core->thread_computation_mutex, &tout_tspec);
+		}
 		pthread_mutex_unlock(&core->thread_computation_mutex);
 
 		if (result == ETIMEDOUT) {
@@ -808,31 +963,57 @@ void lingot_core_stop(LingotCore* core) {
 		int spd_size = core->conf->fft_size / 2;
 		memset(core->SPL, 0, spd_size * sizeof(FLT));
 		core->freq = 0.0;
+
 	}
 
 	if (core->audio != NULL) {
 		lingot_audio_stop(core->audio);
 	}
+
+#	ifdef LINGOT_PRINT_STATS
+	lingot_core_print_stats(core);
+#	endif
+}
+
+int lingot_core_wait_hop(LingotCore* core, int timeout_ms) {
+	struct pollfd hop_poll;
+	uint64_t hops;
+	int result;
+
+	hop_poll.fd = core->hop_eventfd;
+	hop_poll.events = POLLIN;
+
+	result = poll(&hop_poll, 1, timeout_ms);
+	if (result < 0) {
+		return (errno == EINTR) ? 0 : -1;
+	}
+
+	if ((result == 0) || (read(core->hop_eventfd, &hops, sizeof(hops)) <= 0)) {
+		return 0;
+	}
+
+	// if we are late, we just analyze the newest samples once.
+	__atomic_store_n(&core->skipped_hops, core->skipped_hops + hops - 1,
+			__ATOMIC_RELAXED);
+	return (int) hops;
 }
 
 /* run the core */
 void lingot_core_run_computation_thread(LingotCore* core) {
-	struct timeval tout, tout_abs;
-	struct timespec tout_tspec;
-
-	gettimeofday(&tout_abs, NULL);
-	tout.tv_sec = 0;
-	tout.tv_usec = 1e6 / core->conf->calculation_rate;
+	int result;
 
 	while (core->running) {
-		lingot_core_compute_fundamental_fequency(core);
-		timeradd(&tout, &tout_abs, &tout_abs);
-		tout_tspec.tv_sec = tout_abs.tv_sec;
-		tout_tspec.tv_nsec = 1000 * tout_abs.tv_usec;
-		pthread_mutex_lock(&core->thread_computation_mutex);
-		pthread_cond_timedwait(&core->thread_computation_cond,
-				&core->thread_computation_mutex, &tout_tspec);
-		pthread_mutex_unlock(&core->thread_computation_mutex);
+
+		// we wait for the next hop, but not forever: if the audio source
+		// dies it will not signal anything, and we have to notice it.
+		result = lingot_core_wait_hop(core, 250);
+
+		if ((result > 0) && core->running) {
+			lingot_core_compute_fundamental_fequency(core);
+		} else if (result < 0) {
+			perror("poll");
+			core->running = 0;
+		}
 
 		if (core->audio != NULL) {
 			int spd_size = core->conf->fft_size / 2;
@@ -845,6 +1026,7 @@ void lingot_core_run_computation_thread(LingotCore* core) {
 	}
 
 	pthread_mutex_lock(&core->thread_computation_mutex);
+	core->thread_computation_done = 1;
 	pthread_cond_broadcast(&core->thread_computation_cond);
 	pthread_mutex_unlock(&core->thread_computation_mutex);
 }
@@ -30,7 +30,10 @@
 #include "lingot-defs.h"
 #include "lingot-complex.h"
 #include "lingot-filter.h"
+#include "lingot-decimator.h"
 #include "lingot-config.h"
+#include "lingot-ring-buffer.h"
+#include "lingot-recorder.h"
 
 #include "lingot-audio.h"
 
@@ -38,24 +41,38 @@
 
 typedef struct _LingotCore LingotCore;
 
+// state of the frequency locker, which filters out the octave and harmonic
+// jumps of the estimation.
+typedef struct _LingotFrequencyLocker LingotFrequencyLocker;
+
+struct _LingotFrequencyLocker {
+	int locked;
+	double current_frequency;
+	int hits_counter;
+	int rehits_counter;
+	int rehits_up_counter;
+	FLT old_multiplier;
+	FLT old_multiplier2;
+};
+
 struct _LingotCore {
 
 	//  -- shared data --
-	FLT freq; // computed analog frequency.
+	double freq; // computed analog frequency.
 	FLT* SPL; // visual portion of FFT.
 	//  -- shared data --
 
 	LingotAudioHandler* audio; // audio handler.
+	LingotRecorder* recorder; // of the captured audio, if requested.
 
 	FLT* flt_read_buffer;
-	FLT* temporal_buffer; // sample memory.
+	LingotRingBuffer* temporal_ring_buffer; // sample memory.
 
 	// precomputed hamming windows
 	FLT* hamming_window_temporal;
 	FLT* hamming_window_fft;
 
-	// windowed signals
-	FLT* windowed_temporal_buffer;
+	// windowed signal
 	FLT* windowed_fft_buffer;
 
 	// spectral power distribution esteem.
@@ -64,7 +81,9 @@ struct _LingotCore {
 
 	LingotFFTPlan* fftplan;
 
-	LingotFilter* antialiasing_filter; // antialiasing filter for decimation.
+	LingotDecimator* decimator; // antialiasing filter and decimation.
+
+	LingotFrequencyLocker frequency_locker;
 
 	int running;
 
@@ -74,8 +93,37 @@ struct _LingotCore {
 	pthread_attr_t thread_computation_attr;
 	pthread_cond_t thread_computation_cond;
 	pthread_mutex_t thread_computation_mutex;
-
-	pthread_mutex_t temporal_buffer_mutex;
+	int thread_computation_done;
+
+	// the analysis is driven by the audio: every hop_size new decimated
+	// samples the audio thread signals hop_eventfd, and the computation
+	// thread runs once. Hops arriving while it is still busy are not
+	// queued, they are counted in skipped_hops.
+	int hop_eventfd;
+	unsigned int hop_size;
+	unsigned int hop_pending;
+	unsigned long skipped_hops;
+
+	// spectral analyses run, the ones skipped on silence don't count
+	// (computation thread).
+	unsigned long analyses;
+
+	// energy gate. The audio thread keeps it open while the sample memory
+	// holds any block louder than conf->noise_gate, and the analysis is
+	// skipped while it is closed.
+	FLT gate_threshold; // mean square power of the gate level.
+	unsigned int gate_hold; // samples until the gate closes.
+	int gate_open;
+
+	// snapshots of the sample memory discarded because the audio thread
+	// overwrote them while they were being taken. The audio thread never
+	// waits for the computation thread, its writes over the oldest sample of
+	// a snapshot being taken are counted in temporal_ring_buffer->collisions.
+	unsigned long snapshot_retries;
+
+	// audio blocks received, to account the copies made by the sample
+	// memory per block (temporal_ring_buffer->copies).
+	unsigned long blocks;
 
 #	ifdef DRAW_MARKERS
 	int markers[20];
@@ -85,11 +133,52 @@ struct _LingotCore {
 #	endif
 };
 
+// counters of the core, for diagnostics. They are printed on stop when
+// built with LINGOT_PRINT_STATS.
+typedef struct _LingotCoreStats LingotCoreStats;
+
+struct _LingotCoreStats {
+	unsigned long snapshot_retries; // see LingotCore
+	unsigned long collisions; // see LingotRingBuffer
+	unsigned long skipped_hops;
+	unsigned long analyses;
+	unsigned long blocks;
+	unsigned long copies; // see LingotRingBuffer
+	unsigned long copied_bytes;
+	unsigned long overruns; // see LingotAudioHandler
+	unsigned long recovered_errors;
+	unsigned long lost_frames;
+	unsigned long late_periods;
+	unsigned long dropped_blocks; // see LingotRecorder
+};
+
 //----------------------------------------------------------------
 
 LingotCore* lingot_core_new(LingotConfig*);
+
+// creates a core without audio source, which is fed by the caller through
+// lingot_core_read_callback() with blocks of up to read_buffer_size samples,
+// and computed with lingot_core_compute_fundamental_fequency().
+LingotCore* lingot_core_new_stream(LingotConfig*, int read_buffer_size);
+
 void lingot_core_destroy(LingotCore*);
 
+// appends a block of samples to the sample memory.
+int lingot_core_read_callback(FLT* read_buffer, int samples_read, void *arg);
+
+// waits up to timeout_ms for the audio to signal new hops, as the
+// computation thread does, and returns how many, 0 if none, or -1 on error.
+// Only one analysis is due however many hops came, the rest are counted as
+// skipped.
+int lingot_core_wait_hop(LingotCore*, int timeout_ms);
+
+// estimates the fundamental frequency from the newest samples.
+void lingot_core_compute_fundamental_fequency(LingotCore*);
+
+// gets the counters of the core. It can be called from any thread, also
+// while the core runs.
+void lingot_core_get_stats(LingotCore*, LingotCoreStats*);
+
 // start process
 void lingot_core_start(LingotCore*);
 
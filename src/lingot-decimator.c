@@ -0,0 +1,327 @@
+/*
+ * lingot, a musical instrument tuner.
+ *
+ * Copyright (C) 2004-2013  Ibán Cereijo Graña.
+ * Copyright (C) 2004-2008  Jairo Chapela Martínez.
+
+ *
+ * This file is part of lingot.
+ *
+ * lingot is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * lingot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with lingot; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "lingot-decimator.h"
+
+// stop band attenuation of the FIR filter, in dB.
+#define FIR_ATTENUATION		60.0
+
+// zeroth order modified Bessel function of the first kind, for the Kaiser
+// window.
+static FLT lingot_decimator_bessel_i0(FLT x) {
+	FLT sum = 1.0;
+	FLT term = 1.0;
+	int k;
+
+	for (k = 1; k < 50; k++) {
+		term *= (0.5 * x / k) * (0.5 * x / k);
+		sum += term;
+		if (term < 1e-12 * sum) {
+			break;
+		}
+	}
+
+	return sum;
+}
+
+// Kaiser windowed sinc low pass filter, with cutoff pi*wc radians (-6dB) and
+// unitary gain at DC.
+static void lingot_decimator_fir_design(unsigned int taps, FLT wc, FLT* h) {
+	const FLT beta = 0.1102 * (FIR_ATTENUATION - 8.7);
+	const FLT center = 0.5 * (taps - 1);
+	const FLT i0_beta = lingot_decimator_bessel_i0(beta);
+	FLT sum = 0.0;
+	FLT t, r;
+	unsigned int i;
+
+	for (i = 0; i < taps; i++) {
+		t = i - center;
+		r = t / center;
+		h[i] = (t == 0.0) ? wc : sin(M_PI * wc * t) / (M_PI * t);
+		h[i] *= lingot_decimator_bessel_i0(beta * sqrt(1.0 - r * r)) / i0_beta;
+		sum += h[i];
+	}
+
+	for (i = 0; i < taps; i++) {
+		h[i] /= sum;
+	}
+}
+
+// prepares the FIR filter of a decimation stage, with the transition band
+// centered at the new Nyquist frequency, pi/factor, keeping the band below
+// pi*passband free of aliasing.
+static void lingot_decimator_fir_init(LingotDecimator* decimator,
+		FLT passband) {
+	FLT transition_width = 2.0 * M_PI * (1.0 / decimator->factor - passband);
+	decimator->taps = (unsigned int) ceil(
+			(FIR_ATTENUATION - 7.95) / (2.285 * transition_width)) + 1;
+	decimator->taps |= 1; // odd length, integer group delay.
+	decimator->h = malloc(decimator->taps * sizeof(FLT));
+	decimator->delay_line = malloc(2 * decimator->taps * sizeof(FLT));
+	lingot_decimator_fir_design(decimator->taps, 1.0 / decimator->factor,
+			decimator->h);
+}
+
+static unsigned int lingot_decimator_largest_prime_factor(unsigned int n) {
+	unsigned int d;
+	for (d = 2; d * d <= n; d++) {
+		while ((n % d == 0) && (n > d)) {
+			n /= d;
+		}
+	}
+	return n;
+}
+
+// builds the cascade of stages for decimating by 'factor', keeping the band
+// below pi*passband (normalised to the input rate of the first stage).
+static LingotDecimator* lingot_decimator_new_stage(unsigned int factor,
+		FLT passband) {
+
+	LingotDecimator* stage = malloc(sizeof(LingotDecimator));
+
+	stage->type = DECIMATION_FILTER_MULTISTAGE;
+	stage->filter = NULL;
+	stage->factor = lingot_decimator_largest_prime_factor(factor);
+	lingot_decimator_fir_init(stage, passband);
+	stage->next = NULL;
+	if (stage->factor < factor) {
+		stage->next = lingot_decimator_new_stage(factor / stage->factor,
+				passband * stage->factor);
+	}
+
+	return stage;
+}
+
+LingotDecimator* lingot_decimator_new(decimation_filter_t type,
+		unsigned int factor) {
+
+	LingotDecimator* decimator = NULL;
+
+	if ((factor > 1) && (type == DECIMATION_FILTER_MULTISTAGE)) {
+		/*
+		 * The factor is split in its prime factors, in decreasing order, with
+		 * a FIR decimator for each one. Only the last stage needs a narrow
+		 * transition band (the same as the single stage FIR), but it runs at
+		 * the lowest rate and with the smallest factor. The first stages only
+		 * have to keep the final band of interest free of aliasing, so their
+		 * transition bands are wide and their filters short.
+		 *
+		 * e.g. for 88 = 11x2x2x2 we need 2.9 products per input sample,
+		 * instead of 9 with a single FIR stage.
+		 */
+		decimator = lingot_decimator_new_stage(factor, 0.8 / factor);
+		lingot_decimator_reset(decimator);
+		return decimator;
+	}
+
+	decimator = malloc(sizeof(LingotDecimator));
+
+	decimator->type = type;
+	decimator->factor = factor;
+	decimator->filter = NULL;
+	decimator->h = NULL;
+	decimator->delay_line = NULL;
+	decimator->taps = 0;
+	decimator->next = NULL;
+
+	if (factor > 1) {
+		switch (type) {
+		case DECIMATION_FILTER_FIR:
+			/*
+			 * Linear phase FIR, with the transition band centered at the new
+			 * Nyquist frequency, pi/factor, and 0.4*pi/factor wide. The
+			 * frequencies that alias in the upper part of the transition band
+			 * fall in the upper part of the analysed band too, where there
+			 * are only high order harmonics.
+			 *
+			 * Since only one output every 'factor' input samples is kept, we
+			 * only evaluate those outputs, so the cost per input sample is
+			 * taps/factor products, regardless of the decimation factor.
+			 */
+			lingot_decimator_fir_init(decimator, 0.8 / factor);
+			break;
+		case DECIMATION_FILTER_IIR:
+		default:
+			/*
+			 * 8 order Chebyshev filters, with wc=0.9/i (normalised respect to
+			 * Pi). We take 0.9 instead of 1 to leave a 10% of safety margin,
+			 * in order to avoid aliased frequencies near to w=Pi, due to non
+			 * ideality of the filter.
+			 *
+			 * The cut frequencies wc=Pi/i, with i=1..20, correspond with the
+			 * oversampling factor, avoiding aliasing at decimation.
+			 *
+			 * Why Chebyshev filters?, for a given order, those filters yield
+			 * abrupt falls than other ones as Butterworth, making the most of
+			 * the order. Although Chebyshev filters affect more to the phase,
+			 * it doesn't matter due to the analysis is made on the signal
+			 * power distribution (only magnitude).
+			 */
+			decimator->type = DECIMATION_FILTER_IIR;
+			decimator->filter = lingot_filter_cheby_design(8, 0.5,
+					0.9 / factor);
+			break;
+		}
+	}
+
+	lingot_decimator_reset(decimator);
+
+	return decimator;
+}
+
+void lingot_decimator_destroy(LingotDecimator* decimator) {
+	if (decimator->next != NULL) {
+		lingot_decimator_destroy(decimator->next);
+	}
+	if (decimator->filter != NULL) {
+		lingot_filter_destroy(decimator->filter);
+	}
+	if (decimator->h != NULL) {
+		free(decimator->h);
+		free(decimator->delay_line);
+	}
+	free(decimator);
+}
+
+void lingot_decimator_reset(LingotDecimator* decimator) {
+	decimator->input_index = 0;
+	decimator->delay_line_index = 0;
+
+	if (decimator->filter != NULL) {
+		lingot_filter_reset(decimator->filter);
+	}
+	if (decimator->delay_line != NULL) {
+		memset(decimator->delay_line, 0, 2 * decimator->taps * sizeof(FLT));
+	}
+	if (decimator->next != NULL) {
+		lingot_decimator_reset(decimator->next);
+	}
+}
+
+// polyphase FIR decimation, only the kept output samples are computed.
+static unsigned int lingot_decimator_decimate_fir(LingotDecimator* decimator,
+		const FLT* in, unsigned int n, FLT* out) {
+
+	register unsigned int i, k;
+	unsigned int output_index = 0;
+	const unsigned int taps = decimator->taps;
+	const unsigned int half = taps >> 1;
+	const FLT* h = decimator->h;
+	FLT* delay_line = decimator->delay_line;
+	unsigned int p = decimator->delay_line_index;
+	const FLT* x;
+	FLT y0, y1, y2, y3;
+
+	for (i = 0; i < n; i++) {
+
+		// the newest sample goes at p, the older ones follow it. The delay
+		// line is mirrored so they are always contiguous.
+		p = (p == 0) ? taps - 1 : p - 1;
+		delay_line[p] = in[i];
+		delay_line[p + taps] = in[i];
+
+		if (i == decimator->input_index) {
+			// the impulse response is symmetric, so we fold the delay line
+			// and save half of the products.
+			// Four independent partial sums avoid stalling on the latency
+			// of each addition.
+			x = &delay_line[p];
+			y0 = h[half] * x[half];
+			y1 = y2 = y3 = 0.0;
+			for (k = 0; k + 3 < half; k += 4) {
+				y0 += h[k] * (x[k] + x[taps - 1 - k]);
+				y1 += h[k + 1] * (x[k + 1] + x[taps - 2 - k]);
+				y2 += h[k + 2] * (x[k + 2] + x[taps - 3 - k]);
+				y3 += h[k + 3] * (x[k + 3] + x[taps - 4 - k]);
+			}
+			for (; k < half; k++) {
+				y0 += h[k] * (x[k] + x[taps - 1 - k]);
+			}
+			out[output_index++] = (y0 + y1) + (y2 + y3);
+			decimator->input_index += decimator->factor;
+		}
+	}
+
+	decimator->input_index -= n;
+	decimator->delay_line_index = p;
+
+	return output_index;
+}
+
+// IIR filtering of the whole block followed by compression.
+static unsigned int lingot_decimator_decimate_iir(LingotDecimator* decimator,
+		const FLT* in, unsigned int n, FLT* out) {
+
+	unsigned int output_index;
+
+	// low pass filter to avoid aliasing.
+	lingot_filter_filter(decimator->filter, n, in, out);
+
+	// compression.
+	for (output_index = 0; decimator->input_index < n; output_index++, //
+			decimator->input_index += decimator->factor) {
+		out[output_index] = out[decimator->input_index];
+	}
+	decimator->input_index -= n;
+
+	return output_index;
+}
+
+unsigned int lingot_decimator_decimate(LingotDecimator* decimator,
+		const FLT* in, unsigned int n, FLT* out) {
+
+	if (decimator->factor <= 1) {
+		if (out != in) {
+			memmove(out, in, n * sizeof(FLT));
+		}
+		return n;
+	}
+
+	if (decimator->type == DECIMATION_FILTER_IIR) {
+		return lingot_decimator_decimate_iir(decimator, in, n, out);
+	}
+
+	n = lingot_decimator_decimate_fir(decimator, in, n, out);
+	if (decimator->next != NULL) {
+		// the following stages work in place.
+		n = lingot_decimator_decimate(decimator->next, out, n, out);
+	}
+
+	return n;
+}
+
+unsigned int lingot_decimator_output_room(const LingotDecimator* decimator,
+		unsigned int n) {
+
+	if ((decimator->factor <= 1) || (decimator->type == DECIMATION_FILTER_IIR)) {
+		return n;
+	}
+
+	// the following stages work in place, on the output of the first one.
+	return n / decimator->factor + 1;
+}
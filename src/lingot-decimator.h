@@ -0,0 +1,78 @@
+/*
+ * lingot, a musical instrument tuner.
+ *
+ * Copyright (C) 2004-2013  Ibán Cereijo Graña.
+ * Copyright (C) 2004-2008  Jairo Chapela Martínez.
+
+ *
+ * This file is part of lingot.
+ *
+ * lingot is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * lingot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with lingot; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef __LINGOT_DECIMATOR_H__
+#define __LINGOT_DECIMATOR_H__
+
+#include "lingot-defs.h"
+#include "lingot-config.h"
+#include "lingot-filter.h"
+
+/*
+ Low pass filtering and downsampling of the input signal.
+ */
+
+typedef struct _LingotDecimator LingotDecimator;
+
+struct _LingotDecimator {
+
+	decimation_filter_t type;
+	unsigned int factor; // decimation factor of this stage.
+
+	// index of the next input sample to be kept, relative to the beginning
+	// of the next block (phase of the decimator).
+	unsigned int input_index;
+
+	// IIR filter, applied on every input sample.
+	LingotFilter* filter;
+
+	// FIR filter, only evaluated on the kept samples.
+	FLT* h; // impulse response.
+	unsigned int taps;
+	FLT* delay_line; // mirrored, 2 * taps samples.
+	unsigned int delay_line_index;
+
+	// next stage in a multistage cascade, NULL in the last one.
+	LingotDecimator* next;
+};
+
+LingotDecimator* lingot_decimator_new(decimation_filter_t type,
+		unsigned int factor);
+void lingot_decimator_destroy(LingotDecimator*);
+
+// clears the filter status and the phase.
+void lingot_decimator_reset(LingotDecimator*);
+
+// filters and decimates n input samples, returning the number of output
+// samples. The output buffer must have room for n samples, and it can be
+// the input buffer itself.
+unsigned int lingot_decimator_decimate(LingotDecimator*, const FLT* in,
+		unsigned int n, FLT* out);
+
+// room needed in the output buffer to decimate n input samples. Only the
+// IIR filter needs room for the whole input block.
+unsigned int lingot_decimator_output_room(const LingotDecimator*,
+		unsigned int n);
+
+#endif /*__LINGOT_DECIMATOR_H__*/
@@ -27,8 +27,13 @@
 
 #include "../config.h"
 
-// floating point precission.
+// floating point precission of the signal processing. The frequency
+// estimation is always refined in double precission.
+#ifdef LINGOT_FLOAT
+#define FLT                  float
+#else
 #define FLT                  double
+#endif
 
 #define CONFIG_DIR_NAME           ".lingot/"
 #define DEFAULT_CONFIG_FILE_NAME  "lingot.conf"
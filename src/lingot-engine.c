@@ -0,0 +1,318 @@
+/*
+ * lingot, a musical instrument tuner.
+ *
+ * Copyright (C) 2004-2013  Ibán Cereijo Graña.
+ * Copyright (C) 2004-2008  Jairo Chapela Martínez.
+
+ *
+ * This file is part of lingot.
+ *
+ * lingot is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * lingot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with lingot; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+#include "lingot-engine.h"
+
+// takes the next stream of the given worker, returning n_streams if there is
+// none left.
+static unsigned int lingot_engine_worker_take(LingotEngineWorker* worker,
+		unsigned int n_streams) {
+	unsigned int stream;
+
+	// other workers may be taking from it too.
+	if (__atomic_load_n(&worker->next, __ATOMIC_RELAXED) >= worker->end) {
+		return n_streams;
+	}
+	stream = __sync_fetch_and_add(&worker->next, 1);
+	return (stream < worker->end) ? stream : n_streams;
+}
+
+// computes the streams of the worker, and then those still pending in the
+// others.
+static void lingot_engine_worker_run_round(LingotEngineWorker* worker) {
+	LingotEngine* engine = worker->engine;
+	const unsigned int id = worker - engine->workers;
+	unsigned int i, stream;
+	LingotEngineWorker* victim;
+
+	while ((stream = lingot_engine_worker_take(worker, engine->n_streams))
+			< engine->n_streams) {
+		lingot_core_compute_fundamental_fequency(engine->streams[stream]);
+	}
+
+	for (i = 1; i < engine->n_workers; i++) {
+		victim = &engine->workers[(id + i) % engine->n_workers];
+		while ((stream = lingot_engine_worker_take(victim, engine->n_streams))
+				< engine->n_streams) {
+			lingot_core_compute_fundamental_fequency(engine->streams[stream]);
+			worker->steals++;
+		}
+	}
+}
+
+static void* lingot_engine_worker_thread(void* arg) {
+	LingotEngineWorker* worker = (LingotEngineWorker*) arg;
+	LingotEngine* engine = worker->engine;
+	unsigned long round = 0;
+
+	for (;;) {
+		pthread_mutex_lock(&engine->mutex);
+		while (!engine->quit && (engine->round == round)) {
+			pthread_cond_wait(&engine->round_cond, &engine->mutex);
+		}
+		if (engine->quit) {
+			pthread_mutex_unlock(&engine->mutex);
+			break;
+		}
+		round = engine->round;
+		pthread_mutex_unlock(&engine->mutex);
+
+		lingot_engine_worker_run_round(worker);
+
+		pthread_mutex_lock(&engine->mutex);
+		if (--engine->pending_workers == 0) {
+			pthread_cond_signal(&engine->done_cond);
+		}
+		pthread_mutex_unlock(&engine->mutex);
+	}
+
+	return NULL;
+}
+
+LingotEngine* lingot_engine_new(LingotConfig* conf, unsigned int n_streams,
+		unsigned int max_frames, unsigned int n_workers) {
+
+	LingotEngine* engine = malloc(sizeof(LingotEngine));
+	unsigned int i;
+
+	if (n_workers == 0) {
+		long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+		n_workers = (cpus > 0) ? cpus : 1;
+	}
+	if (n_workers > n_streams) {
+		n_workers = n_streams;
+	}
+
+	engine->conf = conf;
+	engine->audio = NULL;
+	engine->n_streams = n_streams;
+	engine->max_frames = max_frames;
+	engine->streams = malloc(n_streams * sizeof(LingotCore*));
+	engine->freq = malloc(n_streams * sizeof(double));
+	for (i = 0; i < n_streams; i++) {
+		engine->streams[i] = lingot_core_new_stream(conf, max_frames);
+		engine->freq[i] = 0.0;
+	}
+	engine->rounds = 0;
+
+	pthread_mutex_init(&engine->mutex, NULL);
+	pthread_cond_init(&engine->round_cond, NULL);
+	pthread_cond_init(&engine->done_cond, NULL);
+	pthread_cond_init(&engine->scheduler_cond, NULL);
+	engine->round = 0;
+	engine->pending_workers = 0;
+	engine->quit = 0;
+	engine->running = 0;
+
+	engine->n_workers = n_workers;
+	engine->workers = malloc(n_workers * sizeof(LingotEngineWorker));
+	for (i = 0; i < n_workers; i++) {
+		engine->workers[i].engine = engine;
+		engine->workers[i].next = 0;
+		engine->workers[i].end = 0;
+		engine->workers[i].steals = 0;
+	}
+	for (i = 0; i < n_workers; i++) {
+		pthread_create(&engine->workers[i].thread, NULL,
+				lingot_engine_worker_thread, &engine->workers[i]);
+	}
+
+	return engine;
+}
+
+LingotEngine* lingot_engine_new_capture(LingotConfig* conf,
+		unsigned int n_streams, unsigned int n_workers) {
+
+	LingotEngine* engine = NULL;
+	LingotAudioHandler* audio = lingot_audio_new_multichannel(
+			conf->audio_system, conf->audio_dev[conf->audio_system],
+			conf->sample_rate, n_streams,
+			(LingotAudioProcessCallback) lingot_core_read_callback, NULL);
+
+	if (audio != NULL) {
+		if (conf->sample_rate != audio->real_sample_rate) {
+			conf->sample_rate = audio->real_sample_rate;
+			lingot_config_update_internal_params(conf);
+		}
+
+		engine = lingot_engine_new(conf, n_streams,
+				audio->read_buffer_size_samples, n_workers);
+
+		// each channel goes straight to the core of its stream.
+		engine->audio = audio;
+		audio->process_callback_args = (void**) engine->streams;
+	}
+
+	return engine;
+}
+
+void lingot_engine_destroy(LingotEngine* engine) {
+	unsigned int i;
+
+	lingot_engine_stop(engine);
+	if (engine->audio != NULL) {
+		lingot_audio_destroy(engine->audio);
+	}
+
+	pthread_mutex_lock(&engine->mutex);
+	engine->quit = 1;
+	pthread_cond_broadcast(&engine->round_cond);
+	pthread_mutex_unlock(&engine->mutex);
+
+	for (i = 0; i < engine->n_workers; i++) {
+		pthread_join(engine->workers[i].thread, NULL);
+	}
+
+	pthread_cond_destroy(&engine->scheduler_cond);
+	pthread_cond_destroy(&engine->done_cond);
+	pthread_cond_destroy(&engine->round_cond);
+	pthread_mutex_destroy(&engine->mutex);
+
+	for (i = 0; i < engine->n_streams; i++) {
+		lingot_core_destroy(engine->streams[i]);
+	}
+
+	free(engine->workers);
+	free(engine->freq);
+	free(engine->streams);
+	free(engine);
+}
+
+void lingot_engine_write(LingotEngine* engine, const FLT* interleaved,
+		unsigned int n_frames) {
+	const unsigned int n_streams = engine->n_streams;
+	unsigned int i, j, k, n;
+
+	for (k = 0; k < n_frames; k += n) {
+		n = n_frames - k;
+		if (n > engine->max_frames) {
+			n = engine->max_frames;
+		}
+
+		for (i = 0; i < n_streams; i++) {
+			const FLT* in = &interleaved[k * n_streams + i];
+			FLT* out = engine->streams[i]->flt_read_buffer;
+			for (j = 0; j < n; j++) {
+				out[j] = in[j * n_streams];
+			}
+			lingot_core_read_callback(out, n, engine->streams[i]);
+		}
+	}
+}
+
+void lingot_engine_compute(LingotEngine* engine) {
+	const unsigned int n_workers = engine->n_workers;
+	unsigned int i;
+
+	// contiguous blocks of streams, the workers that finish first will help
+	// with the rest.
+	for (i = 0; i < n_workers; i++) {
+		engine->workers[i].next = i * engine->n_streams / n_workers;
+		engine->workers[i].end = (i + 1) * engine->n_streams / n_workers;
+	}
+
+	pthread_mutex_lock(&engine->mutex);
+	engine->pending_workers = n_workers;
+	engine->round++;
+	pthread_cond_broadcast(&engine->round_cond);
+	while (engine->pending_workers > 0) {
+		pthread_cond_wait(&engine->done_cond, &engine->mutex);
+	}
+
+	// read without the lock by lingot_engine_get_frequency().
+	for (i = 0; i < engine->n_streams; i++) {
+		__atomic_store(&engine->freq[i], &engine->streams[i]->freq,
+				__ATOMIC_RELAXED);
+	}
+	engine->rounds++;
+	pthread_mutex_unlock(&engine->mutex);
+}
+
+static void* lingot_engine_scheduler_thread(void* arg) {
+	LingotEngine* engine = (LingotEngine*) arg;
+	struct timeval tout, tout_abs;
+	struct timespec tout_tspec;
+
+	gettimeofday(&tout_abs, NULL);
+	tout.tv_sec = 0;
+	tout.tv_usec = 1e6 / engine->conf->calculation_rate;
+
+	// running is only read under the mutex, which lingot_engine_stop()
+	// holds to clear it. The mutex is released during the computation,
+	// which takes it too.
+	pthread_mutex_lock(&engine->mutex);
+	while (engine->running) {
+		pthread_mutex_unlock(&engine->mutex);
+		lingot_engine_compute(engine);
+		timeradd(&tout, &tout_abs, &tout_abs);
+		tout_tspec.tv_sec = tout_abs.tv_sec;
+		tout_tspec.tv_nsec = 1000 * tout_abs.tv_usec;
+		pthread_mutex_lock(&engine->mutex);
+		if (engine->running) {
+			pthread_cond_timedwait(&engine->scheduler_cond, &engine->mutex,
+					&tout_tspec);
+		}
+	}
+	pthread_mutex_unlock(&engine->mutex);
+
+	return NULL;
+}
+
+void lingot_engine_start(LingotEngine* engine) {
+	if (!engine->running) {
+		if ((engine->audio != NULL) && lingot_audio_start(engine->audio)) {
+			return;
+		}
+		engine->running = 1;
+		pthread_create(&engine->thread_scheduler, NULL,
+				lingot_engine_scheduler_thread, engine);
+	}
+}
+
+void lingot_engine_stop(LingotEngine* engine) {
+	if (engine->running) {
+		pthread_mutex_lock(&engine->mutex);
+		engine->running = 0;
+		pthread_cond_signal(&engine->scheduler_cond);
+		pthread_mutex_unlock(&engine->mutex);
+		pthread_join(engine->thread_scheduler, NULL);
+
+		if (engine->audio != NULL) {
+			lingot_audio_stop(engine->audio);
+		}
+	}
+}
+
+double lingot_engine_get_frequency(const LingotEngine* engine,
+		unsigned int stream) {
+	double freq;
+	__atomic_load(&engine->freq[stream], &freq, __ATOMIC_RELAXED);
+	return freq;
+}
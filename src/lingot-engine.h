@@ -0,0 +1,127 @@
+/*
+ * lingot, a musical instrument tuner.
+ *
+ * Copyright (C) 2004-2013  Ibán Cereijo Graña.
+ * Copyright (C) 2004-2008  Jairo Chapela Martínez.
+
+ *
+ * This file is part of lingot.
+ *
+ * lingot is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * lingot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with lingot; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef __LINGOT_ENGINE_H__
+#define __LINGOT_ENGINE_H__
+
+/*
+ Analysis of many input streams (the channels of a multi-channel capture) in
+ one process. Each stream has its own core, and the computation of all of
+ them is spread over a fixed pool of worker threads.
+ */
+
+#include <pthread.h>
+
+#include "lingot-defs.h"
+#include "lingot-config.h"
+#include "lingot-core.h"
+#include "lingot-audio.h"
+
+typedef struct _LingotEngine LingotEngine;
+typedef struct _LingotEngineWorker LingotEngineWorker;
+
+struct _LingotEngineWorker {
+
+	LingotEngine* engine;
+	pthread_t thread;
+
+	// streams assigned to this worker in the current round, [next, end). The
+	// workers that run out of streams steal them from the others by
+	// advancing their next index.
+	unsigned int next;
+	unsigned int end;
+
+	// streams computed by this worker that were assigned to others.
+	unsigned long steals;
+};
+
+struct _LingotEngine {
+
+	LingotConfig* conf; // shared by all the streams.
+
+	// multi-channel capture feeding the streams, NULL if they are fed
+	// through lingot_engine_write().
+	LingotAudioHandler* audio;
+
+	unsigned int n_streams;
+	LingotCore** streams;
+
+	// frames deinterleaved at once, straight into the input buffer of each
+	// stream.
+	unsigned int max_frames;
+
+	// frequencies estimated in the last round, one per stream. Published
+	// with atomics, as they are read without the lock.
+	double* freq;
+	unsigned long rounds;
+
+	unsigned int n_workers;
+	LingotEngineWorker* workers;
+
+	// round dispatching.
+	pthread_mutex_t mutex;
+	pthread_cond_t round_cond; // a new round has started, or quit.
+	pthread_cond_t done_cond; // all the workers finished the round.
+	unsigned long round;
+	unsigned int pending_workers;
+	int quit;
+
+	// periodic computation.
+	pthread_t thread_scheduler;
+	pthread_cond_t scheduler_cond;
+	int running;
+};
+
+// creates an engine for n_streams streams, fed with blocks of up to
+// max_frames frames. The number of workers defaults to the number of CPUs if
+// n_workers is 0.
+LingotEngine* lingot_engine_new(LingotConfig* conf, unsigned int n_streams,
+		unsigned int max_frames, unsigned int n_workers);
+
+// creates an engine fed by a multi-channel capture from the configured audio
+// system, one stream per channel. Returns NULL if the capture can't be
+// opened.
+LingotEngine* lingot_engine_new_capture(LingotConfig* conf,
+		unsigned int n_streams, unsigned int n_workers);
+
+void lingot_engine_destroy(LingotEngine*);
+
+// appends n_frames frames of interleaved samples, one per stream, to the
+// streams sample memory. Typically called from the audio thread.
+void lingot_engine_write(LingotEngine*, const FLT* interleaved,
+		unsigned int n_frames);
+
+// computes the frequency of every stream on the worker pool, and publishes
+// the results once all of them are done.
+void lingot_engine_compute(LingotEngine*);
+
+// computes periodically, at the configured calculation rate, and starts the
+// capture if any.
+void lingot_engine_start(LingotEngine*);
+void lingot_engine_stop(LingotEngine*);
+
+// frequency of the given stream, as estimated in the last round.
+double lingot_engine_get_frequency(const LingotEngine*, unsigned int stream);
+
+#endif //__LINGOT_ENGINE_H__
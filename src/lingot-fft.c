@@ -23,16 +23,231 @@
  */
 
 #include <math.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "lingot-fft.h"
 #include "lingot-config.h"
 
-#ifndef LIBFFTW
+#ifdef LIBFFTW
+#include <limits.h>
+#include <pthread.h>
+#else
 #include "lingot-complex.h"
 #endif
 
+// pair of samples, or a complex value, packed in a SIMD register, and an
+// integer vector of the same geometry for shuffling them.
+typedef FLT lingot_fft_v2 __attribute__ ((vector_size (2 * sizeof(FLT))));
+typedef __typeof__(__builtin_choose_expr(sizeof(FLT) == sizeof(long long),
+		0LL, 0)) lingot_fft_int;
+typedef lingot_fft_int lingot_fft_m2 __attribute__ ((vector_size (2 * sizeof(FLT))));
+
+// same, in double precission, for the frequency refinement.
+typedef double lingot_fft_v2d __attribute__ ((vector_size (2 * sizeof(double))));
+
+#ifdef LIBFFTW
+
+/*
+ FFTW plan cache and wisdom.
+
+ Plans are shared among all the FFT plans of the same size, so restarting the
+ core doesn't make FFTW plan again. The first plan of each size is estimated,
+ and a measured one is computed in background and saved as wisdom in the
+ config directory, so the following runs get it without measuring.
+ */
+
+// wisdom file, in the config directory. FFTW keeps separate wisdom for each
+// precission.
+#ifdef LINGOT_FLOAT
+#define FFT_WISDOM_FILE_NAME	"fftwf.wisdom"
+#else
+#define FFT_WISDOM_FILE_NAME	"fftw.wisdom"
+#endif
+
+// flags for the plans computed in background. FFTW_PATIENT barely improves
+// the plans at the sizes we use, and keeps a CPU busy for seconds while the
+// user is tuning.
+#define FFT_MEASURED_FLAGS	FFTW_MEASURE
+
+// maximum number of plan sizes cached.
+#define FFT_PLAN_CACHE_SIZE	8
+
+typedef struct _LingotFFTPlanCacheEntry LingotFFTPlanCacheEntry;
+
+struct _LingotFFTPlanCacheEntry {
+	int n;
+	FFTW(plan) estimated_plan;
+	FFTW(plan) measured_plan; // NULL until available.
+
+	pthread_t planner_thread;
+	int planner_thread_running;
+};
+
+static LingotFFTPlanCacheEntry lingot_fft_plan_cache[FFT_PLAN_CACHE_SIZE];
+static int lingot_fft_plan_cache_size = 0;
+static int lingot_fft_wisdom_loaded = 0;
+
+// the FFTW planner isn't thread safe, only the execution of the plans is.
+static pthread_mutex_t lingot_fft_planner_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// returns 0 if there is no wisdom file, without a home directory or if its
+// path doesn't fit, and then the wisdom is neither read nor written.
+static int lingot_fft_wisdom_file_name(char* file_name, size_t size) {
+	const char* home = getenv("HOME");
+	int n;
+
+	if (home == NULL) {
+		return 0;
+	}
+
+	n = snprintf(file_name, size, "%s/" CONFIG_DIR_NAME FFT_WISDOM_FILE_NAME,
+			home);
+	if ((n < 0) || ((size_t) n >= size)) {
+		fprintf(stderr, "warning: FFTW wisdom file name too long\n");
+		return 0;
+	}
+
+	return 1;
+}
+
+// must be called with the planner mutex locked.
+static void lingot_fft_wisdom_load() {
+	char file_name[PATH_MAX];
+	FILE* fp;
+
+	if (!lingot_fft_wisdom_file_name(file_name, sizeof(file_name))) {
+		return;
+	}
+	if ((fp = fopen(file_name, "r")) != NULL) {
+		if (!FFTW(import_wisdom_from_file)(fp)) {
+			fprintf(stderr, "warning: cannot import FFTW wisdom from %s\n",
+					file_name);
+		}
+		fclose(fp);
+	}
+}
+
+// must be called with the planner mutex locked.
+static void lingot_fft_wisdom_save() {
+	char file_name[PATH_MAX];
+	FILE* fp;
+
+	if (!lingot_fft_wisdom_file_name(file_name, sizeof(file_name))) {
+		return;
+	}
+	if ((fp = fopen(file_name, "w")) != NULL) {
+		FFTW(export_wisdom_to_file)(fp);
+		fclose(fp);
+	} else {
+		fprintf(stderr, "warning: cannot save FFTW wisdom into %s\n",
+				file_name);
+	}
+}
+
+static void* lingot_fft_planner_thread(void* arg) {
+	LingotFFTPlanCacheEntry* entry = (LingotFFTPlanCacheEntry*) arg;
+	FFTW(plan) plan;
+
+	// measuring overwrites the arrays, so they can't be the ones in use.
+	FLT* in = FFTW(malloc)(entry->n * sizeof(FLT));
+	FFTW(complex)* out = FFTW(malloc)(entry->n * sizeof(FFTW(complex)));
+
+	pthread_mutex_lock(&lingot_fft_planner_mutex);
+	plan = FFTW(plan_dft_r2c_1d)(entry->n, in, out, FFT_MEASURED_FLAGS);
+	entry->measured_plan = plan;
+	lingot_fft_wisdom_save();
+	pthread_mutex_unlock(&lingot_fft_planner_mutex);
+
+	FFTW(free)(out);
+	FFTW(free)(in);
+
+	return NULL;
+}
+
+// gets the best cached plan for the given size, or NULL if the cache is full.
+// Must be called with the planner mutex locked.
+static FFTW(plan) lingot_fft_plan_cache_get(int n) {
+	LingotFFTPlanCacheEntry* entry = NULL;
+	FLT* in;
+	FFTW(complex)* out;
+	int i;
+
+	if (!lingot_fft_wisdom_loaded) {
+		lingot_fft_wisdom_load();
+		lingot_fft_wisdom_loaded = 1;
+	}
+
+	for (i = 0; i < lingot_fft_plan_cache_size; i++) {
+		if (lingot_fft_plan_cache[i].n == n) {
+			entry = &lingot_fft_plan_cache[i];
+			break;
+		}
+	}
+
+	if (entry == NULL) {
+		if (lingot_fft_plan_cache_size == FFT_PLAN_CACHE_SIZE) {
+			return NULL;
+		}
+
+		entry = &lingot_fft_plan_cache[lingot_fft_plan_cache_size++];
+		entry->n = n;
+		entry->planner_thread_running = 0;
+
+		// the cached plans are made for aligned arrays, and executed over
+		// the arrays of each FFT plan.
+		in = FFTW(malloc)(n * sizeof(FLT));
+		out = FFTW(malloc)(n * sizeof(FFTW(complex)));
+		entry->estimated_plan = FFTW(plan_dft_r2c_1d)(n, in, out,
+				FFTW_ESTIMATE);
+		entry->measured_plan = FFTW(plan_dft_r2c_1d)(n, in, out,
+				FFT_MEASURED_FLAGS | FFTW_WISDOM_ONLY);
+		FFTW(free)(out);
+		FFTW(free)(in);
+
+		if (entry->measured_plan == NULL) {
+			if (pthread_create(&entry->planner_thread, NULL,
+					lingot_fft_planner_thread, entry) == 0) {
+				entry->planner_thread_running = 1;
+			} else {
+				fprintf(stderr, "warning: cannot start the FFTW planner\n");
+			}
+		}
+	}
+
+	return (entry->measured_plan != NULL) ?
+			entry->measured_plan : entry->estimated_plan;
+}
+
+void lingot_fft_cleanup() {
+	int i;
+
+	for (i = 0; i < lingot_fft_plan_cache_size; i++) {
+		if (lingot_fft_plan_cache[i].planner_thread_running) {
+			pthread_join(lingot_fft_plan_cache[i].planner_thread, NULL);
+			lingot_fft_plan_cache[i].planner_thread_running = 0;
+		}
+	}
+
+	pthread_mutex_lock(&lingot_fft_planner_mutex);
+	for (i = 0; i < lingot_fft_plan_cache_size; i++) {
+		FFTW(destroy_plan)(lingot_fft_plan_cache[i].estimated_plan);
+		if (lingot_fft_plan_cache[i].measured_plan != NULL) {
+			FFTW(destroy_plan)(lingot_fft_plan_cache[i].measured_plan);
+		}
+	}
+	lingot_fft_plan_cache_size = 0;
+	pthread_mutex_unlock(&lingot_fft_planner_mutex);
+}
+
+#else
+
+void lingot_fft_cleanup() {
+}
+
+#endif
+
 /*
  DTFT functions.
  */
@@ -44,24 +259,64 @@ LingotFFTPlan* lingot_fft_plan_create(FLT* in, int n) {
 	result->in = in;
 
 #ifdef LIBFFTW
-	result->fft_out = fftw_malloc(n * sizeof(fftw_complex));
-	memset(result->fft_out, 0, n * sizeof(fftw_complex));
-	result->fftwplan = fftw_plan_dft_r2c_1d(n, in, result->fft_out,
-			FFTW_ESTIMATE);
+	result->fft_out = FFTW(malloc)(n * sizeof(FFTW(complex)));
+	memset(result->fft_out, 0, n * sizeof(FFTW(complex)));
+
+	pthread_mutex_lock(&lingot_fft_planner_mutex);
+	result->fftwplan = NULL;
+	if ((FFTW(alignment_of)(in) == 0)
+			&& (FFTW(alignment_of)((FLT*) result->fft_out) == 0)) {
+		result->fftwplan = lingot_fft_plan_cache_get(n);
+	}
+	// misaligned input or full cache, the plan can't be shared.
+	result->own_plan = (result->fftwplan == NULL);
+	if (result->own_plan) {
+		result->fftwplan = FFTW(plan_dft_r2c_1d)(n, in, result->fft_out,
+				FFTW_ESTIMATE);
+	}
+	pthread_mutex_unlock(&lingot_fft_planner_mutex);
 #else
+	const unsigned int M = n >> 1; // complex samples.
 	FLT alpha;
-	unsigned int i;
+	unsigned int i, j, k, h, bits;
+	LingotComplex* w;
+
+	// bit reversal permutation.
+	result->bit_reversal = malloc(M * sizeof(unsigned int));
+	for (bits = 0; (1u << bits) < M; bits++)
+		;
+	for (i = 0; i < M; i++) {
+		for (j = 0, k = 0; k < bits; k++) {
+			j |= ((i >> k) & 1) << (bits - 1 - k);
+		}
+		result->bit_reversal[i] = j;
+	}
 
-	// twiddle factors
-	result->wn = (LingotComplex*) malloc((n >> 1) * sizeof(LingotComplex));
+	// twiddle factors of the radix-4 stages, of quarter size h, after an
+	// optional first radix-2 stage.
+	result->wn = (LingotComplex*) malloc(M * sizeof(LingotComplex));
+	w = result->wn;
+	for (h = (bits & 1) ? 2 : 1; 4 * h <= M; h <<= 2) {
+		for (k = 0; k < h; k++) {
+			for (j = 1; j <= 3; j++, w++) {
+				alpha = -2.0 * M_PI * j * k / (4 * h);
+				(*w)[0] = cos(alpha);
+				(*w)[1] = sin(alpha);
+			}
+		}
+	}
 
-	for (i = 0; i < (n >> 1); i++) {
+	// twiddle factors for the split of the packed spectrum.
+	result->wr = (LingotComplex*) malloc((M / 2 + 1) * sizeof(LingotComplex));
+	for (i = 0; i <= M / 2; i++) {
 		alpha = -2.0 * i * M_PI / n;
-		result->wn[i][0] = cos(alpha);
-		result->wn[i][1] = sin(alpha);
+		result->wr[i][0] = cos(alpha);
+		result->wr[i][1] = sin(alpha);
 	}
+
 	result->fft_out = malloc(n * sizeof(LingotComplex)); // complex signal in freq domain.
 	memset(result->fft_out, 0, n * sizeof(LingotComplex));
+
 #endif
 
 	return result;
@@ -70,11 +325,17 @@ LingotFFTPlan* lingot_fft_plan_create(FLT* in, int n) {
 void lingot_fft_plan_destroy(LingotFFTPlan* plan) {
 
 #ifdef LIBFFTW
-	fftw_destroy_plan(plan->fftwplan);
-	fftw_free(plan->fft_out);
+	if (plan->own_plan) {
+		pthread_mutex_lock(&lingot_fft_planner_mutex);
+		FFTW(destroy_plan)(plan->fftwplan);
+		pthread_mutex_unlock(&lingot_fft_planner_mutex);
+	}
+	FFTW(free)(plan->fft_out);
 #else
 	free(plan->fft_out);
 	free(plan->wn);
+	free(plan->wr);
+	free(plan->bit_reversal);
 #endif
 
 	free(plan);
@@ -82,43 +343,221 @@ void lingot_fft_plan_destroy(LingotFFTPlan* plan) {
 
 #ifndef LIBFFTW
 
-void _lingot_fft_fft(FLT* in, LingotComplex* out, LingotComplex* wn, unsigned long int N,
-		unsigned long int offset, unsigned long int d1, unsigned long int step) {
-	LingotComplex X1, X2;
-	unsigned long int Np2 = (N >> 1); // N/2
-	register unsigned long int a, b, c, q;
+// complex samples processed at once by the first stages, so they stay in the
+// L1 cache.
+#define FFT_BLOCK_SIZE	1024
 
-	if (N == 2) { // butterfly for N = 2;
+static inline __attribute__((always_inline)) lingot_fft_v2 lingot_fft_load(
+		const FLT* x) {
+	lingot_fft_v2 v;
+	memcpy(&v, x, sizeof(v));
+	return v;
+}
 
-		X1[0] = in[offset];
-		X1[1] = 0.0;
-		X2[0] = in[offset + step];
-		X2[1] = 0.0;
+static inline __attribute__((always_inline)) void lingot_fft_store(FLT* x,
+		lingot_fft_v2 v) {
+	memcpy(x, &v, sizeof(v));
+}
 
-		lingot_complex_add(X1, X2, out[d1]);
-		lingot_complex_sub(X1, X2, out[d1 + Np2]);
+// complex product, with both parts of x in a SIMD register.
+static inline __attribute__((always_inline)) lingot_fft_v2 lingot_fft_cmul(
+		lingot_fft_v2 x, const FLT* w) {
+	const lingot_fft_m2 swap = { 1, 0 };
+	return x * (lingot_fft_v2 ) { w[0], w[0] }
+			+ __builtin_shuffle(x, swap) * (lingot_fft_v2 ) { -w[1], w[1] };
+}
 
-		return;
+// radix-4 butterfly over x0..x3 = x[0], x[h], x[2h], x[3h], with twiddle
+// factors w^k, w^2k and w^3k (NULL for k = 0, where they are 1). The samples
+// are in bit reversed order, so each butterfly is equivalent to two radix-2
+// ones.
+static inline __attribute__((always_inline)) void lingot_fft_radix4_butterfly(
+		LingotComplex* x, unsigned int h, const LingotComplex* w) {
+	const lingot_fft_m2 swap = { 1, 0 };
+	lingot_fft_v2 a, b, c, d, t0, t1, t2, t3;
+
+	// b = w^2k * x1, c = w^k * x2, d = w^3k * x3
+	a = lingot_fft_load(x[0]);
+	b = lingot_fft_load(x[h]);
+	c = lingot_fft_load(x[2 * h]);
+	d = lingot_fft_load(x[3 * h]);
+	if (w != NULL) {
+		b = lingot_fft_cmul(b, w[1]);
+		c = lingot_fft_cmul(c, w[0]);
+		d = lingot_fft_cmul(d, w[2]);
 	}
 
-	_lingot_fft_fft(in, out, wn, Np2, offset, d1, step << 1);
-	_lingot_fft_fft(in, out, wn, Np2, offset + step, d1 + Np2, step << 1);
+	t0 = a + b;
+	t1 = a - b;
+	t2 = c + d;
+	// -j * (c - d)
+	t3 = __builtin_shuffle(c - d, swap) * (lingot_fft_v2 ) { 1.0, -1.0 };
 
-	for (q = 0, c = 0; q < (N >> 1); q++, c += step) {
+	lingot_fft_store(x[0], t0 + t2);
+	lingot_fft_store(x[2 * h], t0 - t2);
+	lingot_fft_store(x[h], t1 + t3);
+	lingot_fft_store(x[3 * h], t1 - t3);
+}
+
+// radix-2 butterfly over x[0] and x[1], without twiddle factors.
+static inline __attribute__((always_inline)) void lingot_fft_radix2_butterfly(
+		LingotComplex* x) {
+	lingot_fft_v2 a = lingot_fft_load(x[0]);
+	lingot_fft_v2 b = lingot_fft_load(x[1]);
+	lingot_fft_store(x[0], a + b);
+	lingot_fft_store(x[1], a - b);
+}
 
-		a = q + d1;
-		b = a + Np2;
+// radix-4 decimation in time stage over the n complex samples in x, with
+// butterflies of quarter size h. Each set of twiddle factors is loaded once
+// for all the groups.
+static inline __attribute__((always_inline)) void lingot_fft_radix4_stage(
+		LingotComplex* x, unsigned int n,
+		unsigned int h, const LingotComplex* w) {
+	register unsigned int g, k;
 
-		X1[0] = out[a][0];
-		X1[1] = out[a][1];
-		lingot_complex_mul(out[b], wn[c], X2);
-		lingot_complex_add(X1, X2, out[a]);
-		lingot_complex_sub(X1, X2, out[b]);
+	for (g = 0; g < n; g += 4 * h) {
+		lingot_fft_radix4_butterfly(&x[g], h, NULL);
+	}
+	for (k = 1; k < h; k++) {
+		for (g = k; g < n; g += 4 * h) {
+			lingot_fft_radix4_butterfly(&x[g], h, &w[3 * k]);
+		}
+	}
+}
+
+#define C8	0.70710678118654752440 // cos(pi/4)
+#define C16	0.92387953251128675613 // cos(pi/8)
+#define S16	0.38268343236508977173 // sin(pi/8)
+
+// twiddle factors of the 8 and 16 samples codelets, {w^k, w^2k, w^3k} for
+// k > 0.
+static const LingotComplex lingot_fft_w8[3] = { { C8, -C8 }, { 0.0, -1.0 }, {
+		-C8, -C8 } };
+static const LingotComplex lingot_fft_w16[9] = { { C16, -S16 }, { C8, -C8 }, {
+		S16, -C16 }, { C8, -C8 }, { 0.0, -1.0 }, { -C8, -C8 },
+		{ S16, -C16 }, { -C8, -C8 }, { -C16, S16 } };
+
+// first stages over 8 bit reversed samples, a radix-2 and a radix-4 one, as
+// straight line code with constant twiddle factors.
+static inline __attribute__((always_inline)) void lingot_fft_codelet_8(
+		LingotComplex* x) {
+	register unsigned int i;
+
+	for (i = 0; i < 8; i += 2) {
+		lingot_fft_radix2_butterfly(&x[i]);
+	}
+	lingot_fft_radix4_butterfly(&x[0], 2, NULL);
+	lingot_fft_radix4_butterfly(&x[1], 2, lingot_fft_w8);
+}
+
+// first two radix-4 stages over 16 bit reversed samples, as straight line
+// code with constant twiddle factors.
+static inline __attribute__((always_inline)) void lingot_fft_codelet_16(
+		LingotComplex* x) {
+	lingot_fft_radix4_butterfly(&x[0], 1, NULL);
+	lingot_fft_radix4_butterfly(&x[4], 1, NULL);
+	lingot_fft_radix4_butterfly(&x[8], 1, NULL);
+	lingot_fft_radix4_butterfly(&x[12], 1, NULL);
+	lingot_fft_radix4_butterfly(&x[0], 4, NULL);
+	lingot_fft_radix4_butterfly(&x[1], 4, &lingot_fft_w16[0]);
+	lingot_fft_radix4_butterfly(&x[2], 4, &lingot_fft_w16[3]);
+	lingot_fft_radix4_butterfly(&x[3], 4, &lingot_fft_w16[6]);
+}
+
+/*
+ Iterative in place FFT of the real signal. The n real samples are packed as
+ M = n/2 complex ones, z[m] = x[2m] + j*x[2m+1], transformed with a radix-4
+ complex FFT, and then the spectrum is split in the transforms of the even
+ and odd samples, which give the first n/2 + 1 bins of the real signal.
+
+ The same code serves every size: only the first stages, in the codelets,
+ have constant twiddle factors.
+ */
+static void lingot_fft_rfft(LingotFFTPlan* plan, const unsigned int M) {
+	const FLT* in = plan->in;
+	LingotComplex* z = plan->fft_out;
+	const LingotComplex* w;
+	const LingotComplex* w_first;
+	register unsigned int i, k, h;
+	unsigned int first_h, block, block_size;
+	FLT even_r, even_i, odd_r, odd_i, tr, ti;
+
+	// packing, in bit reversed order.
+	for (i = 0; i < M; i++) {
+		z[plan->bit_reversal[i]][0] = in[2 * i];
+		z[plan->bit_reversal[i]][1] = in[2 * i + 1];
+	}
+
+	for (h = 1; 4 * h <= M; h <<= 2)
+		;
+	w_first = plan->wn;
+	if (M >= 16) {
+		// the first stages as codelets, a radix-2 one first when M is not
+		// a power of 4.
+		if (h < M) {
+			for (i = 0; i < M; i += 8) {
+				lingot_fft_codelet_8(&z[i]);
+			}
+			first_h = 8;
+			w_first += 3 * 2;
+		} else {
+			for (i = 0; i < M; i += 16) {
+				lingot_fft_codelet_16(&z[i]);
+			}
+			first_h = 16;
+			w_first += 3 * (1 + 4);
+		}
+	} else {
+		// radix-2 stage first, when M is not a power of 4.
+		first_h = 1;
+		if (h < M) {
+			for (i = 0; i < M; i += 2) {
+				lingot_fft_radix2_butterfly(&z[i]);
+			}
+			first_h = 2;
+		}
+	}
+
+	// the stages whose butterflies fit in a block are done block by block,
+	// and the rest over the whole signal.
+	block_size = (M < FFT_BLOCK_SIZE) ? M : FFT_BLOCK_SIZE;
+	h = first_h;
+	w = w_first;
+	for (block = 0; block < M; block += block_size) {
+		w = w_first;
+		for (h = first_h; 4 * h <= block_size; h <<= 2) {
+			lingot_fft_radix4_stage(&z[block], block_size, h, w);
+			w += 3 * h;
+		}
+	}
+	for (; 4 * h <= M; h <<= 2) {
+		lingot_fft_radix4_stage(z, M, h, w);
+		w += 3 * h;
+	}
+
+	// split: X[k] = E[k] + W^k O[k], X[M - k] = conj(E[k] - W^k O[k]),
+	// with E[k] = (Z[k] + conj(Z[M - k])) / 2
+	// and O[k] = -j (Z[k] - conj(Z[M - k])) / 2
+	for (k = 0; k <= M / 2; k++) {
+		const FLT* zk = z[k];
+		const FLT* zmk = z[(M - k) & (M - 1)];
+		const FLT* wr = plan->wr[k];
+		even_r = 0.5 * (zk[0] + zmk[0]);
+		even_i = 0.5 * (zk[1] - zmk[1]);
+		odd_r = 0.5 * (zk[1] + zmk[1]);
+		odd_i = -0.5 * (zk[0] - zmk[0]);
+		tr = wr[0] * odd_r - wr[1] * odd_i;
+		ti = wr[0] * odd_i + wr[1] * odd_r;
+		z[M - k][0] = even_r - tr;
+		z[M - k][1] = -(even_i - ti);
+		z[k][0] = even_r + tr;
+		z[k][1] = even_i + ti;
 	}
 }
 
 void lingot_fft_fft(LingotFFTPlan* plan) {
-	_lingot_fft_fft(plan->in, plan->fft_out, plan->wn, plan->n, 0, 0, 1);
+	lingot_fft_rfft(plan, plan->n >> 1);
 }
 
 #endif
@@ -130,7 +569,7 @@ void lingot_fft_compute_dft_and_spd(LingotFFTPlan* plan, FLT* out, int n_out) {
 
 # ifdef LIBFFTW
 	// transformation.
-	fftw_execute(plan->fftwplan);
+	FFTW(execute_dft_r2c)(plan->fftwplan, plan->in, plan->fft_out);
 # else
 	// transformation.
 	lingot_fft_fft(plan);
@@ -168,41 +607,96 @@ void lingot_fft_spd_eval(FLT* in, int N1, FLT wi, FLT dw, FLT* out, int N2) {
 	}
 }
 
-void lingot_fft_spd_diffs_eval(const FLT* in, int N, FLT w, FLT* out_d0,
-		FLT* out_d1, FLT* out_d2) {
-	FLT x_cos_wn;
-	FLT x_sin_wn;
-	const FLT N2 = N * N;
-
-	int n;
-
-	FLT SUM_x_sin_wn = 0.0;
-	FLT SUM_x_cos_wn = 0.0;
-	FLT SUM_x_n_sin_wn = 0.0;
-	FLT SUM_x_n_cos_wn = 0.0;
-	FLT SUM_x_n2_sin_wn = 0.0;
-	FLT SUM_x_n2_cos_wn = 0.0;
-
-	for (n = 0; n < N; n++) {
-
-		x_cos_wn = in[n] * cos(w * n);
-		x_sin_wn = in[n] * sin(w * n);
+// samples between exact evaluations of the phasor.
+#define SPD_DIFFS_BLOCK_SIZE	256
+
+void lingot_fft_spd_diffs_eval(const FLT* in, const FLT* window, int N,
+		double w, double* out_d0, double* out_d1, double* out_d2) {
+	const double N2 = (double) N * N;
+	const double cos_2w = cos(2.0 * w);
+	const double sin_2w = sin(2.0 * w);
+
+	int n, block_end;
+	double x, n_;
+
+	// each lane accumulates the even or the odd samples.
+	lingot_fft_v2d x_cos_wn, x_sin_wn, cos_wn, sin_wn, aux, v_n, v_x;
+	lingot_fft_v2d sum_x_sin_wn = { 0.0, 0.0 };
+	lingot_fft_v2d sum_x_cos_wn = { 0.0, 0.0 };
+	lingot_fft_v2d sum_x_n_sin_wn = { 0.0, 0.0 };
+	lingot_fft_v2d sum_x_n_cos_wn = { 0.0, 0.0 };
+	lingot_fft_v2d sum_x_n2_sin_wn = { 0.0, 0.0 };
+	lingot_fft_v2d sum_x_n2_cos_wn = { 0.0, 0.0 };
+
+	for (n = 0; n < N;) {
+
+		// the phasor e^(jwn) is obtained by rotating the previous one, we
+		// only compute it exactly at the beginning of each block, so the
+		// rounding errors of the rotations don't build up.
+		block_end = n + SPD_DIFFS_BLOCK_SIZE;
+		if (block_end > N) {
+			block_end = N;
+		}
+		cos_wn = (lingot_fft_v2d ) { cos(w * n), cos(w * (n + 1)) };
+		sin_wn = (lingot_fft_v2d ) { sin(w * n), sin(w * (n + 1)) };
+		v_n = (lingot_fft_v2d ) { n, n + 1 };
+
+		for (; n + 1 < block_end; n += 2) {
+
+			v_x = (lingot_fft_v2d ) { in[n], in[n + 1] };
+			if (window != NULL) {
+				v_x *= (lingot_fft_v2d ) { window[n], window[n + 1] };
+			}
+
+			x_cos_wn = v_x * cos_wn;
+			x_sin_wn = v_x * sin_wn;
+			sum_x_cos_wn += x_cos_wn;
+			sum_x_sin_wn += x_sin_wn;
+			x_cos_wn *= v_n;
+			x_sin_wn *= v_n;
+			sum_x_n_cos_wn += x_cos_wn;
+			sum_x_n_sin_wn += x_sin_wn;
+			x_cos_wn *= v_n;
+			x_sin_wn *= v_n;
+			sum_x_n2_cos_wn += x_cos_wn;
+			sum_x_n2_sin_wn += x_sin_wn;
+
+			// rotation by 2w.
+			aux = cos_wn * cos_2w - sin_wn * sin_2w;
+			sin_wn = sin_wn * cos_2w + cos_wn * sin_2w;
+			cos_wn = aux;
+			v_n += 2.0;
+		}
 
-		SUM_x_sin_wn += x_sin_wn;
-		SUM_x_cos_wn += x_cos_wn;
-		SUM_x_n_sin_wn += x_sin_wn * n;
-		SUM_x_n_cos_wn += x_cos_wn * n;
-		SUM_x_n2_sin_wn += x_sin_wn * n * n;
-		SUM_x_n2_cos_wn += x_cos_wn * n * n;
+		if (n < block_end) { // odd number of samples.
+			x = in[n];
+			if (window != NULL) {
+				x *= window[n];
+			}
+			n_ = n;
+			sum_x_cos_wn[0] += x * cos_wn[0];
+			sum_x_sin_wn[0] += x * sin_wn[0];
+			sum_x_n_cos_wn[0] += x * cos_wn[0] * n_;
+			sum_x_n_sin_wn[0] += x * sin_wn[0] * n_;
+			sum_x_n2_cos_wn[0] += x * cos_wn[0] * n_ * n_;
+			sum_x_n2_sin_wn[0] += x * sin_wn[0] * n_ * n_;
+			n++;
+		}
 	}
 
-	FLT N_2 = N * N;
+	const double SUM_x_sin_wn = sum_x_sin_wn[0] + sum_x_sin_wn[1];
+	const double SUM_x_cos_wn = sum_x_cos_wn[0] + sum_x_cos_wn[1];
+	const double SUM_x_n_sin_wn = sum_x_n_sin_wn[0] + sum_x_n_sin_wn[1];
+	const double SUM_x_n_cos_wn = sum_x_n_cos_wn[0] + sum_x_n_cos_wn[1];
+	const double SUM_x_n2_sin_wn = sum_x_n2_sin_wn[0] + sum_x_n2_sin_wn[1];
+	const double SUM_x_n2_cos_wn = sum_x_n2_cos_wn[0] + sum_x_n2_cos_wn[1];
+
 	*out_d0 = (SUM_x_cos_wn * SUM_x_cos_wn + SUM_x_sin_wn * SUM_x_sin_wn) / N2;
 	*out_d1 = 2.0
 			* (SUM_x_sin_wn * SUM_x_n_cos_wn - SUM_x_cos_wn * SUM_x_n_sin_wn)
-			/ N_2;
+			/ N2;
 	*out_d2 = 2.0
 			* (SUM_x_n_cos_wn * SUM_x_n_cos_wn - SUM_x_sin_wn * SUM_x_n2_sin_wn
 					+ SUM_x_n_sin_wn * SUM_x_n_sin_wn
-					- SUM_x_cos_wn * SUM_x_n2_cos_wn) / N_2;
+					- SUM_x_cos_wn * SUM_x_n2_cos_wn) / N2;
 }
@@ -33,6 +33,13 @@
 
 #ifdef LIBFFTW
 # include <fftw3.h>
+
+// FFTW API for the precission in use.
+# ifdef LINGOT_FLOAT
+#  define FFTW(name) fftwf_ ## name
+# else
+#  define FFTW(name) fftw_ ## name
+# endif
 #endif
 
 # include "lingot-complex.h"
@@ -45,10 +52,21 @@ struct _LingotFFTPlan {
 	FLT* in;
 
 #ifdef LIBFFTW
-	fftw_plan fftwplan;
+	// possibly shared with other plans of the same size.
+	FFTW(plan) fftwplan;
+	int own_plan;
 #else
-// phase factor table, for FFT optimization.
+	// the n real samples are transformed as n/2 complex ones.
+
+	// bit reversal permutation of the n/2 complex samples.
+	unsigned int* bit_reversal;
+
+	// phase factor table, for FFT optimization. The three twiddle factors
+	// of each radix-4 butterfly, stage after stage.
 	LingotComplex* wn;
+
+	// phase factors for splitting the spectrum of the packed signal.
+	LingotComplex* wr;
 #endif
 	LingotComplex* fft_out; // complex signal in freq.
 };
@@ -56,14 +74,20 @@ struct _LingotFFTPlan {
 LingotFFTPlan* lingot_fft_plan_create(FLT* in, int n);
 void lingot_fft_plan_destroy(LingotFFTPlan*);
 
+// waits for the plans being computed in background and releases the cached
+// ones. No FFT plans must be in use.
+void lingot_fft_cleanup();
+
 // Full Spectral Power Distribution (SPD) esteem.
 void lingot_fft_compute_dft_and_spd(LingotFFTPlan*, FLT* out, int n_out);
 
 // Spectral Power Distribution (SPD) evaluation at a given frequency.
 void lingot_fft_spd_eval(FLT* in, int N1, FLT wi, FLT dw, FLT* out, int N2);
 
-// Evaluates first and second SPD derivatives at frequency w.
-void lingot_fft_spd_diffs_eval(const FLT* in, int N, FLT w, FLT* out_d0,
-		FLT* out_d1, FLT* out_d2);
+// Evaluates first and second SPD derivatives at frequency w, applying the
+// given window to the input samples on the fly (NULL for no window). The
+// sums are accumulated in double precission whatever FLT is.
+void lingot_fft_spd_diffs_eval(const FLT* in, const FLT* window, int N,
+		double w, double* out_d0, double* out_d1, double* out_d2);
 
 #endif
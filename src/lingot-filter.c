@@ -30,12 +30,75 @@
 
 #define max(a,b) (((a)<(b))?(b):(a))
 
+// pair of lanes, packed in a SIMD register, and an integer vector of the
+// same geometry for shuffling them. Four lanes are handled as two pairs,
+// which map to SSE2 registers (or both halves of an AVX one).
+typedef FLT lingot_filter_v2 __attribute__ ((vector_size (2 * sizeof(FLT))));
+typedef __typeof__(__builtin_choose_expr(sizeof(FLT) == sizeof(long long),
+		0LL, 0)) lingot_filter_int;
+typedef lingot_filter_int lingot_filter_m2 __attribute__ ((vector_size (2 * sizeof(FLT))));
+
+LingotFilter* lingot_filter_new_sos(unsigned int sections, const FLT* sos) {
+	unsigned int i, k;
+	LingotFilter* filter = malloc(sizeof(LingotFilter));
+	LingotFilterSections* group;
+
+	filter->N = 0;
+	filter->a = NULL;
+	filter->b = NULL;
+	filter->s = NULL;
+
+	filter->sections = sections;
+	filter->groups = (sections + LINGOT_FILTER_LANES - 1) / LINGOT_FILTER_LANES;
+	filter->group = malloc(filter->groups * sizeof(LingotFilterSections));
+
+	for (i = 0; i < filter->groups * LINGOT_FILTER_LANES; i++, sos += 5) {
+		group = &filter->group[i / LINGOT_FILTER_LANES];
+		k = i % LINGOT_FILTER_LANES;
+		if (i < sections) {
+			group->b0[k] = sos[0];
+			group->b1[k] = sos[1];
+			group->b2[k] = sos[2];
+			group->a1[k] = sos[3];
+			group->a2[k] = sos[4];
+		} else {
+			// the last group is completed with identity sections.
+			group->b0[k] = 1.0;
+			group->b1[k] = 0.0;
+			group->b2[k] = 0.0;
+			group->a1[k] = 0.0;
+			group->a2[k] = 0.0;
+		}
+		group->s1[k] = 0.0;
+		group->s2[k] = 0.0;
+	}
+
+	return filter;
+}
+
 // given each polynomial order and coefs, with optional initial status.
 LingotFilter* lingot_filter_new(unsigned int Na, unsigned int Nb, const FLT* a,
 		const FLT* b) {
 	unsigned int i;
-	LingotFilter* filter = malloc(sizeof(LingotFilter));
+	LingotFilter* filter;
+
+	if (max(Na, Nb) <= 2) {
+		// a single second order section.
+		FLT sos[5] = { 0.0, 0.0, 0.0, 0.0, 0.0 };
+		for (i = 0; i <= Nb; i++) {
+			sos[i] = b[i] / a[0];
+		}
+		for (i = 1; i <= Na; i++) {
+			sos[2 + i] = a[i] / a[0];
+		}
+		return lingot_filter_new_sos(1, sos);
+	}
+
+	filter = malloc(sizeof(LingotFilter));
 	filter->N = max(Na, Nb);
+	filter->groups = 0;
+	filter->group = NULL;
+	filter->sections = 0;
 
 	filter->a = malloc((filter->N + 1) * sizeof(FLT));
 	filter->b = malloc((filter->N + 1) * sizeof(FLT));
@@ -60,19 +123,145 @@ LingotFilter* lingot_filter_new(unsigned int Na, unsigned int Nb, const FLT* a,
 
 void lingot_filter_reset(LingotFilter* filter) {
 	unsigned int i;
-	for (i = 0; i <= filter->N; i++) {
-		filter->s[i] = 0.0;
+	for (i = 0; i < filter->groups; i++) {
+		memset(filter->group[i].s1, 0, sizeof(filter->group[i].s1));
+		memset(filter->group[i].s2, 0, sizeof(filter->group[i].s2));
+	}
+	if (filter->s != NULL) {
+		for (i = 0; i <= filter->N; i++) {
+			filter->s[i] = 0.0;
+		}
 	}
 }
 
 void lingot_filter_destroy(LingotFilter* filter) {
-	free(filter->a);
-	free(filter->b);
-	free(filter->s);
+	if (filter->group != NULL) {
+		free(filter->group);
+	} else {
+		free(filter->a);
+		free(filter->b);
+		free(filter->s);
+	}
 
 	free(filter);
 }
 
+// advances the lanes from first to last one step, one by one. The lanes are
+// traversed backwards so each one still sees the previous output of the
+// former.
+static void lingot_filter_sections_step(LingotFilterSections* group, FLT* y,
+		int first, int last, FLT in) {
+	int k;
+	FLT x;
+
+	for (k = last; k >= first; k--) {
+		x = (k == 0) ? in : y[k - 1];
+		y[k] = group->b0[k] * x + group->s1[k];
+		group->s1[k] = (group->b1[k] * x + group->s2[k]) - group->a1[k] * y[k];
+		group->s2[k] = group->b2[k] * x - group->a2[k] * y[k];
+	}
+}
+
+// filters the vector through a group of sections. The sections are
+// pipelined, each one in a SIMD lane: at step t, section k takes the output
+// of section k - 1 at step t - 1, and so it processes the sample t - k. All
+// the sections advance at once with vector operations, and the recursion
+// only has to wait for a multiplication and an addition per sample, for the
+// whole group. The first and last steps, where some sections are out of the
+// vector, are computed lane by lane.
+static void lingot_filter_sections_filter(LingotFilterSections* group,
+		unsigned int n, const FLT* in, FLT* out) {
+	const int L = LINGOT_FILTER_LANES;
+	const lingot_filter_m2 shift_lo = { 2, 0 }; // in, y0
+	const lingot_filter_m2 shift_hi = { 1, 2 }; // y1, y2
+	register int t;
+	lingot_filter_v2 b0_lo, b1_lo, b2_lo, a1_lo, a2_lo, s1_lo, s2_lo;
+	lingot_filter_v2 b0_hi, b1_hi, b2_hi, a1_hi, a2_hi, s1_hi, s2_hi;
+	lingot_filter_v2 x_lo, y_lo, x_hi, y_hi;
+	FLT y_lanes[L];
+
+	// filling the pipeline.
+	for (t = 0; t < L - 1; t++) {
+		lingot_filter_sections_step(group, y_lanes,
+				(t >= (int) n) ? t - (int) n + 1 : 0, t,
+				(t < (int) n) ? in[t] : 0.0);
+	}
+
+	if ((int) n > L - 1) {
+		memcpy(&b0_lo, &group->b0[0], sizeof(b0_lo));
+		memcpy(&b0_hi, &group->b0[2], sizeof(b0_hi));
+		memcpy(&b1_lo, &group->b1[0], sizeof(b1_lo));
+		memcpy(&b1_hi, &group->b1[2], sizeof(b1_hi));
+		memcpy(&b2_lo, &group->b2[0], sizeof(b2_lo));
+		memcpy(&b2_hi, &group->b2[2], sizeof(b2_hi));
+		memcpy(&a1_lo, &group->a1[0], sizeof(a1_lo));
+		memcpy(&a1_hi, &group->a1[2], sizeof(a1_hi));
+		memcpy(&a2_lo, &group->a2[0], sizeof(a2_lo));
+		memcpy(&a2_hi, &group->a2[2], sizeof(a2_hi));
+		memcpy(&s1_lo, &group->s1[0], sizeof(s1_lo));
+		memcpy(&s1_hi, &group->s1[2], sizeof(s1_hi));
+		memcpy(&s2_lo, &group->s2[0], sizeof(s2_lo));
+		memcpy(&s2_hi, &group->s2[2], sizeof(s2_hi));
+		memcpy(&y_lo, &y_lanes[0], sizeof(y_lo));
+		memcpy(&y_hi, &y_lanes[2], sizeof(y_hi));
+
+		for (t = L - 1; t < (int) n; t++) {
+			x_lo = __builtin_shuffle(y_lo, (lingot_filter_v2 ) { in[t] },
+					shift_lo);
+			x_hi = __builtin_shuffle(y_lo, y_hi, shift_hi);
+			y_lo = b0_lo * x_lo + s1_lo;
+			y_hi = b0_hi * x_hi + s1_hi;
+			s1_lo = (b1_lo * x_lo + s2_lo) - a1_lo * y_lo;
+			s1_hi = (b1_hi * x_hi + s2_hi) - a1_hi * y_hi;
+			s2_lo = b2_lo * x_lo - a2_lo * y_lo;
+			s2_hi = b2_hi * x_hi - a2_hi * y_hi;
+			out[t - (L - 1)] = y_hi[1];
+		}
+
+		memcpy(&group->s1[0], &s1_lo, sizeof(s1_lo));
+		memcpy(&group->s1[2], &s1_hi, sizeof(s1_hi));
+		memcpy(&group->s2[0], &s2_lo, sizeof(s2_lo));
+		memcpy(&group->s2[2], &s2_hi, sizeof(s2_hi));
+		memcpy(&y_lanes[0], &y_lo, sizeof(y_lo));
+		memcpy(&y_lanes[2], &y_hi, sizeof(y_hi));
+	}
+
+	// emptying the pipeline.
+	for (; t < (int) n + L - 1; t++) {
+		lingot_filter_sections_step(group, y_lanes, t - (int) n + 1,
+				(t < L - 1) ? t : L - 1, 0.0);
+		out[t - (L - 1)] = y_lanes[L - 1];
+	}
+}
+
+// filters the vector through the section in the first lane of the group,
+// without the pipeline, for the filters with a single section. They are
+// the most used ones (gauge, noise), and the pipeline would compute four
+// sections for one.
+static void lingot_filter_section_filter(LingotFilterSections* group,
+		unsigned int n, const FLT* in, FLT* out) {
+	const FLT b0 = group->b0[0];
+	const FLT b1 = group->b1[0];
+	const FLT b2 = group->b2[0];
+	const FLT a1 = group->a1[0];
+	const FLT a2 = group->a2[0];
+	FLT s1 = group->s1[0];
+	FLT s2 = group->s2[0];
+	FLT x, y;
+	register unsigned int i;
+
+	for (i = 0; i < n; i++) {
+		x = in[i];
+		y = b0 * x + s1;
+		s1 = (b1 * x + s2) - a1 * y;
+		s2 = b2 * x - a2 * y;
+		out[i] = y;
+	}
+
+	group->s1[0] = s1;
+	group->s2[0] = s2;
+}
+
 // Digital Filter Implementation II, in & out overlapables.
 void lingot_filter_filter(LingotFilter* filter, unsigned int n, const FLT* in,
 		FLT* out) {
@@ -80,6 +269,21 @@ void lingot_filter_filter(LingotFilter* filter, unsigned int n, const FLT* in,
 	register unsigned int i;
 	register int j;
 
+	if (filter->sections == 1) {
+		lingot_filter_section_filter(&filter->group[0], n, in, out);
+		return;
+	}
+
+	if (filter->groups > 0) {
+		// each group runs over the whole vector, the following ones in
+		// place.
+		lingot_filter_sections_filter(&filter->group[0], n, in, out);
+		for (i = 1; i < filter->groups; i++) {
+			lingot_filter_sections_filter(&filter->group[i], n, out, out);
+		}
+		return;
+	}
+
 	for (i = 0; i < n; i++) {
 
 		w = in[i];
@@ -106,35 +310,12 @@ FLT lingot_filter_filter_sample(LingotFilter* filter, FLT in) {
 	return result;
 }
 
-// vector prod
-void lingot_filter_vector_product(int n, LingotComplex* vector,
-		LingotComplex result) {
-	register int i;
-	LingotComplex aux1;
-
-	result[0] = 1.0;
-	result[1] = 0.0;
-
-	for (i = 0; i < n; i++) {
-		aux1[0] = -vector[i][0];
-		aux1[1] = -vector[i][1];
-		lingot_complex_mul_by(result, aux1);
-	}
-
-}
-
 // Chebyshev filters
 LingotFilter* lingot_filter_cheby_design(unsigned int n, FLT Rp, FLT wc) {
 	int i; // loops
 	int k;
 	int p;
 
-	FLT a[n + 1];
-	FLT b[n + 1];
-
-	FLT new_a[n + 1];
-	FLT new_b[n + 1];
-
 	// locate poles
 	LingotComplex pole[n];
 
@@ -161,39 +342,15 @@ LingotFilter* lingot_filter_cheby_design(unsigned int n, FLT Rp, FLT wc) {
 		pole[k][1] = cv0 * sin(t);
 	}
 
-	LingotComplex gain;
-	lingot_filter_vector_product(n, pole, gain);
-
-	if ((n & 1) == 0) { // even
-		FLT f = pow(10.0, -0.05 * Rp);
-		gain[0] *= f;
-		gain[1] *= f;
-	}
-
-	FLT f = pow(W, n);
-	gain[0] *= f;
-	gain[1] *= f;
-
 	for (i = 0; i < n; i++) {
 		pole[i][0] *= W;
 		pole[i][1] *= W;
 	}
 
 	// bilinear transform
-	LingotComplex sp[n];
-
-	for (i = 0; i < n; i++) {
-		sp[i][0] = (2.0 - pole[i][0] * T) / T;
-		sp[i][1] = (0.0 - pole[i][1] * T) / T;
-	}
-
 	LingotComplex tmp1;
 	LingotComplex aux2;
 
-	lingot_filter_vector_product(n, sp, tmp1);
-
-	lingot_complex_div_by(gain, tmp1);
-
 	for (i = 0; i < n; i++) {
 		tmp1[0] = (2.0 + pole[i][0] * T);
 		tmp1[1] = (0.0 + pole[i][1] * T);
@@ -202,53 +359,50 @@ LingotFilter* lingot_filter_cheby_design(unsigned int n, FLT Rp, FLT wc) {
 		lingot_complex_div(tmp1, aux2, pole[i]);
 	}
 
-	// compute filter coefficients from pole/zero values
-	a[0] = 1.0;
-	b[0] = 1.0;
-	new_a[0] = 1.0;
-	new_b[0] = 1.0;
-
-	for (i = 1; i <= n; i++) {
-		a[i] = 0.0;
-		b[i] = 0.0;
-		new_a[i] = 0.0;
-		new_b[i] = 0.0;
-	}
+	/*
+	 * The filter is built as a cascade of second order sections, one per
+	 * conjugate pair of poles (plus a first order one if the order is odd),
+	 * instead of expanding the whole polynomials, whose coefficients are
+	 * very sensitive to rounding errors for narrow filters. Each section
+	 * has unitary gain at DC, and the first one carries the overall DC gain.
+	 */
+	unsigned int sections = (n + 1) / 2;
+	FLT sos[5 * sections];
+	FLT* section = sos;
+	FLT g;
 
 	if ((n & 1) == 1) // odd
 			{
 		// first subfilter is first order
-		a[1] = -pole[n / 2][0];
-		b[1] = 1.0;
+		g = 0.5 * (1.0 - pole[n / 2][0]);
+		section[0] = g;
+		section[1] = g;
+		section[2] = 0.0;
+		section[3] = -pole[n / 2][0];
+		section[4] = 0.0;
+		section += 5;
 	}
 
 	// iterate over the conjugate pairs
-	for (p = 0; p < n / 2; p++) {
-		FLT b1 = 2.0;
-		FLT b2 = 1.0;
-
+	for (p = 0; p < n / 2; p++, section += 5) {
 		FLT a1 = -2.0 * pole[p][0];
 		FLT a2 = pole[p][0] * pole[p][0] + pole[p][1] * pole[p][1];
 
-		// 2nd order subfilter per each pair
-		new_a[1] = a[1] + a1 * a[0];
-		new_b[1] = b[1] + b1 * b[0];
-
-		// poly multiplication
-		for (i = 2; i <= n; i++) {
-			new_a[i] = a[i] + a1 * a[i - 1] + a2 * a[i - 2];
-			new_b[i] = b[i] + b1 * b[i - 1] + b2 * b[i - 2];
-		}
-		for (i = 1; i <= n; i++) {
-			a[i] = new_a[i];
-			b[i] = new_b[i];
-		}
+		// 2nd order subfilter per each pair, with zeros at z=-1
+		g = 0.25 * (1.0 + a1 + a2);
+		section[0] = g;
+		section[1] = 2.0 * g;
+		section[2] = g;
+		section[3] = a1;
+		section[4] = a2;
 	}
 
-	gain[0] = fabs(gain[0]);
-	for (i = 0; i <= n; i++) {
-		b[i] *= gain[0];
+	if ((n & 1) == 0) { // even
+		g = pow(10.0, -0.05 * Rp);
+		for (i = 0; i < 3; i++) {
+			sos[i] *= g;
+		}
 	}
 
-	return lingot_filter_new(n, n, a, b);
+	return lingot_filter_new_sos(sections, sos);
 }
@@ -34,6 +34,26 @@
  digital filtering implementation.
  */
 
+// number of second order sections processed in parallel (the kernel
+// handles them as two pairs).
+#define LINGOT_FILTER_LANES 4
+
+typedef struct _LingotFilterSections LingotFilterSections;
+
+// group of second order sections in cascade, in transposed direct form II,
+// each one in a SIMD lane.
+struct _LingotFilterSections {
+
+	FLT b0[LINGOT_FILTER_LANES];
+	FLT b1[LINGOT_FILTER_LANES];
+	FLT b2[LINGOT_FILTER_LANES];
+	FLT a1[LINGOT_FILTER_LANES];
+	FLT a2[LINGOT_FILTER_LANES]; // coefs, a0 = 1
+
+	FLT s1[LINGOT_FILTER_LANES];
+	FLT s2[LINGOT_FILTER_LANES]; // status
+};
+
 typedef struct _LingotFilter LingotFilter;
 
 struct _LingotFilter {
@@ -44,11 +64,20 @@ struct _LingotFilter {
 
 	unsigned int N;
 
+	// cascade of second order sections, used instead of the direct form
+	// above when there is any, in groups of LINGOT_FILTER_LANES. A single
+	// section is filtered in the first lane alone.
+	LingotFilterSections* group;
+	unsigned int groups;
+	unsigned int sections;
 };
 
 LingotFilter* lingot_filter_new(unsigned int Na, unsigned int Nb, const FLT* a,
 		const FLT* b);
 
+// given the sections as {b0, b1, b2, a1, a2} tuples, with a0 = 1.
+LingotFilter* lingot_filter_new_sos(unsigned int sections, const FLT* sos);
+
 void lingot_filter_reset(LingotFilter* filter);
 
 /**
@@ -59,7 +88,8 @@ LingotFilter* lingot_filter_cheby_design(unsigned int order, FLT Rp, FLT wc);
 
 void lingot_filter_destroy(LingotFilter*);
 
-// Digital Filter Implementation II, in & out overlapables. Vector filtering
+// Digital Filter Implementation II (as second order sections when possible),
+// in & out overlapables. Vector filtering
 void lingot_filter_filter(LingotFilter*, unsigned int n, const FLT* in,
 		FLT* out);
 
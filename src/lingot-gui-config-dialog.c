@@ -586,6 +586,10 @@ void lingot_gui_config_dialog_show(LingotMainFrame* frame, LingotConfig* config)
 		gtk_combo_box_text_append_text(dialog->input_system,
 				audio_system_t_to_str(AUDIO_SYSTEM_PULSEAUDIO));
 #endif
+		gtk_combo_box_text_append_text(dialog->input_system,
+				audio_system_t_to_str(AUDIO_SYSTEM_SYNTH));
+		gtk_combo_box_text_append_text(dialog->input_system,
+				audio_system_t_to_str(AUDIO_SYSTEM_FILE));
 
 		dialog->input_dev = GTK_COMBO_BOX_TEXT(
 				gtk_builder_get_object(builder, "input_dev"));
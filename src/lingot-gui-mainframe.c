@@ -193,7 +193,7 @@ gboolean lingot_gui_mainframe_callback_gauge_computation(gpointer data) {
 		frequency = 0.0;
 		lingot_gauge_compute(frame->gauge, frame->conf->gauge_rest_value);
 	} else {
-		FLT error_cents; // do not use, unfiltered
+		double error_cents; // do not use, unfiltered
 		frequency = lingot_filter_filter_sample(frame->freq_filter,
 				frame->core->freq);
 		closest_note_index = lingot_config_scale_get_closest_note_index(
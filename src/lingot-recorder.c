@@ -0,0 +1,269 @@
+/*
+ * lingot, a musical instrument tuner.
+ *
+ * Copyright (C) 2004-2013  Ibán Cereijo Graña.
+ * Copyright (C) 2004-2008  Jairo Chapela Martínez.
+
+ *
+ * This file is part of lingot.
+ *
+ * lingot is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * lingot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with lingot; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "lingot-recorder.h"
+#include "lingot-audio-format.h"
+#include "lingot-i18n.h"
+#include "lingot-msg.h"
+
+// the writer thread looks for queued blocks this often. The queue holds a
+// second of audio, so there is plenty of margin, and the audio thread does
+// not have to signal anything.
+static const long lingot_recorder_nap_ns = 50000000L;
+
+static void lingot_recorder_put(FILE* file, uint32_t value,
+		unsigned int bytes) {
+	unsigned int i;
+	for (i = 0; i < bytes; i++) {
+		fputc((value >> (8 * i)) & 0xFF, file);
+	}
+}
+
+// WAV header of a 32 bits float mono file with the given data size.
+static void lingot_recorder_write_header(LingotRecorder* recorder,
+		uint32_t data_size) {
+	FILE* file = recorder->file;
+
+	fwrite("RIFF", 1, 4, file);
+	lingot_recorder_put(file, 36 + data_size, 4);
+	fwrite("WAVEfmt ", 1, 8, file);
+	lingot_recorder_put(file, 16, 4);
+	lingot_recorder_put(file, 3, 2); // IEEE float
+	lingot_recorder_put(file, 1, 2);
+	lingot_recorder_put(file, recorder->sample_rate, 4);
+	lingot_recorder_put(file, recorder->sample_rate * sizeof(float), 4);
+	lingot_recorder_put(file, sizeof(float), 2);
+	lingot_recorder_put(file, 8 * sizeof(float), 2);
+	fwrite("data", 1, 4, file);
+	lingot_recorder_put(file, data_size, 4);
+}
+
+static void lingot_recorder_close_file(LingotRecorder* recorder) {
+	if (recorder->file != NULL) {
+		// the sizes are only known now, a file left unfinished is still
+		// readable with its sizes set to 0.
+		rewind(recorder->file);
+		lingot_recorder_write_header(recorder,
+				recorder->frames * sizeof(float));
+		fclose(recorder->file);
+		recorder->file = NULL;
+	}
+}
+
+static int lingot_recorder_open_file(LingotRecorder* recorder) {
+	char buff[1024];
+	size_t size = strlen(recorder->prefix) + 32;
+	char* name = malloc(size);
+
+	snprintf(name, size, "%s-%u.wav", recorder->prefix,
+			recorder->file_index % recorder->files);
+	recorder->file = fopen(name, "wb");
+	if (recorder->file == NULL) {
+		snprintf(buff, sizeof(buff), _("Cannot open recording file '%s'."),
+				name);
+		lingot_msg_add_error(buff);
+	} else {
+		lingot_recorder_write_header(recorder, 0);
+		recorder->file_index++;
+		recorder->frames = 0;
+	}
+
+	free(name);
+	return (recorder->file != NULL) ? 0 : -1;
+}
+
+// appends the samples to the recording, starting a new file whenever the
+// current one is complete.
+static void lingot_recorder_write(LingotRecorder* recorder, const float* in,
+		unsigned long n) {
+	unsigned long chunk;
+
+	while ((n > 0) && !recorder->write_error) {
+		if ((recorder->file == NULL)
+				&& (lingot_recorder_open_file(recorder) < 0)) {
+			recorder->write_error = 1;
+			break;
+		}
+
+		chunk = recorder->file_frames - recorder->frames;
+		if (chunk > n) {
+			chunk = n;
+		}
+
+		if (fwrite(in, sizeof(float), chunk, recorder->file) != chunk) {
+			lingot_msg_add_error(_("Cannot write the recording file."));
+			recorder->write_error = 1;
+			break;
+		}
+
+		recorder->frames += chunk;
+		recorder->frames_written += chunk;
+		in += chunk;
+		n -= chunk;
+
+		if (recorder->frames == recorder->file_frames) {
+			lingot_recorder_close_file(recorder);
+		}
+	}
+}
+
+// writes every queued block (consumer side).
+static void lingot_recorder_drain(LingotRecorder* recorder) {
+	const unsigned long head = __atomic_load_n(&recorder->head,
+			__ATOMIC_ACQUIRE);
+	const FLT* in;
+	unsigned int slot, n, i;
+
+	while (recorder->tail != head) {
+		slot = recorder->tail & (recorder->n_slots - 1);
+		in = recorder->slots + slot * recorder->slot_size;
+		n = recorder->slot_lengths[slot];
+		for (i = 0; i < n; i++) {
+			recorder->write_buffer[i] = in[i] / FLT_SAMPLE_SCALE;
+		}
+		// once converted, the slot can be reused.
+		__atomic_store_n(&recorder->tail, recorder->tail + 1,
+				__ATOMIC_RELEASE);
+		lingot_recorder_write(recorder, recorder->write_buffer, n);
+	}
+
+	if (recorder->file != NULL) {
+		fflush(recorder->file);
+	}
+}
+
+static void* lingot_recorder_run(void* arg) {
+	LingotRecorder* recorder = arg;
+	const struct timespec nap = { .tv_sec = 0, .tv_nsec =
+			lingot_recorder_nap_ns };
+	int running;
+
+	// the last pass writes everything pushed before the stop.
+	do {
+		running = __atomic_load_n(&recorder->running, __ATOMIC_ACQUIRE);
+		lingot_recorder_drain(recorder);
+		if (running) {
+			nanosleep(&nap, NULL);
+		}
+	} while (running);
+
+	return NULL;
+}
+
+LingotRecorder* lingot_recorder_new(const char* prefix,
+		unsigned int sample_rate, unsigned int block_size, double file_seconds,
+		unsigned int files) {
+
+	LingotRecorder* recorder = malloc(sizeof(LingotRecorder));
+
+	recorder->slot_size = block_size;
+	for (recorder->n_slots = 4;
+			recorder->n_slots * block_size < sample_rate;
+			recorder->n_slots <<= 1) {
+	}
+	recorder->slots = malloc(
+			recorder->n_slots * recorder->slot_size * sizeof(FLT));
+	recorder->slot_lengths = calloc(recorder->n_slots, sizeof(unsigned int));
+	recorder->head = 0;
+	recorder->tail = 0;
+	recorder->dropped_blocks = 0;
+
+	recorder->prefix = strdup(prefix);
+	recorder->sample_rate = sample_rate;
+	recorder->file_frames = (unsigned long) (file_seconds * sample_rate);
+	if (recorder->file_frames < 1) {
+		recorder->file_frames = 1;
+	}
+	recorder->files = (files > 0) ? files : 1;
+
+	recorder->write_buffer = malloc(recorder->slot_size * sizeof(float));
+	recorder->file = NULL;
+	recorder->file_index = 0;
+	recorder->frames = 0;
+	recorder->frames_written = 0;
+	recorder->write_error = 0;
+
+	recorder->running = 1;
+	if (pthread_create(&recorder->thread, NULL, lingot_recorder_run,
+			recorder)) {
+		lingot_msg_add_error(_("Cannot start the recorder."));
+		recorder->running = 0;
+		lingot_recorder_destroy(recorder);
+		recorder = NULL;
+	}
+
+	return recorder;
+}
+
+void lingot_recorder_destroy(LingotRecorder* recorder) {
+	if (recorder->running) {
+		__atomic_store_n(&recorder->running, 0, __ATOMIC_RELEASE);
+		pthread_join(recorder->thread, NULL);
+	}
+
+	lingot_recorder_close_file(recorder);
+
+	free(recorder->slots);
+	free(recorder->slot_lengths);
+	free(recorder->write_buffer);
+	free(recorder->prefix);
+	free(recorder);
+}
+
+void lingot_recorder_push(LingotRecorder* recorder, const FLT* samples,
+		unsigned int n) {
+	const unsigned long tail = __atomic_load_n(&recorder->tail,
+			__ATOMIC_ACQUIRE);
+	const unsigned int needed = (n + recorder->slot_size - 1)
+			/ recorder->slot_size;
+	unsigned long head = recorder->head;
+	unsigned int slot, len;
+
+	// blocks bigger than a slot take several of them, the block is queued
+	// whole or not at all, so the recording has no holes inside a block.
+	if (needed > recorder->n_slots - (head - tail)) {
+		__atomic_store_n(&recorder->dropped_blocks,
+				recorder->dropped_blocks + 1, __ATOMIC_RELAXED);
+		return;
+	}
+
+	for (; n > 0; samples += len, n -= len, head++) {
+		len = (n < recorder->slot_size) ? n : recorder->slot_size;
+		slot = head & (recorder->n_slots - 1);
+		memcpy(recorder->slots + slot * recorder->slot_size, samples,
+				len * sizeof(FLT));
+		recorder->slot_lengths[slot] = len;
+	}
+
+	__atomic_store_n(&recorder->head, head, __ATOMIC_RELEASE);
+}
+
+unsigned long lingot_recorder_get_dropped_blocks(LingotRecorder* recorder) {
+	return __atomic_load_n(&recorder->dropped_blocks, __ATOMIC_RELAXED);
+}
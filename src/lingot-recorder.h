@@ -0,0 +1,98 @@
+/*
+ * lingot, a musical instrument tuner.
+ *
+ * Copyright (C) 2004-2013  Ibán Cereijo Graña.
+ * Copyright (C) 2004-2008  Jairo Chapela Martínez.
+
+ *
+ * This file is part of lingot.
+ *
+ * lingot is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * lingot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with lingot; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef __LINGOT_RECORDER_H__
+#define __LINGOT_RECORDER_H__
+
+#include <stdio.h>
+#include <pthread.h>
+
+#include "lingot-defs.h"
+
+/*
+ Background recorder of the captured audio.
+
+ The audio thread pushes each block into a single-producer / single-consumer
+ lock-free queue of fixed slots, and never waits: if the queue is full the
+ block is dropped and counted. A writer thread drains the queue and writes
+ the samples as 32 bits float mono WAV files, which can be replayed with
+ the file audio system.
+
+ The recording is split in files of a given length, named
+ <prefix>-<n>.wav, and only the newest ones are kept: the file names are
+ reused in turn.
+ */
+
+typedef struct _LingotRecorder LingotRecorder;
+
+struct _LingotRecorder {
+
+	// queue of blocks, slot i holds slot_lengths[i] samples at
+	// slots + i * slot_size.
+	FLT* slots;
+	unsigned int* slot_lengths;
+	unsigned int slot_size;
+	unsigned int n_slots; // power of two
+	unsigned long head; // blocks pushed (producer only)
+	unsigned long tail; // blocks written (consumer only)
+
+	// blocks dropped because the queue was full (written by the producer,
+	// see lingot_recorder_get_dropped_blocks()).
+	unsigned long dropped_blocks;
+
+	char* prefix;
+	unsigned int sample_rate;
+	unsigned long file_frames; // frames per file
+	unsigned int files; // files kept
+
+	// writer state.
+	float* write_buffer; // a slot converted to the file format
+	FILE* file;
+	unsigned int file_index; // files started
+	unsigned long frames; // in the current file
+	unsigned long frames_written; // in total
+	int write_error;
+
+	pthread_t thread;
+	int running;
+};
+
+// creates a recorder for blocks of up to block_size samples, and starts
+// its writer thread. The queue holds about a second of audio.
+LingotRecorder* lingot_recorder_new(const char* prefix,
+		unsigned int sample_rate, unsigned int block_size, double file_seconds,
+		unsigned int files);
+
+// writes everything still queued, stops the writer thread and closes the
+// last file.
+void lingot_recorder_destroy(LingotRecorder*);
+
+// queues a block of n samples (producer side), it never blocks. If there is
+// no room for the whole block it is dropped.
+void lingot_recorder_push(LingotRecorder*, const FLT* samples, unsigned int n);
+
+// blocks dropped so far, it can be called from any thread.
+unsigned long lingot_recorder_get_dropped_blocks(LingotRecorder*);
+
+#endif
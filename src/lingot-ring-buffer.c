@@ -0,0 +1,198 @@
+/*
+ * lingot, a musical instrument tuner.
+ *
+ * Copyright (C) 2004-2013  Ibán Cereijo Graña.
+ * Copyright (C) 2004-2008  Jairo Chapela Martínez.
+
+ *
+ * This file is part of lingot.
+ *
+ * lingot is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * lingot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with lingot; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "lingot-ring-buffer.h"
+
+LingotRingBuffer* lingot_ring_buffer_new(unsigned int size) {
+
+	LingotRingBuffer* ring = malloc(sizeof(LingotRingBuffer));
+
+	ring->size = size;
+	ring->buffer = malloc(2 * size * sizeof(FLT));
+	lingot_ring_buffer_reset(ring);
+
+	return ring;
+}
+
+void lingot_ring_buffer_destroy(LingotRingBuffer* ring) {
+	free(ring->buffer);
+	free(ring);
+}
+
+void lingot_ring_buffer_reset(LingotRingBuffer* ring) {
+	memset(ring->buffer, 0, 2 * ring->size * sizeof(FLT));
+	ring->write_reserve = 0;
+	ring->write_count = 0;
+	ring->read_start = 0;
+	ring->collisions = 0;
+	ring->copies = 0;
+	ring->copied_bytes = 0;
+}
+
+// accounts a copy of n samples made by the producer. It is the only writer
+// of the statistics, but they may be read from other threads.
+static void lingot_ring_buffer_count_copy(LingotRingBuffer* ring,
+		unsigned int n) {
+	__atomic_store_n(&ring->copies, ring->copies + 1, __ATOMIC_RELAXED);
+	__atomic_store_n(&ring->copied_bytes, ring->copied_bytes + n * sizeof(FLT),
+			__ATOMIC_RELAXED);
+}
+
+// starts the append of the samples from the count-th on.
+static FLT* lingot_ring_buffer_reserve(LingotRingBuffer* ring,
+		unsigned long count, unsigned int n) {
+
+	unsigned long reserve = count + n;
+	unsigned long read_start;
+
+	// the region of a previous append may have been overwritten beyond the
+	// samples committed, so the reserve never goes back.
+	if (reserve < ring->write_reserve) {
+		reserve = ring->write_reserve;
+	}
+
+	// we announce the region we are about to overwrite before touching it,
+	// so the consumer can detect that its data has been modified.
+	__atomic_store_n(&ring->write_reserve, reserve, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	// statistics only: we don't wait, the consumer will retry.
+	read_start = __atomic_load_n(&ring->read_start, __ATOMIC_RELAXED);
+	if ((read_start != 0) && (count + n > read_start - 1 + ring->size)) {
+		__atomic_store_n(&ring->collisions, ring->collisions + 1,
+				__ATOMIC_RELAXED);
+	}
+
+	return &ring->buffer[count % ring->size];
+}
+
+// ends the append of the n samples from the count-th on.
+static void lingot_ring_buffer_commit(LingotRingBuffer* ring,
+		unsigned long count, unsigned int n) {
+
+	unsigned int position = count % ring->size;
+	unsigned int chunk = ring->size - position;
+
+	//
+	//  -----------------------------------------------
+	// | 0 1 2 ... size-1 | 0 1 2 ... size-1 (mirror)  |
+	//  -----------------------------------------------
+	//
+	// the samples have been written from position on, so we copy the ones
+	// in the first half to the mirror, and the ones that ran into the
+	// mirror back to the beginning.
+	if (chunk > n) {
+		chunk = n;
+	}
+	if (chunk > 0) {
+		memcpy(&ring->buffer[position + ring->size], &ring->buffer[position],
+				chunk * sizeof(FLT));
+		lingot_ring_buffer_count_copy(ring, chunk);
+	}
+	if (n > chunk) {
+		memcpy(&ring->buffer[0], &ring->buffer[ring->size],
+				(n - chunk) * sizeof(FLT));
+		lingot_ring_buffer_count_copy(ring, n - chunk);
+	}
+
+	__atomic_store_n(&ring->write_count, count + n, __ATOMIC_RELEASE);
+}
+
+void lingot_ring_buffer_write(LingotRingBuffer* ring, const FLT* in,
+		unsigned int n) {
+
+	unsigned long count = ring->write_count;
+	FLT* out;
+
+	if (n > ring->size) {
+		in += n - ring->size;
+		count += n - ring->size;
+		n = ring->size;
+	}
+
+	out = lingot_ring_buffer_reserve(ring, count, n);
+	memcpy(out, in, n * sizeof(FLT));
+	lingot_ring_buffer_count_copy(ring, n);
+	lingot_ring_buffer_commit(ring, count, n);
+}
+
+FLT* lingot_ring_buffer_write_begin(LingotRingBuffer* ring, unsigned int n) {
+	return lingot_ring_buffer_reserve(ring, ring->write_count, n);
+}
+
+void lingot_ring_buffer_write_commit(LingotRingBuffer* ring, unsigned int n) {
+	lingot_ring_buffer_commit(ring, ring->write_count, n);
+}
+
+const FLT* lingot_ring_buffer_peek(LingotRingBuffer* ring, unsigned int n,
+		unsigned long* sequence) {
+
+	*sequence = __atomic_load_n(&ring->write_count, __ATOMIC_ACQUIRE);
+	return lingot_ring_buffer_peek_at(ring, n, *sequence);
+}
+
+const FLT* lingot_ring_buffer_peek_at(LingotRingBuffer* ring, unsigned int n,
+		unsigned long sequence) {
+
+	__atomic_store_n(&ring->read_start, sequence - n + 1, __ATOMIC_RELAXED);
+
+	// the newest sample is the (sequence - 1)th, so the window starts at
+	// sequence - n, which is always contiguous thanks to the mirror.
+	return &ring->buffer[(sequence % ring->size) + ring->size - n];
+}
+
+int lingot_ring_buffer_validate(LingotRingBuffer* ring, unsigned int n,
+		unsigned long sequence) {
+
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	unsigned long reserve = __atomic_load_n(&ring->write_reserve,
+			__ATOMIC_RELAXED);
+	__atomic_store_n(&ring->read_start, 0, __ATOMIC_RELAXED);
+
+	// the oldest sample read is (sequence - n), and it is overwritten by the
+	// sample (sequence - n + size).
+	return (reserve - sequence) <= (ring->size - n);
+}
+
+unsigned int lingot_ring_buffer_read(LingotRingBuffer* ring, FLT* out,
+		unsigned int n) {
+
+	unsigned int retries = 0;
+	unsigned long sequence;
+	const FLT* window;
+
+	for (;;) {
+		window = lingot_ring_buffer_peek(ring, n, &sequence);
+		memcpy(out, window, n * sizeof(FLT));
+		if (lingot_ring_buffer_validate(ring, n, sequence)) {
+			break;
+		}
+		retries++;
+	}
+
+	return retries;
+}
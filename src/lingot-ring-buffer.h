@@ -0,0 +1,118 @@
+/*
+ * lingot, a musical instrument tuner.
+ *
+ * Copyright (C) 2004-2013  Ibán Cereijo Graña.
+ * Copyright (C) 2004-2008  Jairo Chapela Martínez.
+
+ *
+ * This file is part of lingot.
+ *
+ * lingot is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * lingot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with lingot; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef __LINGOT_RING_BUFFER_H__
+#define __LINGOT_RING_BUFFER_H__
+
+#include "lingot-defs.h"
+
+/*
+ Single-producer / single-consumer lock-free sample history.
+
+ The producer (audio thread) appends samples, overwriting the oldest ones,
+ and never waits for the consumer. The consumer (computation thread) reads
+ the newest samples through a contiguous pointer: every sample is stored
+ twice, at i and at i + size, so any window of up to 'size' samples is
+ contiguous in memory. Since the producer may overwrite the region while it
+ is being read, the consumer must validate each read afterwards with the
+ sequence counters (see lingot_ring_buffer_validate()).
+
+ A sequence number is the total amount of samples written when a read
+ starts, it identifies the newest sample of the window.
+ */
+
+typedef struct _LingotRingBuffer LingotRingBuffer;
+
+struct _LingotRingBuffer {
+
+	FLT* buffer; // mirrored storage, 2 * size samples.
+	unsigned int size; // capacity in samples.
+
+	// total number of samples whose writing has started (producer only).
+	unsigned long write_reserve;
+	// total number of samples completely written (producer only).
+	unsigned long write_count;
+
+	// oldest sample being read plus one, or 0 when there is no read in
+	// progress (written by the consumer, read by the producer). Always
+	// accessed with atomics.
+	unsigned long read_start;
+
+	// number of writes that overwrote the oldest sample of a read in
+	// progress, forcing the consumer to retry (written by the producer).
+	// Other threads must read it with __atomic_load_n().
+	unsigned long collisions;
+
+	// memory copies made by the producer, and bytes moved by them
+	// (statistics only, read them with __atomic_load_n() too).
+	unsigned long copies;
+	unsigned long copied_bytes;
+};
+
+LingotRingBuffer* lingot_ring_buffer_new(unsigned int size);
+void lingot_ring_buffer_destroy(LingotRingBuffer*);
+
+// discards all the samples (not thread safe, the producer must be stopped).
+void lingot_ring_buffer_reset(LingotRingBuffer*);
+
+// appends n samples (producer side), it never blocks. If n is bigger than
+// the capacity only the newest samples are kept.
+void lingot_ring_buffer_write(LingotRingBuffer*, const FLT* in, unsigned int n);
+
+// starts appending up to n samples (producer side), with n <= size, and
+// returns where they have to be written, so the producer can generate them
+// in place. The region is contiguous, it may run into the mirror half.
+// Everything in it may be overwritten, not only the samples committed, so
+// the readers see the whole region as modified until a later append covers
+// it.
+FLT* lingot_ring_buffer_write_begin(LingotRingBuffer*, unsigned int n);
+
+// ends the append started with lingot_ring_buffer_write_begin(), keeping
+// the first n samples of the region.
+void lingot_ring_buffer_write_commit(LingotRingBuffer*, unsigned int n);
+
+// returns a contiguous pointer to the newest n samples (consumer side), with
+// n <= size. The sequence number of the read is stored in 'sequence', to be
+// validated once the samples have been consumed.
+const FLT* lingot_ring_buffer_peek(LingotRingBuffer*, unsigned int n,
+		unsigned long* sequence);
+
+// returns a contiguous pointer to the n samples ending at the given sequence
+// number, which must come from a previous read. They may have been
+// overwritten already, so the read must be validated too.
+const FLT* lingot_ring_buffer_peek_at(LingotRingBuffer*, unsigned int n,
+		unsigned long sequence);
+
+// tells whether the n samples obtained with lingot_ring_buffer_peek() with
+// the given sequence number have been left untouched by the producer, and
+// ends the read.
+int lingot_ring_buffer_validate(LingotRingBuffer*, unsigned int n,
+		unsigned long sequence);
+
+// copies the newest n samples to out, retrying while the producer overwrites
+// them. Returns the number of retries.
+unsigned int lingot_ring_buffer_read(LingotRingBuffer*, FLT* out,
+		unsigned int n);
+
+#endif /*__LINGOT_RING_BUFFER_H__*/
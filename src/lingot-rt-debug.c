@@ -0,0 +1,171 @@
+/*
+ * lingot, a musical instrument tuner.
+ *
+ * Copyright (C) 2004-2013  Ibán Cereijo Graña.
+ * Copyright (C) 2004-2008  Jairo Chapela Martínez.
+
+ *
+ * This file is part of lingot.
+ *
+ * lingot is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * lingot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with lingot; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "lingot-rt-debug.h"
+
+#ifdef LINGOT_RT_DEBUG
+
+#define _GNU_SOURCE
+#include <dlfcn.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+typedef enum {
+	RT_CALL_MALLOC,
+	RT_CALL_CALLOC,
+	RT_CALL_REALLOC,
+	RT_CALL_FREE,
+	RT_CALL_MUTEX_LOCK,
+	RT_CALL_COND_WAIT,
+	RT_CALL_COND_TIMEDWAIT,
+	RT_CALL_NANOSLEEP,
+	RT_CALL_USLEEP,
+	RT_CALLS
+} lingot_rt_call_t;
+
+static const char* lingot_rt_call_names[RT_CALLS] = { "malloc", "calloc",
+		"realloc", "free", "pthread_mutex_lock", "pthread_cond_wait",
+		"pthread_cond_timedwait", "nanosleep", "usleep" };
+
+static unsigned long lingot_rt_call_counters[RT_CALLS];
+
+// depth of realtime sections of the current thread.
+static __thread int lingot_rt_section = 0;
+
+// the allocator has its own entry points in glibc, so it doesn't need
+// dlsym(), which allocates.
+extern void* __libc_malloc(size_t);
+extern void* __libc_calloc(size_t, size_t);
+extern void* __libc_realloc(void*, size_t);
+extern void __libc_free(void*);
+
+static int (*lingot_rt_mutex_lock)(pthread_mutex_t*);
+static int (*lingot_rt_cond_wait)(pthread_cond_t*, pthread_mutex_t*);
+static int (*lingot_rt_cond_timedwait)(pthread_cond_t*, pthread_mutex_t*,
+		const struct timespec*);
+static int (*lingot_rt_nanosleep)(const struct timespec*, struct timespec*);
+static int (*lingot_rt_usleep)(useconds_t);
+
+// resolved before any realtime thread exists, so they never call dlsym().
+static void __attribute__((constructor)) lingot_rt_debug_init() {
+	lingot_rt_mutex_lock = dlsym(RTLD_NEXT, "pthread_mutex_lock");
+	lingot_rt_cond_wait = dlsym(RTLD_NEXT, "pthread_cond_wait");
+	lingot_rt_cond_timedwait = dlsym(RTLD_NEXT, "pthread_cond_timedwait");
+	lingot_rt_nanosleep = dlsym(RTLD_NEXT, "nanosleep");
+	lingot_rt_usleep = dlsym(RTLD_NEXT, "usleep");
+}
+
+static inline void lingot_rt_debug_check(lingot_rt_call_t call) {
+	if (lingot_rt_section > 0) {
+		__atomic_add_fetch(&lingot_rt_call_counters[call], 1,
+				__ATOMIC_RELAXED);
+	}
+}
+
+void lingot_rt_debug_enter() {
+	lingot_rt_section++;
+}
+
+void lingot_rt_debug_leave() {
+	lingot_rt_section--;
+}
+
+unsigned long lingot_rt_debug_get_violations() {
+	unsigned long result = 0;
+	int i;
+
+	for (i = 0; i < RT_CALLS; i++) {
+		result += __atomic_load_n(&lingot_rt_call_counters[i],
+				__ATOMIC_RELAXED);
+	}
+	return result;
+}
+
+void lingot_rt_debug_report() {
+	unsigned long n;
+	int i;
+
+	for (i = 0; i < RT_CALLS; i++) {
+		n = __atomic_load_n(&lingot_rt_call_counters[i], __ATOMIC_RELAXED);
+		if (n > 0) {
+			fprintf(stderr, "warning: %lu calls to %s from a realtime thread\n",
+					n, lingot_rt_call_names[i]);
+		}
+	}
+}
+
+/*
+ Interposed functions.
+ */
+
+void* malloc(size_t size) {
+	lingot_rt_debug_check(RT_CALL_MALLOC);
+	return __libc_malloc(size);
+}
+
+void* calloc(size_t n, size_t size) {
+	lingot_rt_debug_check(RT_CALL_CALLOC);
+	return __libc_calloc(n, size);
+}
+
+void* realloc(void* p, size_t size) {
+	lingot_rt_debug_check(RT_CALL_REALLOC);
+	return __libc_realloc(p, size);
+}
+
+void free(void* p) {
+	lingot_rt_debug_check(RT_CALL_FREE);
+	__libc_free(p);
+}
+
+int pthread_mutex_lock(pthread_mutex_t* mutex) {
+	lingot_rt_debug_check(RT_CALL_MUTEX_LOCK);
+	return lingot_rt_mutex_lock(mutex);
+}
+
+int pthread_cond_wait(pthread_cond_t* cond, pthread_mutex_t* mutex) {
+	lingot_rt_debug_check(RT_CALL_COND_WAIT);
+	return lingot_rt_cond_wait(cond, mutex);
+}
+
+int pthread_cond_timedwait(pthread_cond_t* cond, pthread_mutex_t* mutex,
+		const struct timespec* abstime) {
+	lingot_rt_debug_check(RT_CALL_COND_TIMEDWAIT);
+	return lingot_rt_cond_timedwait(cond, mutex, abstime);
+}
+
+int nanosleep(const struct timespec* req, struct timespec* rem) {
+	lingot_rt_debug_check(RT_CALL_NANOSLEEP);
+	return lingot_rt_nanosleep(req, rem);
+}
+
+int usleep(useconds_t usec) {
+	lingot_rt_debug_check(RT_CALL_USLEEP);
+	return lingot_rt_usleep(usec);
+}
+
+#endif
@@ -0,0 +1,58 @@
+/*
+ * lingot, a musical instrument tuner.
+ *
+ * Copyright (C) 2004-2013  Ibán Cereijo Graña.
+ * Copyright (C) 2004-2008  Jairo Chapela Martínez.
+
+ *
+ * This file is part of lingot.
+ *
+ * lingot is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * lingot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with lingot; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef __LINGOT_RT_DEBUG_H__
+#define __LINGOT_RT_DEBUG_H__
+
+/*
+ Detection of blocking calls from realtime threads.
+
+ When built with LINGOT_RT_DEBUG, the memory allocation, mutex, condition
+ variable and sleep functions are interposed, and every call made from a
+ thread inside a realtime section is counted. Otherwise the sections are
+ no-ops.
+ */
+
+#ifdef LINGOT_RT_DEBUG
+
+// marks the beginning and the end of the code run by a realtime thread.
+void lingot_rt_debug_enter();
+void lingot_rt_debug_leave();
+
+// number of blocking calls made from realtime sections so far.
+unsigned long lingot_rt_debug_get_violations();
+
+// prints the blocking calls made from realtime sections, by function.
+void lingot_rt_debug_report();
+
+#else
+
+#define lingot_rt_debug_enter()
+#define lingot_rt_debug_leave()
+#define lingot_rt_debug_get_violations() 0UL
+#define lingot_rt_debug_report()
+
+#endif
+
+#endif //__LINGOT_RT_DEBUG_H__
@@ -321,21 +321,21 @@ FLT lingot_signal_estimate_fundamental_frequency(const FLT* snr, FLT freq,
 void lingot_signal_compute_noise_level(const FLT* spd, int N, int cbuffer_size,
 		FLT* noise_level) {
 
-// low pass IIR filter.
+	// low pass IIR filter, y[n] = c x[n] + (1 - c) y[n - 1]. It starts from
+	// rest on every call, so there is no state to keep between calls, nor
+	// to share between cores.
 	const FLT c = 0.1;
-	const FLT filter_a[] = { 1.0, c - 1.0 };
-	const FLT filter_b[] = { c };
-	static LingotFilter* filter = 0x0;
+	FLT y = 0.0;
+	int i;
 
-	if (filter == 0x0) {
-		filter = lingot_filter_new(1, 0, filter_a, filter_b);
+	// warm up with the first samples.
+	for (i = 0; i < cbuffer_size; i++) {
+		y = c * spd[i] + (1.0 - c) * y;
 	}
 
-	lingot_filter_reset(filter);
-
-	lingot_filter_filter(filter, cbuffer_size, spd, noise_level);
-	lingot_filter_filter(filter, N, spd, noise_level);
-
+	for (i = 0; i < N; i++) {
+		noise_level[i] = y = c * spd[i] + (1.0 - c) * y;
+	}
 }
 
 //---------------------------------------------------------------------------
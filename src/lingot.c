@@ -32,6 +32,7 @@
 
 #include "lingot-defs.h"
 #include "lingot-config.h"
+#include "lingot-fft.h"
 #include "lingot-gui-mainframe.h"
 #include "lingot-i18n.h"
 
@@ -112,6 +113,7 @@ int main(int argc, char *argv[]) {
 	}
 
 	lingot_gui_mainframe_create(argc, argv);
+	lingot_fft_cleanup();
 
 	return 0;
 }
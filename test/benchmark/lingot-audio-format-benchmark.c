@@ -0,0 +1,57 @@
+/*
+ * lingot, a musical instrument tuner.
+ *
+ * Copyright (C) 2013  Ibán Cereijo Graña
+ *
+ * This file is part of lingot.
+ *
+ * lingot is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * lingot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with lingot; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <stdlib.h>
+
+#include "lingot-benchmark.h"
+
+#include "lingot-audio-format.h"
+
+// nanoseconds per sample converting a mono block of each format.
+int lingot_audio_format_benchmark() {
+
+	const unsigned int n = 4096;
+	const unsigned int rounds = 2000;
+	static const char* names[] = { "S16", "S24_3LE", "S32", "FLOAT32",
+			"FLOAT64" };
+	void* raw = calloc(n, 8);
+	FLT* out = malloc(n * sizeof(FLT));
+	double t0;
+	unsigned int i;
+	int format;
+
+	printf("sample format conversion, ns per sample\n");
+	for (format = SAMPLE_FORMAT_S16; format <= SAMPLE_FORMAT_FLOAT64;
+			format++) {
+		t0 = lingot_benchmark_time();
+		for (i = 0; i < rounds; i++) {
+			lingot_audio_format_convert(format, raw, 1, 0, n, out);
+		}
+		printf("%8s: %.3f\n", names[format],
+				1e9 * (lingot_benchmark_time() - t0) / (rounds * n));
+	}
+	printf("\n");
+
+	free(raw);
+	free(out);
+	return 0;
+}
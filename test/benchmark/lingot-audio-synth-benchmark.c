@@ -0,0 +1,71 @@
+/*
+ * lingot, a musical instrument tuner.
+ *
+ * Copyright (C) 2013  Ibán Cereijo Graña
+ *
+ * This file is part of lingot.
+ *
+ * lingot is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * lingot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with lingot; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <unistd.h>
+
+#include "lingot-benchmark.h"
+
+#include "lingot-audio.h"
+
+static void lingot_audio_synth_benchmark_callback(FLT* read_buffer,
+		int read_buffer_size_samples, void *arg) {
+}
+
+// pacing of the synthesizer on the real clock: 20 periods of 10 ms take
+// 200 ms, and a reader stalled for 100 ms is late by about 9 periods.
+int lingot_audio_synth_benchmark() {
+
+	LingotAudioHandler* audio = lingot_audio_new(AUDIO_SYSTEM_SYNTH,
+			"default", 44100, 441, 0, lingot_audio_synth_benchmark_callback,
+			NULL);
+	double t0, elapsed;
+	unsigned long late;
+	int i, result = 0;
+
+	if (audio == NULL) {
+		printf("synthesizer pacing: cannot open the synthesizer\n\n");
+		return 1;
+	}
+
+	t0 = lingot_benchmark_time();
+	for (i = 0; i < 20; i++) {
+		lingot_audio_read(audio);
+	}
+	elapsed = lingot_benchmark_time() - t0;
+
+	usleep(100000);
+	lingot_audio_read(audio);
+	late = audio->late_periods;
+
+	printf("synthesizer pacing: 20 periods of 10 ms in %.1f ms, "
+			"%lu periods late after a stall of 100 ms\n", 1e3 * elapsed,
+			late);
+	if ((elapsed < 0.19) || (elapsed > 0.4) || (late < 7) || (late > 12)
+			|| audio->overruns || audio->lost_frames) {
+		printf("target MISSED\n");
+		result = 1;
+	}
+	printf("\n");
+
+	lingot_audio_destroy(audio);
+	return result;
+}
@@ -0,0 +1,67 @@
+/*
+ * lingot, a musical instrument tuner.
+ *
+ * Copyright (C) 2013  Ibán Cereijo Graña
+ *
+ * This file is part of lingot.
+ *
+ * lingot is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * lingot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with lingot; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+// performance benchmarks, one program apart from the unit tests. Each one
+// returns non-zero if it misses its target.
+int lingot_decimator_benchmark();
+int lingot_engine_benchmark();
+int lingot_audio_format_benchmark();
+int lingot_audio_synth_benchmark();
+int lingot_core_benchmark();
+
+// TODO: lib?
+#include "lingot-complex.c"
+#include "lingot-msg.c"
+#include "lingot-config-scale.c"
+#include "lingot-config.c"
+#include "lingot-audio.c"
+#include "lingot-audio-alsa.c"
+#include "lingot-audio-oss.c"
+#include "lingot-audio-jack.c"
+#include "lingot-audio-pulseaudio.c"
+#include "lingot-fft.c"
+#include "lingot-core.c"
+#include "lingot-signal.c"
+#include "lingot-filter.c"
+#include "lingot-recorder.c"
+#include "lingot-audio-file.c"
+#include "lingot-audio-synth.c"
+#include "lingot-audio-format.c"
+#include "lingot-rt-debug.c"
+#include "lingot-engine.c"
+#include "lingot-decimator.c"
+#include "lingot-ring-buffer.c"
+
+#include <stdio.h>
+
+int main(void) {
+
+	int result = 0;
+
+	result |= lingot_decimator_benchmark();
+	result |= lingot_engine_benchmark();
+	result |= lingot_audio_format_benchmark();
+	result |= lingot_audio_synth_benchmark();
+	result |= lingot_core_benchmark();
+
+	return result;
+}
@@ -0,0 +1,68 @@
+/*
+ * lingot, a musical instrument tuner.
+ *
+ * Copyright (C) 2013  Ibán Cereijo Graña
+ *
+ * This file is part of lingot.
+ *
+ * lingot is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * lingot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with lingot; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <string.h>
+#include <unistd.h>
+
+#include "lingot-benchmark.h"
+
+#include "lingot-config.h"
+#include "lingot-core.h"
+
+// time to stop a core whose analysis is waiting for a hop that doesn't
+// come. It must be woken up, well before the 250 ms of its timeout.
+int lingot_core_benchmark() {
+
+	LingotConfig* conf = lingot_config_new();
+	LingotCore* core;
+	double t0, elapsed;
+	int result = 0;
+
+	lingot_config_restore_default_values(conf);
+	conf->audio_system = AUDIO_SYSTEM_SYNTH;
+	strcpy(conf->audio_dev[AUDIO_SYSTEM_SYNTH], "level=-200");
+	conf->noise_gate = -60.0;
+	core = lingot_core_new(conf);
+	if (core->audio == NULL) {
+		printf("core stop: cannot open the synthesizer\n\n");
+		lingot_core_destroy(core);
+		lingot_config_destroy(conf);
+		return 1;
+	}
+
+	lingot_core_start(core);
+	usleep(100000);
+	t0 = lingot_benchmark_time();
+	lingot_core_stop(core);
+	elapsed = lingot_benchmark_time() - t0;
+
+	printf("core stop: %.1f ms\n", 1e3 * elapsed);
+	if (elapsed >= 0.15) {
+		printf("target MISSED\n");
+		result = 1;
+	}
+	printf("\n");
+
+	lingot_core_destroy(core);
+	lingot_config_destroy(conf);
+	return result;
+}
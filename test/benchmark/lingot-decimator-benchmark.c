@@ -0,0 +1,85 @@
+/*
+ * lingot, a musical instrument tuner.
+ *
+ * Copyright (C) 2013  Ibán Cereijo Graña
+ *
+ * This file is part of lingot.
+ *
+ * lingot is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * lingot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with lingot; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <math.h>
+#include <time.h>
+
+#include "lingot-benchmark.h"
+
+#include "lingot-decimator.h"
+
+// time stamp in CPU cycles where available, in nanoseconds otherwise.
+static unsigned long long lingot_decimator_benchmark_cycles() {
+#if defined(__i386__) || defined(__x86_64__)
+	return __builtin_ia32_rdtsc();
+#else
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec * 1000000000ULL + t.tv_nsec;
+#endif
+}
+
+// cycles per input sample of each decimator at the usual sample rates, with
+// the oversampling factors that the default configuration yields.
+int lingot_decimator_benchmark() {
+
+	const unsigned int sample_rates[] = { 44100, 96000, 192000 };
+	const unsigned int block_size = 1024;
+	const unsigned int blocks = 2000;
+	const FLT internal_max_frequency = 3.1 * 329.6276;
+	FLT in[block_size];
+	FLT out[block_size];
+	unsigned long long t0, best;
+	unsigned int i, j, factor;
+	int type;
+
+	for (i = 0; i < block_size; i++) {
+		in[i] = cos(0.01 * i) + 0.5 * cos(0.3 * i);
+	}
+
+	printf("decimation, cycles per input sample\n");
+	printf("%10s %8s %10s %10s %10s\n", "rate", "factor", "IIR", "FIR",
+			"MULTISTAGE");
+	for (i = 0; i < sizeof(sample_rates) / sizeof(sample_rates[0]); i++) {
+		factor = floor(0.5 * sample_rates[i] / internal_max_frequency);
+		printf("%10u %8u", sample_rates[i], factor);
+		for (type = DECIMATION_FILTER_IIR;
+				type <= DECIMATION_FILTER_MULTISTAGE; type++) {
+			LingotDecimator* decimator = lingot_decimator_new(type, factor);
+			best = ~0ULL;
+			for (j = 0; j < blocks; j++) {
+				t0 = lingot_decimator_benchmark_cycles();
+				lingot_decimator_decimate(decimator, in, block_size, out);
+				t0 = lingot_decimator_benchmark_cycles() - t0;
+				if (t0 < best) {
+					best = t0;
+				}
+			}
+			printf(" %10.2f", (double) best / block_size);
+			lingot_decimator_destroy(decimator);
+		}
+		printf("\n");
+	}
+	printf("\n");
+
+	return 0;
+}
@@ -0,0 +1,121 @@
+/*
+ * lingot, a musical instrument tuner.
+ *
+ * Copyright (C) 2013  Ibán Cereijo Graña
+ *
+ * This file is part of lingot.
+ *
+ * lingot is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * lingot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with lingot; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <math.h>
+
+#include "lingot-benchmark.h"
+
+#include "lingot-config.h"
+#include "lingot-engine.h"
+
+// the engine target: 64 streams at 48 kHz in real time on 8 cores.
+#define LINGOT_ENGINE_BENCHMARK_STREAMS 64
+#define LINGOT_ENGINE_BENCHMARK_RATE 48000
+#define LINGOT_ENGINE_BENCHMARK_CPUS 8
+
+// one second of a tone of a different frequency in each stream, interleaved.
+static FLT* lingot_engine_benchmark_signal(unsigned int n_streams,
+		const double* f, unsigned int sample_rate) {
+	FLT* signal = malloc(sample_rate * n_streams * sizeof(FLT));
+	unsigned int i, j;
+
+	for (j = 0; j < sample_rate; j++) {
+		for (i = 0; i < n_streams; i++) {
+			signal[j * n_streams + i] = FLT_SAMPLE_SCALE * 0.5
+					* cos(2.0 * M_PI * f[i] * j / sample_rate);
+		}
+	}
+
+	return signal;
+}
+
+// time per second of audio of the target streams, with 1 worker and with
+// one worker per target core. The target is met if writing one second of
+// audio and computing the rounds that fall in it take less than a second.
+int lingot_engine_benchmark() {
+
+	const unsigned int n_streams = LINGOT_ENGINE_BENCHMARK_STREAMS;
+	const unsigned int block_size = 480; // 10 ms
+	const unsigned int n_rounds = 30;
+	const unsigned int n_workers[] = { 1, LINGOT_ENGINE_BENCHMARK_CPUS };
+	const long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	const unsigned int rate = LINGOT_ENGINE_BENCHMARK_RATE;
+	double f[n_streams];
+	FLT* signal;
+	double t0, t_write, t_compute, load = 0.0;
+	unsigned int i, j;
+	int result = 0;
+
+	LingotConfig* conf = lingot_config_new();
+	lingot_config_restore_default_values(conf);
+	conf->sample_rate = rate;
+	lingot_config_update_internal_params(conf);
+
+	for (i = 0; i < n_streams; i++) {
+		f[i] = 82.407 * pow(2.0, (i % 24) / 12.0);
+	}
+	signal = lingot_engine_benchmark_signal(n_streams, f, rate);
+
+	printf("engine, %u streams at %u Hz\n", n_streams, rate);
+	for (j = 0; j < sizeof(n_workers) / sizeof(n_workers[0]); j++) {
+		LingotEngine* engine = lingot_engine_new(conf, n_streams, block_size,
+				n_workers[j]);
+
+		t0 = lingot_benchmark_time();
+		for (i = 0; i + block_size <= rate; i += block_size) {
+			lingot_engine_write(engine, signal + i * n_streams, block_size);
+		}
+		t_write = lingot_benchmark_time() - t0;
+
+		t0 = lingot_benchmark_time();
+		for (i = 0; i < n_rounds; i++) {
+			lingot_engine_compute(engine);
+		}
+		t_compute = (lingot_benchmark_time() - t0) / n_rounds;
+
+		load = t_write + t_compute * conf->calculation_rate;
+		printf("%u workers: write %.1f ms per second of audio, "
+				"compute %.2f ms per round, load %.1f%%\n", engine->n_workers,
+				1e3 * t_write, 1e3 * t_compute, 100.0 * load);
+
+		lingot_engine_destroy(engine);
+	}
+
+	// the last measurement is the one with the target workers, meaningless
+	// if they have to share fewer cores.
+	if (cpus < LINGOT_ENGINE_BENCHMARK_CPUS) {
+		printf("target not checked, %ld CPUs available of %u\n", cpus,
+				LINGOT_ENGINE_BENCHMARK_CPUS);
+	} else if (load < 1.0) {
+		printf("target met\n");
+	} else {
+		printf("target MISSED\n");
+		result = 1;
+	}
+	printf("\n");
+
+	free(signal);
+	lingot_config_destroy(conf);
+	return result;
+}
@@ -0,0 +1,107 @@
+/*
+ * lingot, a musical instrument tuner.
+ *
+ * Copyright (C) 2013  Ibán Cereijo Graña
+ *
+ * This file is part of lingot.
+ *
+ * lingot is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * lingot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with lingot; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <math.h>
+#include "lingot-test.h"
+
+#include "lingot-audio.h"
+#include "lingot-core.h"
+
+static void lingot_accuracy_test_callback(FLT* read_buffer,
+		int read_buffer_size_samples, void *arg) {
+}
+
+// frequency estimated by a core fed with the given synthesized tone for
+// the given time, analyzing it at the configured rate.
+static double lingot_accuracy_test_estimate(LingotConfig* conf, double f,
+		double duration) {
+	const int period_size = 512;
+	const int blocks_per_analysis = conf->sample_rate
+			/ (period_size * conf->calculation_rate);
+	char device[256];
+	LingotAudioHandler* audio;
+	LingotCore* core;
+	double freq;
+	int i;
+
+	// out of tune to fall between FFT bins, with a second harmonic and
+	// some noise.
+	snprintf(device, sizeof(device), "freq=%.6f,harmonics=2,noise=-60,"
+			"pace=fast", f);
+	audio = lingot_audio_new(AUDIO_SYSTEM_SYNTH, device, conf->sample_rate,
+			period_size, 0, lingot_accuracy_test_callback, NULL);
+	CU_ASSERT_PTR_NOT_NULL(audio);
+	if (audio == NULL) {
+		return 0.0;
+	}
+	core = lingot_core_new_stream(conf, period_size);
+
+	for (i = 0; i < duration * conf->sample_rate / period_size; i++) {
+		lingot_audio_read(audio);
+		lingot_core_read_callback(audio->flt_read_buffer, period_size, core);
+		if ((i + 1) % blocks_per_analysis == 0) {
+			lingot_core_compute_fundamental_fequency(core);
+		}
+	}
+
+	freq = core->freq;
+	lingot_core_destroy(core);
+	lingot_audio_destroy(audio);
+	return freq;
+}
+
+void lingot_accuracy_test() {
+
+	LingotConfig* conf = lingot_config_new();
+	double f, error_cents;
+	int note;
+
+	lingot_config_restore_default_values(conf);
+
+	// the whole default range, from E2 to E4, in the configured temporal
+	// window and FFT size.
+	for (note = -29; note <= -5; note++) {
+		f = 440.0 * pow(2.0, (note + 0.13) / 12.0);
+		error_cents = 1200.0
+				* log2(lingot_accuracy_test_estimate(conf, f, 1.0) / f);
+		CU_ASSERT(fabs(error_cents) < 0.2);
+	}
+
+	// a wider range, from C1 to A5.
+	conf->min_frequency = 30.0;
+	conf->max_frequency = 900.0;
+	lingot_config_update_internal_params(conf);
+	for (note = -45; note <= 12; note++) {
+		f = 440.0 * pow(2.0, (note + 0.13) / 12.0);
+		error_cents = 1200.0
+				* log2(lingot_accuracy_test_estimate(conf, f, 1.0) / f);
+
+		// the temporal window holds only a few periods of the lowest notes.
+		if (note < -33) {
+			CU_ASSERT(fabs(error_cents) < 1.0);
+		} else {
+			CU_ASSERT(fabs(error_cents) < 0.2);
+		}
+	}
+
+	lingot_config_destroy(conf);
+}
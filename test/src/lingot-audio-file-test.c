@@ -0,0 +1,223 @@
+/*
+ * lingot, a musical instrument tuner.
+ *
+ * Copyright (C) 2013  Ibán Cereijo Graña
+ *
+ * This file is part of lingot.
+ *
+ * lingot is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * lingot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with lingot; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <math.h>
+
+#include "lingot-test.h"
+
+#include "lingot-audio.h"
+#include "lingot-audio-file.h"
+#include "lingot-config.h"
+
+#define LINGOT_AUDIO_FILE_TEST_FRAMES 1000
+
+static void lingot_audio_file_test_callback(FLT* read_buffer,
+		int read_buffer_size_samples, void *arg) {
+}
+
+static LingotAudioHandler* lingot_audio_file_test_new(const char* path,
+		const char* options) {
+	char device[512];
+	snprintf(device, sizeof(device), "%s%s", path, options);
+	return lingot_audio_new(AUDIO_SYSTEM_FILE, device, 44100, 256, 0,
+			lingot_audio_file_test_callback, NULL);
+}
+
+static void lingot_audio_file_test_put(FILE* fid, uint32_t value,
+		unsigned int bytes) {
+	unsigned int i;
+	for (i = 0; i < bytes; i++) {
+		fputc((value >> (8 * i)) & 0xFF, fid);
+	}
+}
+
+// writes a WAV file with the given sample format, the value of sample i in
+// channel c is i + c, or its negation in odd frames.
+static void lingot_audio_file_test_write_wav(const char* path,
+		unsigned int tag, unsigned int bits, unsigned int channels,
+		unsigned int rate, uint32_t data_size) {
+	FILE* fid = fopen(path, "wb");
+	const unsigned int frame_size = channels * bits / 8;
+	unsigned int i, c;
+	float f;
+	int16_t s;
+
+	fwrite("RIFF", 1, 4, fid);
+	lingot_audio_file_test_put(fid, 0, 4);
+	fwrite("WAVE", 1, 4, fid);
+	// a chunk we do not know about, with an odd size.
+	fwrite("LIST", 1, 4, fid);
+	lingot_audio_file_test_put(fid, 3, 4);
+	fwrite("abc\0", 1, 4, fid);
+	fwrite("fmt ", 1, 4, fid);
+	lingot_audio_file_test_put(fid, 16, 4);
+	lingot_audio_file_test_put(fid, tag, 2);
+	lingot_audio_file_test_put(fid, channels, 2);
+	lingot_audio_file_test_put(fid, rate, 4);
+	lingot_audio_file_test_put(fid, rate * frame_size, 4);
+	lingot_audio_file_test_put(fid, frame_size, 2);
+	lingot_audio_file_test_put(fid, bits, 2);
+	fwrite("data", 1, 4, fid);
+	lingot_audio_file_test_put(fid, data_size, 4);
+	for (i = 0; i < LINGOT_AUDIO_FILE_TEST_FRAMES; i++) {
+		for (c = 0; c < channels; c++) {
+			s = (i & 1) ? -(int) (i + c) : (int) (i + c);
+			if (tag == 3) {
+				f = s / 32767.0;
+				fwrite(&f, sizeof(f), 1, fid);
+			} else {
+				fwrite(&s, sizeof(s), 1, fid);
+			}
+		}
+	}
+	fclose(fid);
+}
+
+static int lingot_audio_file_test_check(LingotAudioHandler* audio,
+		unsigned long first, int n) {
+	int i, errors = 0;
+	unsigned long frame;
+	double expected;
+
+	for (i = 0; i < n; i++) {
+		frame = (first + i) % LINGOT_AUDIO_FILE_TEST_FRAMES;
+		expected = (frame & 1) ? -(double) frame : (double) frame;
+		errors += fabs(audio->flt_read_buffer[i] - expected) > 1e-2;
+	}
+
+	return errors;
+}
+
+void lingot_audio_file_test() {
+
+	// with a space, as file names can have them.
+	char path[] = "/tmp/lingot audio-file-test-XXXXXX";
+	char conf_path[] = "/tmp/lingot-audio-file-test-conf-XXXXXX";
+	char device[512];
+	LingotAudioHandler* audio;
+	LingotConfig* conf;
+	FILE* fid;
+	double f[2];
+	int fd, i;
+
+	fd = mkstemp(path);
+	CU_ASSERT_FATAL(fd >= 0);
+	close(fd);
+
+	// 16 bits WAV, read to the end.
+	lingot_audio_file_test_write_wav(path, 1, 16, 1, 8000,
+			2 * LINGOT_AUDIO_FILE_TEST_FRAMES);
+	audio = lingot_audio_file_test_new(path, ",pace=fast");
+	CU_ASSERT_PTR_NOT_NULL_FATAL(audio);
+	CU_ASSERT_EQUAL(audio->real_sample_rate, 8000);
+	CU_ASSERT_EQUAL(audio->file->frames, LINGOT_AUDIO_FILE_TEST_FRAMES);
+	for (i = 0; i < 3; i++) {
+		CU_ASSERT_EQUAL(lingot_audio_read(audio), 256);
+		CU_ASSERT_EQUAL(lingot_audio_file_test_check(audio, 256 * i, 256), 0);
+	}
+	CU_ASSERT_EQUAL(lingot_audio_read(audio), 232);
+	CU_ASSERT_EQUAL(lingot_audio_file_test_check(audio, 768, 232), 0);
+	CU_ASSERT_EQUAL(lingot_audio_read(audio), -1);
+	lingot_audio_destroy(audio);
+
+	// looping, the periods are always whole.
+	audio = lingot_audio_file_test_new(path, ",pace=fast,loop");
+	CU_ASSERT_PTR_NOT_NULL_FATAL(audio);
+	for (i = 0; i < 10; i++) {
+		CU_ASSERT_EQUAL(lingot_audio_read(audio), 256);
+		CU_ASSERT_EQUAL(lingot_audio_file_test_check(audio, 256 * i, 256), 0);
+	}
+	lingot_audio_destroy(audio);
+
+	// the path and the options survive saving and loading the configuration.
+	fd = mkstemp(conf_path);
+	CU_ASSERT_FATAL(fd >= 0);
+	close(fd);
+	snprintf(device, sizeof(device), "%s,pace=fast,loop", path);
+	lingot_config_create_parameter_specs();
+	conf = lingot_config_new();
+	lingot_config_restore_default_values(conf);
+	strcpy(conf->audio_dev[AUDIO_SYSTEM_FILE], device);
+	lingot_config_save(conf, conf_path);
+	strcpy(conf->audio_dev[AUDIO_SYSTEM_FILE], "");
+	lingot_config_load(conf, conf_path);
+	CU_ASSERT(!strcmp(conf->audio_dev[AUDIO_SYSTEM_FILE], device));
+	audio = lingot_audio_file_test_new(conf->audio_dev[AUDIO_SYSTEM_FILE], "");
+	CU_ASSERT_PTR_NOT_NULL(audio);
+	if (audio != NULL) {
+		CU_ASSERT(audio->file->loop);
+		lingot_audio_destroy(audio);
+	}
+	lingot_config_destroy(conf);
+	unlink(conf_path);
+
+	// stereo float WAV of an unfinished recording, we take the first
+	// channel and all the samples in the file.
+	lingot_audio_file_test_write_wav(path, 3, 32, 2, 48000, 0xFFFFFFFF);
+	audio = lingot_audio_file_test_new(path, ",pace=fast");
+	CU_ASSERT_PTR_NOT_NULL_FATAL(audio);
+	CU_ASSERT_EQUAL(audio->real_sample_rate, 48000);
+	CU_ASSERT_EQUAL(audio->file->frames, LINGOT_AUDIO_FILE_TEST_FRAMES);
+	CU_ASSERT_EQUAL(lingot_audio_read(audio), 256);
+	CU_ASSERT_EQUAL(lingot_audio_file_test_check(audio, 0, 256), 0);
+	lingot_audio_destroy(audio);
+
+	// raw samples, without any header.
+	fid = fopen(path, "wb");
+	for (i = 0; i < LINGOT_AUDIO_FILE_TEST_FRAMES; i++) {
+		f[0] = ((i & 1) ? -i : i) / 32767.0;
+		f[1] = 0.5;
+		fwrite(f, sizeof(f[0]), 2, fid);
+	}
+	fclose(fid);
+	audio = lingot_audio_file_test_new(path,
+			",pace=fast,format=double,channels=2,rate=22050");
+	CU_ASSERT_PTR_NOT_NULL_FATAL(audio);
+	CU_ASSERT_EQUAL(audio->real_sample_rate, 22050);
+	CU_ASSERT_EQUAL(audio->file->frames, LINGOT_AUDIO_FILE_TEST_FRAMES);
+	CU_ASSERT_EQUAL(lingot_audio_read(audio), 256);
+	CU_ASSERT_EQUAL(lingot_audio_file_test_check(audio, 0, 256), 0);
+	lingot_audio_destroy(audio);
+
+	// WAV files cut inside the format chunk, and before the data, are
+	// rejected without reading past their end.
+	lingot_audio_file_test_write_wav(path, 1, 16, 1, 8000,
+			2 * LINGOT_AUDIO_FILE_TEST_FRAMES);
+	CU_ASSERT_EQUAL(truncate(path, 40), 0);
+	CU_ASSERT_PTR_NULL(lingot_audio_file_test_new(path, ",pace=fast"));
+	lingot_audio_file_test_write_wav(path, 1, 16, 1, 8000,
+			2 * LINGOT_AUDIO_FILE_TEST_FRAMES);
+	CU_ASSERT_EQUAL(truncate(path, 52), 0);
+	CU_ASSERT_PTR_NULL(lingot_audio_file_test_new(path, ",pace=fast"));
+
+	// bad options and missing files.
+	CU_ASSERT_PTR_NULL(lingot_audio_file_test_new(path, ",speed=2"));
+	CU_ASSERT_PTR_NULL(lingot_audio_file_test_new(path, ",format=u8"));
+	unlink(path);
+	CU_ASSERT_PTR_NULL(lingot_audio_file_test_new(path, ""));
+	CU_ASSERT_PTR_NULL(lingot_audio_file_test_new("", ""));
+}
@@ -0,0 +1,136 @@
+/*
+ * lingot, a musical instrument tuner.
+ *
+ * Copyright (C) 2013  Ibán Cereijo Graña
+ *
+ * This file is part of lingot.
+ *
+ * lingot is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * lingot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with lingot; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+#include "lingot-test.h"
+
+#include "lingot-audio-format.h"
+
+#define LINGOT_AUDIO_FORMAT_TEST_FRAMES 1003
+
+// fills 'raw' with n frames of the given channels, and 'expected' with the
+// value of the given channel in each one.
+static void lingot_audio_format_test_fill(sample_format_t format, void* raw,
+		unsigned int channels, unsigned int channel, unsigned int n,
+		double* expected) {
+	unsigned int i, c;
+	int32_t x;
+	double v;
+
+	for (i = 0; i < n; i++) {
+		for (c = 0; c < channels; c++) {
+			// full scale range, different in each channel.
+			v = sin(0.37 * i + c) * (1.0 - 1e-6);
+			switch (format) {
+			case SAMPLE_FORMAT_S16:
+				x = floor(32767.0 * v);
+				((int16_t*) raw)[i * channels + c] = x;
+				v = x;
+				break;
+			case SAMPLE_FORMAT_S24_3LE: {
+				uint8_t* p = (uint8_t*) raw + 3 * (i * channels + c);
+				x = floor(8388607.0 * v);
+				p[0] = x & 0xFF;
+				p[1] = (x >> 8) & 0xFF;
+				p[2] = (x >> 16) & 0xFF;
+				v = x / 256.0;
+				break;
+			}
+			case SAMPLE_FORMAT_S32:
+				x = floor(2147483647.0 * v);
+				((int32_t*) raw)[i * channels + c] = x;
+				v = x / 65536.0;
+				break;
+			case SAMPLE_FORMAT_FLOAT32:
+				((float*) raw)[i * channels + c] = v;
+				v = ((float) v) * FLT_SAMPLE_SCALE;
+				break;
+			case SAMPLE_FORMAT_FLOAT64:
+				((double*) raw)[i * channels + c] = v;
+				v *= FLT_SAMPLE_SCALE;
+				break;
+			}
+			if (c == channel) {
+				expected[i] = v;
+			}
+		}
+	}
+}
+
+void lingot_audio_format_test() {
+
+	const unsigned int n = LINGOT_AUDIO_FORMAT_TEST_FRAMES;
+	const unsigned int channels[] = { 1, 3 };
+	void* raw = malloc(3 * n * 8);
+	uint8_t* misaligned = malloc(3 * n * 8 + 2);
+	double expected[LINGOT_AUDIO_FORMAT_TEST_FRAMES];
+	FLT out[LINGOT_AUDIO_FORMAT_TEST_FRAMES];
+	unsigned int i, j, channel, errors;
+	int format;
+
+	CU_ASSERT_EQUAL(lingot_audio_format_size(SAMPLE_FORMAT_S24_3LE), 3);
+	CU_ASSERT_EQUAL(lingot_audio_format_size(SAMPLE_FORMAT_FLOAT64), 8);
+
+	// every format, in mono and taking each channel out of interleaved
+	// frames. The odd number of frames exercises the tails of the vector
+	// kernels. The samples of a WAV file are only aligned to 2 bytes, so we
+	// also convert them from there.
+	for (format = SAMPLE_FORMAT_S16; format <= SAMPLE_FORMAT_FLOAT64;
+			format++) {
+		for (j = 0; j < sizeof(channels) / sizeof(channels[0]); j++) {
+			for (channel = 0; channel < channels[j]; channel++) {
+				lingot_audio_format_test_fill(format, raw, channels[j],
+						channel, n, expected);
+				lingot_audio_format_convert(format, raw, channels[j], channel,
+						n, out);
+				errors = 0;
+				for (i = 0; i < n; i++) {
+					if (fabs(out[i] - expected[i])
+							> 1e-6 * FLT_SAMPLE_SCALE) {
+						errors++;
+					}
+				}
+				CU_ASSERT_EQUAL(errors, 0);
+
+				memcpy(misaligned + 2, raw, 3 * n * 8);
+				lingot_audio_format_convert(format, misaligned + 2,
+						channels[j], channel, n, out);
+				errors = 0;
+				for (i = 0; i < n; i++) {
+					if (fabs(out[i] - expected[i])
+							> 1e-6 * FLT_SAMPLE_SCALE) {
+						errors++;
+					}
+				}
+				CU_ASSERT_EQUAL(errors, 0);
+			}
+		}
+	}
+
+	free(raw);
+	free(misaligned);
+}
@@ -0,0 +1,230 @@
+/*
+ * lingot, a musical instrument tuner.
+ *
+ * Copyright (C) 2013  Ibán Cereijo Graña
+ *
+ * This file is part of lingot.
+ *
+ * lingot is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * lingot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with lingot; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "lingot-test.h"
+
+#include "lingot-audio.h"
+#include "lingot-audio-synth.h"
+#include "lingot-config.h"
+#include "lingot-core.h"
+
+static void lingot_audio_synth_test_callback(FLT* read_buffer,
+		int read_buffer_size_samples, void *arg) {
+}
+
+static LingotAudioHandler* lingot_audio_synth_test_new(char* device,
+		unsigned int period_size) {
+	return lingot_audio_new(AUDIO_SYSTEM_SYNTH, device, 44100, period_size, 0,
+			lingot_audio_synth_test_callback, NULL);
+}
+
+// frequency estimated from the upward zero crossings of a pure tone.
+static double lingot_audio_synth_test_frequency(LingotAudioHandler* audio,
+		int periods) {
+	int i, j, crossings = 0, first = -1, last = 0;
+	FLT previous = 0.0;
+
+	for (i = 0; i < periods; i++) {
+		CU_ASSERT_EQUAL(lingot_audio_read(audio),
+				audio->read_buffer_size_samples);
+		for (j = 0; j < audio->read_buffer_size_samples; j++) {
+			if ((previous < 0.0) && (audio->flt_read_buffer[j] >= 0.0)) {
+				if (first < 0) {
+					first = i * audio->read_buffer_size_samples + j;
+				} else {
+					crossings++;
+				}
+				last = i * audio->read_buffer_size_samples + j;
+			}
+			previous = audio->flt_read_buffer[j];
+		}
+	}
+
+	return (double) crossings * audio->real_sample_rate / (last - first);
+}
+
+// the example signals survive saving and loading the configuration, and
+// still open.
+static void lingot_audio_synth_test_config() {
+	char path[] = "/tmp/lingot-audio-synth-test-XXXXXX";
+	LingotAudioSystemProperties* properties =
+			lingot_audio_synth_get_audio_system_properties(AUDIO_SYSTEM_SYNTH);
+	LingotConfig* conf = lingot_config_new();
+	LingotAudioHandler* audio;
+	int fd, i;
+
+	fd = mkstemp(path);
+	CU_ASSERT_FATAL(fd >= 0);
+	close(fd);
+
+	lingot_config_create_parameter_specs();
+	for (i = 0; i < properties->n_devices; i++) {
+		lingot_config_restore_default_values(conf);
+		strcpy(conf->audio_dev[AUDIO_SYSTEM_SYNTH], properties->devices[i]);
+		lingot_config_save(conf, path);
+		strcpy(conf->audio_dev[AUDIO_SYSTEM_SYNTH], "");
+		lingot_config_load(conf, path);
+		CU_ASSERT(
+				!strcmp(conf->audio_dev[AUDIO_SYSTEM_SYNTH], properties->devices[i]));
+
+		audio = lingot_audio_synth_test_new(
+				conf->audio_dev[AUDIO_SYSTEM_SYNTH], 256);
+		CU_ASSERT_PTR_NOT_NULL(audio);
+		if (audio != NULL) {
+			lingot_audio_destroy(audio);
+		}
+	}
+
+	unlink(path);
+	lingot_config_destroy(conf);
+	lingot_audio_audio_system_properties_destroy(properties);
+}
+
+void lingot_audio_synth_test() {
+
+	LingotAudioHandler* audio;
+	struct timespec now;
+	double peak;
+	int i, silent;
+	FLT first;
+
+	// bad options are rejected.
+	CU_ASSERT_PTR_NULL(lingot_audio_synth_test_new("bogus=1", 0));
+	CU_ASSERT_PTR_NULL(lingot_audio_synth_test_new("freq=-1", 0));
+	CU_ASSERT_PTR_NULL(lingot_audio_synth_test_new("pace=slow", 0));
+	CU_ASSERT_PTR_NULL(lingot_audio_synth_test_new("harmonics=-1", 0));
+	CU_ASSERT_PTR_NULL(lingot_audio_synth_test_new("harmonics=0", 0));
+	CU_ASSERT_PTR_NULL(lingot_audio_synth_test_new("harmonics=65", 0));
+	CU_ASSERT_PTR_NULL(lingot_audio_synth_test_new("harmonics=4x", 0));
+
+	// defaults.
+	audio = lingot_audio_synth_test_new("default", 0);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(audio);
+	CU_ASSERT_EQUAL(audio->read_buffer_size_samples, 1024);
+	CU_ASSERT_EQUAL(audio->synth->frequency, 440.0);
+	CU_ASSERT(audio->synth->paced);
+	CU_ASSERT_EQUAL(audio->bytes_per_sample, sizeof(FLT));
+	lingot_audio_destroy(audio);
+
+	// pure tone at the requested level.
+	audio = lingot_audio_synth_test_new(
+			"freq=1000,harmonics=1,level=-20,pace=fast", 256);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(audio);
+	CU_ASSERT_EQUAL(audio->read_buffer_size_samples, 256);
+	CU_ASSERT(fabs(lingot_audio_synth_test_frequency(audio, 100) - 1000.0)
+			< 0.5);
+	peak = 0.0;
+	for (i = 0; i < audio->read_buffer_size_samples; i++) {
+		peak = fmax(peak, fabs(audio->flt_read_buffer[i]));
+	}
+	CU_ASSERT(fabs(peak / FLT_SAMPLE_SCALE - 0.1) < 1e-3);
+	lingot_audio_destroy(audio);
+
+	// silence gaps, of 10 ms every 20 ms.
+	audio = lingot_audio_synth_test_new("harmonics=1,gap=0.01:0.01,pace=fast",
+			882);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(audio);
+	lingot_audio_read(audio);
+	silent = 0;
+	for (i = 1; i < audio->read_buffer_size_samples; i++) {
+		silent += (audio->flt_read_buffer[i] == 0.0);
+	}
+	CU_ASSERT_EQUAL(silent, 441); // the first sample is sin(0)
+	CU_ASSERT_NOT_EQUAL(audio->flt_read_buffer[440], 0.0);
+	CU_ASSERT_EQUAL(audio->flt_read_buffer[441], 0.0);
+	lingot_audio_destroy(audio);
+
+	// noise only, reproducible with the same seed.
+	audio = lingot_audio_synth_test_new("level=-200,noise=-40,seed=7,pace=fast",
+			256);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(audio);
+	lingot_audio_read(audio);
+	first = audio->flt_read_buffer[10];
+	peak = 0.0;
+	for (i = 0; i < audio->read_buffer_size_samples; i++) {
+		peak = fmax(peak, fabs(audio->flt_read_buffer[i]));
+	}
+	CU_ASSERT(peak > 0.0);
+	CU_ASSERT(peak <= 0.01 * FLT_SAMPLE_SCALE);
+	lingot_audio_destroy(audio);
+	audio = lingot_audio_synth_test_new("level=-200,noise=-40,seed=7,pace=fast",
+			256);
+	lingot_audio_read(audio);
+	CU_ASSERT_EQUAL(audio->flt_read_buffer[10], first);
+	lingot_audio_destroy(audio);
+
+	// paced at the sample rate, on a clock of our own: a reader on time
+	// waits for each period of 441 samples, 10 ms apart.
+	audio = lingot_audio_synth_test_new("default", 441);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(audio);
+	now.tv_sec = 1000;
+	now.tv_nsec = 0;
+	for (i = 0; i < 20; i++) {
+		CU_ASSERT_EQUAL(lingot_audio_pace_at(audio, &now), 1);
+		now.tv_nsec += 10000000;
+	}
+	CU_ASSERT_EQUAL(audio->deadline.tv_sec, 1000);
+	CU_ASSERT_EQUAL(audio->deadline.tv_nsec, 200000000);
+	CU_ASSERT_EQUAL(audio->late_periods, 0);
+
+	// a reader falling 95 ms behind is more than the buffer of 2 periods
+	// late, so it doesn't wait, and goes on from there.
+	now.tv_nsec = 305000000;
+	CU_ASSERT_EQUAL(lingot_audio_pace_at(audio, &now), 0);
+	CU_ASSERT_EQUAL(audio->late_periods, 9);
+	now.tv_nsec += 10000000;
+	CU_ASSERT_EQUAL(lingot_audio_pace_at(audio, &now), 1);
+	CU_ASSERT_EQUAL(audio->late_periods, 9);
+
+	// late, but nothing lost.
+	CU_ASSERT_EQUAL(audio->overruns, 0);
+	CU_ASSERT_EQUAL(audio->lost_frames, 0);
+	lingot_audio_destroy(audio);
+
+	// the core finds the fundamental of a stiff string.
+	LingotConfig* conf = lingot_config_new();
+	lingot_config_restore_default_values(conf);
+	LingotCore* core = lingot_core_new_stream(conf, 512);
+	audio = lingot_audio_synth_test_new(
+			"freq=110,harmonics=6,inharmonicity=0.0001,pace=fast", 512);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(audio);
+	for (i = 0; i < 40; i++) {
+		lingot_audio_read(audio);
+		lingot_core_read_callback(audio->flt_read_buffer, 512, core);
+		if (i % 4 == 3) {
+			lingot_core_compute_fundamental_fequency(core);
+		}
+	}
+	CU_ASSERT(fabs(1200.0 * log2(core->freq / 110.0)) < 2.0);
+	lingot_audio_destroy(audio);
+	lingot_core_destroy(core);
+	lingot_config_destroy(conf);
+
+	lingot_audio_synth_test_config();
+}
@@ -50,5 +50,16 @@ void lingot_config_test() {
 	CU_ASSERT_EQUAL(config->peak_number, 3);
 	CU_ASSERT_EQUAL(config->peak_half_width, 1);
 
+	// at 48 kHz the oversampling would be the prime 23, the multistage
+	// decimator gets the composite factor below.
+	lingot_config_restore_default_values(config);
+	config->sample_rate = 48000;
+	config->decimation_filter = DECIMATION_FILTER_FIR;
+	lingot_config_update_internal_params(config);
+	CU_ASSERT_EQUAL(config->oversampling, 23);
+	config->decimation_filter = DECIMATION_FILTER_MULTISTAGE;
+	lingot_config_update_internal_params(config);
+	CU_ASSERT_EQUAL(config->oversampling, 22);
+
 	lingot_config_destroy(config);
 }
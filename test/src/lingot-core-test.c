@@ -22,6 +22,11 @@
 
 #include "lingot-test.h"
 
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
 #include "errno.h"
 #include "lingot-audio.h"
 #include "lingot-audio-alsa.h"
@@ -32,6 +37,184 @@
 
 #include "lingot-core.h"
 
+// feeds the given duration of a tone with the given amplitude, in dBFS.
+static void lingot_core_test_feed(LingotCore* core, double f, double level,
+		double duration) {
+	const int block_size = 512;
+	const double sample_rate = core->conf->sample_rate;
+	static double t = 0.0;
+	FLT block[block_size];
+	int i, j;
+
+	for (i = 0; i < duration * sample_rate; i += block_size) {
+		for (j = 0; j < block_size; j++) {
+			block[j] = FLT_SAMPLE_SCALE * pow(10.0, level / 20.0)
+					* cos(2.0 * M_PI * f * t);
+			t += 1.0 / sample_rate;
+		}
+		lingot_core_read_callback(block, block_size, core);
+	}
+}
+
+static void lingot_core_gate_test() {
+
+	int i;
+	LingotCoreStats stats;
+	LingotConfig* conf = lingot_config_new();
+	lingot_config_restore_default_values(conf);
+	conf->noise_gate = -60.0;
+	LingotCore* core = lingot_core_new_stream(conf, 512);
+
+	// under the gate there is no analysis at all.
+	lingot_core_test_feed(core, 110.0, -80.0, 0.5);
+	CU_ASSERT(!core->gate_open);
+	for (i = 0; i < 8; i++) {
+		lingot_core_test_feed(core, 110.0, -80.0, 0.05);
+		lingot_core_compute_fundamental_fequency(core);
+	}
+	CU_ASSERT_EQUAL(core->freq, 0.0);
+	CU_ASSERT_EQUAL(core->SPL[0], -200.0);
+
+	// it opens on the first loud block.
+	lingot_core_test_feed(core, 110.0, -20.0, 0.02);
+	CU_ASSERT(core->gate_open);
+	for (i = 0; i < 8; i++) {
+		lingot_core_test_feed(core, 110.0, -20.0, 0.05);
+		lingot_core_compute_fundamental_fequency(core);
+	}
+	CU_ASSERT(fabs(1200.0 * log2(core->freq / 110.0)) < 1.0);
+
+	// and closes once the temporal window is all silence.
+	lingot_core_test_feed(core, 110.0, -80.0, 0.5 * conf->temporal_window);
+	CU_ASSERT(core->gate_open);
+	lingot_core_test_feed(core, 110.0, -80.0, conf->temporal_window);
+	CU_ASSERT(!core->gate_open);
+	lingot_core_compute_fundamental_fequency(core);
+	CU_ASSERT_EQUAL(core->freq, 0.0);
+
+	// the decimator writes straight into the sample memory, which only
+	// copies the new samples to its mirror half, once or twice per block.
+	lingot_core_get_stats(core, &stats);
+	CU_ASSERT(stats.copies >= stats.blocks);
+	CU_ASSERT(stats.copies < 2 * stats.blocks);
+
+	// fed and analyzed from a single thread, nothing ever collides.
+	CU_ASSERT_EQUAL(stats.snapshot_retries, 0);
+	CU_ASSERT_EQUAL(stats.collisions, 0);
+
+	lingot_core_destroy(core);
+	lingot_config_destroy(conf);
+}
+
+// the analysis is woken up by the audio, once per hop.
+static void lingot_core_hop_test() {
+
+	int hops, expected;
+	LingotCoreStats stats;
+	LingotConfig* conf = lingot_config_new();
+	lingot_config_restore_default_values(conf);
+	conf->noise_gate = -60.0;
+	LingotCore* core = lingot_core_new_stream(conf, 512);
+
+	// a stream core signals nothing on its own, we give it the eventfd the
+	// audio thread of a core with audio signals.
+	core->hop_eventfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	CU_ASSERT_FATAL(core->hop_eventfd >= 0);
+	core->hop_size = 100;
+
+	// nothing on silence.
+	lingot_core_test_feed(core, 110.0, -80.0, 0.5);
+	CU_ASSERT_EQUAL(lingot_core_wait_hop(core, 0), 0);
+
+	// an onset wakes the analysis right away, before a whole hop.
+	lingot_core_test_feed(core, 110.0, -20.0, 0.01);
+	CU_ASSERT_EQUAL(lingot_core_wait_hop(core, 0), 1);
+	lingot_core_compute_fundamental_fequency(core);
+
+	// then once per hop. When the analysis is late, it runs once and the
+	// other hops are skipped.
+	lingot_core_test_feed(core, 110.0, -20.0, 1.0);
+	expected = conf->sample_rate / (conf->oversampling * core->hop_size);
+	hops = lingot_core_wait_hop(core, 0);
+	CU_ASSERT(abs(hops - expected) <= 2);
+	lingot_core_compute_fundamental_fequency(core);
+	lingot_core_get_stats(core, &stats);
+	CU_ASSERT_EQUAL(stats.skipped_hops, hops - 1);
+	CU_ASSERT_EQUAL(stats.analyses, 2);
+
+	// the gate closing is signaled too, to publish the silence, which
+	// needs no analysis.
+	lingot_core_test_feed(core, 110.0, -80.0, 2.0 * conf->temporal_window);
+	CU_ASSERT(lingot_core_wait_hop(core, 0) > 0);
+	lingot_core_compute_fundamental_fequency(core);
+	CU_ASSERT_EQUAL(core->freq, 0.0);
+	CU_ASSERT_EQUAL(lingot_core_wait_hop(core, 0), 0);
+	lingot_core_get_stats(core, &stats);
+	CU_ASSERT_EQUAL(stats.analyses, 2);
+
+	lingot_core_destroy(core);
+	lingot_config_destroy(conf);
+}
+
+// the capture period and buffer requested in the configuration.
+static void lingot_core_period_test() {
+
+	LingotConfig* conf = lingot_config_new();
+	lingot_config_restore_default_values(conf);
+	conf->audio_system = AUDIO_SYSTEM_SYNTH;
+	strcpy(conf->audio_dev[AUDIO_SYSTEM_SYNTH], "pace=fast");
+	conf->period_size = 300;
+	conf->periods = 3;
+	LingotCore* core = lingot_core_new(conf);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(core->audio);
+
+	CU_ASSERT_EQUAL(core->audio->read_buffer_size_samples, 300);
+	CU_ASSERT_EQUAL(core->audio->periods, 3);
+	CU_ASSERT(fabs(core->audio->latency - 1e3 * 900 / 44100) < 1e-6);
+	lingot_core_destroy(core);
+
+	// 0 lets the audio system choose.
+	conf->period_size = 0;
+	conf->periods = 0;
+	core = lingot_core_new(conf);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(core->audio);
+	CU_ASSERT_EQUAL(core->audio->read_buffer_size_samples, 1024);
+	CU_ASSERT_EQUAL(core->audio->periods, 2);
+	CU_ASSERT(fabs(core->audio->latency - 1e3 * 2048 / 44100) < 1e-6);
+	lingot_core_destroy(core);
+
+	lingot_config_destroy(conf);
+}
+
+// stopping the core wakes up the analysis waiting for a hop, which finishes
+// instead of being cancelled. How fast is measured in the benchmarks.
+static void lingot_core_stop_test() {
+
+	LingotCoreStats stats;
+	LingotConfig* conf = lingot_config_new();
+	lingot_config_restore_default_values(conf);
+	conf->audio_system = AUDIO_SYSTEM_SYNTH;
+	strcpy(conf->audio_dev[AUDIO_SYSTEM_SYNTH], "level=-200");
+	conf->noise_gate = -60.0;
+	LingotCore* core = lingot_core_new(conf);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(core->audio);
+
+	lingot_core_start(core);
+	CU_ASSERT_FATAL(core->running);
+	usleep(100000);
+	lingot_core_stop(core);
+	CU_ASSERT(core->thread_computation_done);
+
+	// all silence, nothing analyzed, and nothing lost by the synthesizer.
+	lingot_core_get_stats(core, &stats);
+	CU_ASSERT_EQUAL(stats.analyses, 0);
+	CU_ASSERT_EQUAL(stats.overruns, 0);
+	CU_ASSERT_EQUAL(stats.lost_frames, 0);
+
+	lingot_core_destroy(core);
+	lingot_config_destroy(conf);
+}
+
 void lingot_core_test() {
 
 	FLT multiplier1 = 0.0;
@@ -60,7 +243,7 @@ void lingot_core_test() {
 			&multiplier1, &multiplier2);
 	CU_ASSERT_EQUAL(rel, 1);
 	CU_ASSERT_EQUAL(multiplier1, 1.0);
-	CU_ASSERT_EQUAL(multiplier2, 0.2);
+	CU_ASSERT_EQUAL(multiplier2, (FLT) 0.2);
 
 
 	rel = lingot_core_frequencies_related(97.959328, 48.977020, 15.0,
@@ -68,4 +251,9 @@ void lingot_core_test() {
 	CU_ASSERT_EQUAL(rel, 1);
 	CU_ASSERT_EQUAL(multiplier1, 0.5);
 	CU_ASSERT_EQUAL(multiplier2, 1.0);
+
+	lingot_core_gate_test();
+	lingot_core_hop_test();
+	lingot_core_period_test();
+	lingot_core_stop_test();
 }
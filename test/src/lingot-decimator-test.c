@@ -0,0 +1,96 @@
+/*
+ * lingot, a musical instrument tuner.
+ *
+ * Copyright (C) 2013  Ibán Cereijo Graña
+ *
+ * This file is part of lingot.
+ *
+ * lingot is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * lingot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with lingot; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <stdio.h>
+#include <math.h>
+
+#include "lingot-test.h"
+
+#include "lingot-decimator.h"
+
+// feeds a tone of normalized frequency w (respect to pi) in blocks of
+// block_size samples, returning the output amplitude once settled, estimated
+// from its RMS value.
+static FLT lingot_decimator_test_tone_gain(LingotDecimator* decimator, FLT w,
+		unsigned int block_size, unsigned int* total_output) {
+
+	const unsigned int n = 40000;
+	FLT block[block_size];
+	FLT power = 0.0;
+	unsigned int i, j, k, m;
+	unsigned int settled_output = 0;
+
+	*total_output = 0;
+	lingot_decimator_reset(decimator);
+
+	for (i = 0; i < n; i += block_size) {
+		for (j = 0; j < block_size; j++) {
+			block[j] = cos(M_PI * w * (i + j));
+		}
+		m = lingot_decimator_decimate(decimator, block, block_size, block);
+		CU_ASSERT(m <= lingot_decimator_output_room(decimator, block_size));
+		*total_output += m;
+		for (k = 0; k < m; k++) {
+			if (i > n / 2) {
+				power += block[k] * block[k];
+				settled_output++;
+			}
+		}
+	}
+
+	return sqrt(2.0 * power / settled_output);
+}
+
+void lingot_decimator_test() {
+
+	const unsigned int factor = 21;
+	unsigned int total_output;
+	FLT gain;
+	int type;
+
+	for (type = DECIMATION_FILTER_IIR; type <= DECIMATION_FILTER_MULTISTAGE;
+			type++) {
+
+		LingotDecimator* decimator = lingot_decimator_new(type, factor);
+
+		CU_ASSERT_PTR_NOT_NULL_FATAL(decimator);
+
+		// the phase is kept between blocks of sizes not multiple of the
+		// factor, so we get exactly one output every 'factor' inputs.
+		gain = lingot_decimator_test_tone_gain(decimator, 0.25 / factor, 1000,
+				&total_output);
+		CU_ASSERT_EQUAL(total_output, (40000 + factor - 1) / factor);
+		CU_ASSERT(fabs(gain - 1.0) < 0.1);
+
+		// passband
+		gain = lingot_decimator_test_tone_gain(decimator, 0.5 / factor, 333,
+				&total_output);
+		CU_ASSERT(fabs(gain - 1.0) < 0.1);
+
+		// stopband, above the new Nyquist frequency
+		gain = lingot_decimator_test_tone_gain(decimator, 1.5 / factor, 1024,
+				&total_output);
+		CU_ASSERT(gain < 1e-2);
+
+		lingot_decimator_destroy(decimator);
+	}
+}
@@ -0,0 +1,100 @@
+/*
+ * lingot, a musical instrument tuner.
+ *
+ * Copyright (C) 2013  Ibán Cereijo Graña
+ *
+ * This file is part of lingot.
+ *
+ * lingot is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * lingot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with lingot; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <math.h>
+
+#include "lingot-test.h"
+
+#include "lingot-config.h"
+#include "lingot-engine.h"
+
+// feeds the given duration of a tone of a different frequency to each stream,
+// in blocks of block_size frames.
+static void lingot_engine_test_feed(LingotEngine* engine, const double* f,
+		double sample_rate, double duration, unsigned int block_size) {
+	const unsigned int n_streams = engine->n_streams;
+	const unsigned int n_frames = duration * sample_rate;
+	FLT* block = malloc(block_size * n_streams * sizeof(FLT));
+	unsigned int i, j, k;
+
+	for (k = 0; k < n_frames; k += block_size) {
+		for (j = 0; j < block_size; j++) {
+			for (i = 0; i < n_streams; i++) {
+				block[j * n_streams + i] = FLT_SAMPLE_SCALE * 0.5
+						* cos(2.0 * M_PI * f[i] * (k + j) / sample_rate);
+			}
+		}
+		lingot_engine_write(engine, block, block_size);
+	}
+
+	free(block);
+}
+
+void lingot_engine_test() {
+
+	const unsigned int n_streams = 12;
+	const unsigned int block_size = 500;
+	double f[n_streams];
+	double error_cents;
+	unsigned int i;
+
+	LingotConfig* conf = lingot_config_new();
+	lingot_config_restore_default_values(conf);
+	conf->sample_rate = 48000;
+	lingot_config_update_internal_params(conf);
+
+	// one semitone and a bit apart, from E2 to E3.
+	for (i = 0; i < n_streams; i++) {
+		f[i] = 82.407 * pow(2.0, (1.1 * i) / 12.0);
+	}
+
+	// more workers than CPUs, so some of them have to steal.
+	LingotEngine* engine = lingot_engine_new(conf, n_streams, block_size, 5);
+	CU_ASSERT_EQUAL(engine->n_workers, 5);
+
+	lingot_engine_test_feed(engine, f, conf->sample_rate, 1.0, block_size);
+
+	// the frequency locker needs some hits before giving a frequency.
+	for (i = 0; i < 8; i++) {
+		lingot_engine_compute(engine);
+	}
+	CU_ASSERT_EQUAL(engine->rounds, 8);
+
+	for (i = 0; i < n_streams; i++) {
+		error_cents = 1200.0
+				* log2(lingot_engine_get_frequency(engine, i) / f[i]);
+		CU_ASSERT(fabs(error_cents) < 1.0);
+	}
+
+	// periodic computation.
+	lingot_engine_start(engine);
+	usleep(300000);
+	lingot_engine_stop(engine);
+	CU_ASSERT(engine->rounds > 8);
+
+	lingot_engine_destroy(engine);
+
+	lingot_config_destroy(conf);
+}
@@ -0,0 +1,113 @@
+/*
+ * lingot, a musical instrument tuner.
+ *
+ * Copyright (C) 2013  Ibán Cereijo Graña
+ *
+ * This file is part of lingot.
+ *
+ * lingot is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * lingot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with lingot; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <math.h>
+
+#include "lingot-test.h"
+
+#include "lingot-fft.h"
+#include "lingot-signal.h"
+
+// direct evaluation of the SPD derivatives, as a reference.
+static void lingot_fft_test_spd_diffs(const FLT* in, const FLT* window, int N,
+		double w, double* d0, double* d1, double* d2) {
+	double x, c = 0.0, s = 0.0, nc = 0.0, ns = 0.0, n2c = 0.0, n2s = 0.0;
+	int n;
+
+	for (n = 0; n < N; n++) {
+		x = in[n] * ((window != NULL) ? window[n] : 1.0);
+		c += x * cos(w * n);
+		s += x * sin(w * n);
+		nc += x * n * cos(w * n);
+		ns += x * n * sin(w * n);
+		n2c += x * n * n * cos(w * n);
+		n2s += x * n * n * sin(w * n);
+	}
+
+	*d0 = (c * c + s * s) / ((double) N * N);
+	*d1 = 2.0 * (s * nc - c * ns) / ((double) N * N);
+	*d2 = 2.0 * (nc * nc - s * n2s + ns * ns - c * n2c) / ((double) N * N);
+}
+
+// the FFT against the direct evaluation of the DFT.
+static void lingot_fft_test_spd(int N) {
+	FLT in[N];
+	FLT spd[N / 2];
+	FLT spd_ref[N / 2];
+	FLT error = 0.0;
+	int n;
+
+	for (n = 0; n < N; n++) {
+		in[n] = cos(0.3 * n) + 0.5 * sin(1.7 * n + 0.2) + 0.01 * (n % 7);
+	}
+
+	LingotFFTPlan* plan = lingot_fft_plan_create(in, N);
+	lingot_fft_compute_dft_and_spd(plan, spd, N / 2);
+	lingot_fft_spd_eval(in, N, 0.0, 2.0 * M_PI / N, spd_ref, N / 2);
+
+	for (n = 0; n < N / 2; n++) {
+		error = fmax(error, fabs(spd[n] - spd_ref[n]));
+	}
+	CU_ASSERT(error < LINGOT_TEST_TOLERANCE(1e-12, 1e-5));
+
+	lingot_fft_plan_destroy(plan);
+}
+
+void lingot_fft_test() {
+
+	// both radix-4 only and with a first radix-2 stage.
+	lingot_fft_test_spd(256);
+	lingot_fft_test_spd(512);
+	lingot_fft_test_spd(4096);
+
+	const int N = 3001; // odd, and several blocks long.
+	const double w0 = 0.1234;
+	FLT in[N];
+	FLT window[N];
+	double d0, d1, d2, r0, r1, r2;
+	double w;
+	int n;
+
+	for (n = 0; n < N; n++) {
+		in[n] = cos(w0 * n) + 0.3 * cos(2.0 * w0 * n + 1.0);
+	}
+	lingot_signal_window(N, window, HAMMING);
+
+	for (w = w0 - 0.001; w < w0 + 0.0015; w += 0.0005) {
+		lingot_fft_spd_diffs_eval(in, NULL, N, w, &d0, &d1, &d2);
+		lingot_fft_test_spd_diffs(in, NULL, N, w, &r0, &r1, &r2);
+		CU_ASSERT(fabs(d0 - r0) < 1e-9 * fabs(r0));
+		CU_ASSERT(fabs(d1 - r1) < 1e-9 * (fabs(r1) + N * fabs(r0)));
+		CU_ASSERT(fabs(d2 - r2) < 1e-9 * fabs(r2));
+
+		lingot_fft_spd_diffs_eval(in, window, N, w, &d0, &d1, &d2);
+		lingot_fft_test_spd_diffs(in, window, N, w, &r0, &r1, &r2);
+		CU_ASSERT(fabs(d0 - r0) < 1e-9 * fabs(r0));
+		CU_ASSERT(fabs(d1 - r1) < 1e-9 * (fabs(r1) + N * fabs(r0)));
+		CU_ASSERT(fabs(d2 - r2) < 1e-9 * fabs(r2));
+	}
+
+	// a Newton-Raphson step from the tone frequency stays there.
+	lingot_fft_spd_diffs_eval(in, window, N, w0, &d0, &d1, &d2);
+	CU_ASSERT(d2 < 0.0);
+	CU_ASSERT(fabs(d1 / d2) < 1e-6);
+}
@@ -0,0 +1,102 @@
+/*
+ * lingot, a musical instrument tuner.
+ *
+ * Copyright (C) 2013  Ibán Cereijo Graña
+ *
+ * This file is part of lingot.
+ *
+ * lingot is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * lingot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with lingot; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include "lingot-test.h"
+
+#include "lingot-filter.h"
+
+void lingot_filter_test() {
+
+	const unsigned int n = 20000;
+	const unsigned int block_sizes[] = { 1, 2, 3, 5, 1024 };
+	FLT x[n];
+	FLT y[n];
+	FLT y_ref[n];
+	FLT error;
+	unsigned int i, j, k;
+
+	// narrow Chebyshev filter, as the one for the highest oversampling
+	// factors. Its DC gain must be 10^(-Rp/20) for even orders.
+	LingotFilter* filter = lingot_filter_cheby_design(8, 0.5, 0.9 / 93);
+
+	for (i = 0; i < n; i++) {
+		x[i] = 1.0;
+	}
+	lingot_filter_filter(filter, n, x, y);
+	CU_ASSERT(fabs(y[n - 1] - pow(10.0, -0.05 * 0.5))
+			< LINGOT_TEST_TOLERANCE(1e-6, 2e-3));
+
+	// filtering by blocks of any size is the same as sample by sample,
+	// including those shorter than the pipeline of sections.
+	for (i = 0; i < n; i++) {
+		x[i] = sin(0.001 * i * i);
+	}
+	lingot_filter_reset(filter);
+	for (i = 0; i < n; i++) {
+		y_ref[i] = lingot_filter_filter_sample(filter, x[i]);
+	}
+	for (k = 0; k < sizeof(block_sizes) / sizeof(block_sizes[0]); k++) {
+		lingot_filter_reset(filter);
+		for (i = 0; i < n; i += j) {
+			j = (n - i < block_sizes[k]) ? n - i : block_sizes[k];
+			lingot_filter_filter(filter, j, &x[i], &y[i]);
+		}
+		error = 0.0;
+		for (i = 0; i < n; i++) {
+			error = fmax(error, fabs(y[i] - y_ref[i]));
+		}
+		CU_ASSERT(error < LINGOT_TEST_TOLERANCE(1e-12, 1e-5));
+	}
+
+	lingot_filter_destroy(filter);
+
+	// first order filter from its polynomial coefs, in place.
+	const FLT c = 0.1;
+	const FLT a[] = { 1.0, c - 1.0 };
+	const FLT b[] = { c };
+	FLT w = 0.0;
+
+	filter = lingot_filter_new(1, 0, a, b);
+	memcpy(y, x, sizeof(y));
+	lingot_filter_filter(filter, n, y, y);
+	error = 0.0;
+	for (i = 0; i < n; i++) {
+		w = c * x[i] + (1.0 - c) * w;
+		error = fmax(error, fabs(y[i] - w));
+	}
+	CU_ASSERT(error < LINGOT_TEST_TOLERANCE(1e-12, 1e-5));
+
+	// and sample by sample.
+	lingot_filter_reset(filter);
+	w = 0.0;
+	error = 0.0;
+	for (i = 0; i < n; i++) {
+		w = c * x[i] + (1.0 - c) * w;
+		error = fmax(error, fabs(lingot_filter_filter_sample(filter, x[i]) - w));
+	}
+	CU_ASSERT(error < LINGOT_TEST_TOLERANCE(1e-12, 1e-5));
+
+	lingot_filter_destroy(filter);
+}
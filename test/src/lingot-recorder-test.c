@@ -0,0 +1,126 @@
+/*
+ * lingot, a musical instrument tuner.
+ *
+ * Copyright (C) 2013  Ibán Cereijo Graña
+ *
+ * This file is part of lingot.
+ *
+ * lingot is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * lingot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with lingot; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <math.h>
+
+#include "lingot-test.h"
+
+#include "lingot-recorder.h"
+#include "lingot-audio.h"
+#include "lingot-audio-file.h"
+
+static void lingot_recorder_test_callback(FLT* read_buffer,
+		int read_buffer_size_samples, void *arg) {
+}
+
+// opens a recorded file with the file audio system, in blocks of the given
+// size.
+static LingotAudioHandler* lingot_recorder_test_open(const char* dir,
+		unsigned int index, unsigned int period) {
+	char device[512];
+	snprintf(device, sizeof(device), "%s/rec-%u.wav,pace=fast", dir, index);
+	return lingot_audio_new(AUDIO_SYSTEM_FILE, device, 0, period, 0,
+			lingot_recorder_test_callback, NULL);
+}
+
+static void lingot_recorder_test_remove(const char* dir, unsigned int files) {
+	char name[512];
+	unsigned int i;
+	for (i = 0; i < files; i++) {
+		snprintf(name, sizeof(name), "%s/rec-%u.wav", dir, i);
+		unlink(name);
+	}
+	rmdir(dir);
+}
+
+void lingot_recorder_test() {
+
+	char dir[] = "/tmp/lingot-recorder-test-XXXXXX";
+	char prefix[512];
+	FLT block[256];
+	LingotRecorder* recorder;
+	LingotAudioHandler* audio;
+	int i, j, errors;
+	unsigned long dropped;
+
+	CU_ASSERT_PTR_NOT_NULL_FATAL(mkdtemp(dir));
+	snprintf(prefix, sizeof(prefix), "%s/rec", dir);
+
+	// 3000 samples in files of 800 samples, keeping 3 of them: the fourth
+	// file, with the last 600 samples, takes the place of the first one.
+	recorder = lingot_recorder_new(prefix, 8000, 256, 0.1, 3);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(recorder);
+	CU_ASSERT(recorder->n_slots * recorder->slot_size >= 8000);
+	for (i = 0; i < 3000; i += 250) {
+		for (j = 0; j < 250; j++) {
+			block[j] = i + j;
+		}
+		lingot_recorder_push(recorder, block, 250);
+		usleep(1000);
+	}
+	CU_ASSERT_EQUAL(lingot_recorder_get_dropped_blocks(recorder), 0);
+	lingot_recorder_destroy(recorder);
+
+	audio = lingot_recorder_test_open(dir, 1, 800);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(audio);
+	CU_ASSERT_EQUAL(audio->real_sample_rate, 8000);
+	CU_ASSERT_EQUAL(audio->file->frames, 800);
+	CU_ASSERT_EQUAL(lingot_audio_read(audio), 800);
+	errors = 0;
+	for (i = 0; i < 800; i++) {
+		errors += fabs(audio->flt_read_buffer[i] - (800 + i)) > 1e-3;
+	}
+	CU_ASSERT_EQUAL(errors, 0);
+	lingot_audio_destroy(audio);
+
+	audio = lingot_recorder_test_open(dir, 0, 600);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(audio);
+	CU_ASSERT_EQUAL(audio->file->frames, 600);
+	CU_ASSERT_EQUAL(lingot_audio_read(audio), 600);
+	CU_ASSERT(fabs(audio->flt_read_buffer[0] - 2400) < 1e-3);
+	CU_ASSERT(fabs(audio->flt_read_buffer[599] - 2999) < 1e-3);
+	lingot_audio_destroy(audio);
+
+	// blocks bigger than a slot, and a burst that does not fit in the
+	// queue: nothing waits, the blocks that do not fit are dropped whole
+	// and counted once.
+	recorder = lingot_recorder_new(prefix, 8000, 128, 60.0, 1);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(recorder);
+	for (i = 0; i < 200; i++) {
+		lingot_recorder_push(recorder, block, 256);
+	}
+	dropped = lingot_recorder_get_dropped_blocks(recorder);
+	CU_ASSERT(dropped > 0);
+	lingot_recorder_destroy(recorder);
+
+	audio = lingot_recorder_test_open(dir, 0, 128);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(audio);
+	CU_ASSERT(audio->file->frames > 0);
+	CU_ASSERT_EQUAL(audio->file->frames, (200 - dropped) * 256);
+	lingot_audio_destroy(audio);
+
+	lingot_recorder_test_remove(dir, 3);
+}
@@ -0,0 +1,121 @@
+/*
+ * lingot, a musical instrument tuner.
+ *
+ * Copyright (C) 2013  Ibán Cereijo Graña
+ *
+ * This file is part of lingot.
+ *
+ * lingot is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * lingot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with lingot; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "lingot-test.h"
+
+#include "lingot-ring-buffer.h"
+
+void lingot_ring_buffer_test() {
+
+	const unsigned int size = 8;
+	FLT in[20];
+	FLT out[8];
+	unsigned long sequence;
+	const FLT* window;
+	unsigned int i;
+
+	for (i = 0; i < 20; i++) {
+		in[i] = i + 1;
+	}
+
+	LingotRingBuffer* ring = lingot_ring_buffer_new(size);
+
+	CU_ASSERT_PTR_NOT_NULL_FATAL(ring);
+
+	// nothing written yet, the history is filled with zeros
+	lingot_ring_buffer_read(ring, out, 4);
+	for (i = 0; i < 4; i++) {
+		CU_ASSERT_EQUAL(out[i], 0.0);
+	}
+
+	lingot_ring_buffer_write(ring, in, 3);
+	lingot_ring_buffer_read(ring, out, 4);
+	CU_ASSERT_EQUAL(out[0], 0.0);
+	CU_ASSERT_EQUAL(out[1], 1.0);
+	CU_ASSERT_EQUAL(out[3], 3.0);
+
+	// wrap around, the newest samples must be contiguous
+	lingot_ring_buffer_write(ring, &in[3], 7);
+	window = lingot_ring_buffer_peek(ring, size, &sequence);
+	for (i = 0; i < size; i++) {
+		CU_ASSERT_EQUAL(window[i], i + 3.0);
+	}
+	CU_ASSERT(lingot_ring_buffer_validate(ring, size, sequence));
+
+	// the producer writes while the consumer holds a window of 4 samples:
+	// the 4 new samples fall in the free room.
+	window = lingot_ring_buffer_peek(ring, 4, &sequence);
+	lingot_ring_buffer_write(ring, &in[10], 4);
+	CU_ASSERT(lingot_ring_buffer_validate(ring, 4, sequence));
+	CU_ASSERT_EQUAL(ring->collisions, 0);
+
+	// but a fifth one overwrites the window, and it's accounted as a
+	// collision.
+	window = lingot_ring_buffer_peek(ring, 4, &sequence);
+	lingot_ring_buffer_write(ring, &in[14], 5);
+	CU_ASSERT(!lingot_ring_buffer_validate(ring, 4, sequence));
+	CU_ASSERT_EQUAL(ring->collisions, 1);
+
+	// a smaller window ending at the same sample is still available
+	window = lingot_ring_buffer_peek_at(ring, 2, sequence);
+	CU_ASSERT_EQUAL(window[0], 13.0);
+	CU_ASSERT_EQUAL(window[1], 14.0);
+	CU_ASSERT(lingot_ring_buffer_validate(ring, 2, sequence));
+
+	// blocks bigger than the capacity keep only the newest samples
+	lingot_ring_buffer_write(ring, in, 20);
+	lingot_ring_buffer_read(ring, out, size);
+	for (i = 0; i < size; i++) {
+		CU_ASSERT_EQUAL(out[i], i + 13.0);
+	}
+
+	// samples generated in place, running into the mirror half: only the
+	// mirror copies are made.
+	ring->copies = 0;
+	ring->copied_bytes = 0;
+	FLT* region = lingot_ring_buffer_write_begin(ring, 6);
+	for (i = 0; i < 6; i++) {
+		region[i] = 100.0 + i;
+	}
+	lingot_ring_buffer_write_commit(ring, 5);
+	CU_ASSERT_EQUAL(ring->copies, 2);
+	CU_ASSERT_EQUAL(ring->copied_bytes, 5 * sizeof(FLT));
+	lingot_ring_buffer_read(ring, out, size - 1);
+	for (i = 0; i < size - 1; i++) {
+		CU_ASSERT_EQUAL(out[i], (i < 2) ? i + 19.0 : i + 98.0);
+	}
+
+	// the sample beyond the committed ones was overwritten, so a window
+	// including it is not valid, even after a smaller append.
+	window = lingot_ring_buffer_peek(ring, size, &sequence);
+	CU_ASSERT(!lingot_ring_buffer_validate(ring, size, sequence));
+	lingot_ring_buffer_write_begin(ring, 0);
+	lingot_ring_buffer_write_commit(ring, 0);
+	window = lingot_ring_buffer_peek(ring, size, &sequence);
+	CU_ASSERT(!lingot_ring_buffer_validate(ring, size, sequence));
+
+	lingot_ring_buffer_reset(ring);
+	lingot_ring_buffer_read(ring, out, size);
+	CU_ASSERT_EQUAL(out[size - 1], 0.0);
+
+	lingot_ring_buffer_destroy(ring);
+}
@@ -0,0 +1,73 @@
+/*
+ * lingot, a musical instrument tuner.
+ *
+ * Copyright (C) 2013  Ibán Cereijo Graña
+ *
+ * This file is part of lingot.
+ *
+ * lingot is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * lingot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with lingot; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <stdlib.h>
+#include <math.h>
+
+#include "lingot-test.h"
+
+#include "lingot-config.h"
+#include "lingot-core.h"
+#include "lingot-rt-debug.h"
+
+void lingot_rt_debug_test() {
+
+	const unsigned int block_size = 256;
+	FLT block[block_size];
+	unsigned long violations;
+	unsigned int i, j;
+
+	LingotConfig* conf = lingot_config_new();
+	lingot_config_restore_default_values(conf);
+	LingotCore* core = lingot_core_new_stream(conf, block_size);
+
+#	ifdef LINGOT_RT_DEBUG
+	void* volatile p; // or the compiler drops the allocations.
+
+	// the blocking calls are counted only inside the realtime sections.
+	violations = lingot_rt_debug_get_violations();
+	p = malloc(16);
+	free(p);
+	CU_ASSERT_EQUAL(lingot_rt_debug_get_violations(), violations);
+
+	lingot_rt_debug_enter();
+	p = malloc(16);
+	free(p);
+	lingot_rt_debug_leave();
+	CU_ASSERT_EQUAL(lingot_rt_debug_get_violations(), violations + 2);
+#	endif
+
+	// what the audio callbacks do in the realtime thread must not block.
+	violations = lingot_rt_debug_get_violations();
+	for (i = 0; i < 200; i++) {
+		for (j = 0; j < block_size; j++) {
+			block[j] = 1e4 * cos(0.03 * (i * block_size + j));
+		}
+		lingot_rt_debug_enter();
+		lingot_core_read_callback(block, block_size, core);
+		lingot_rt_debug_leave();
+	}
+	CU_ASSERT_EQUAL(lingot_rt_debug_get_violations(), violations);
+
+	lingot_core_destroy(core);
+	lingot_config_destroy(conf);
+}
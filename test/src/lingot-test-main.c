@@ -24,6 +24,17 @@ void lingot_config_test();
 void lingot_config_scale_test();
 void lingot_signal_test();
 void lingot_core_test();
+void lingot_ring_buffer_test();
+void lingot_decimator_test();
+void lingot_filter_test();
+void lingot_fft_test();
+void lingot_accuracy_test();
+void lingot_engine_test();
+void lingot_rt_debug_test();
+void lingot_audio_format_test();
+void lingot_audio_synth_test();
+void lingot_audio_file_test();
+void lingot_recorder_test();
 
 // TODO: lib?
 #include "lingot-complex.c"
@@ -39,6 +50,14 @@ void lingot_core_test();
 #include "lingot-core.c"
 #include "lingot-signal.c"
 #include "lingot-filter.c"
+#include "lingot-recorder.c"
+#include "lingot-audio-file.c"
+#include "lingot-audio-synth.c"
+#include "lingot-audio-format.c"
+#include "lingot-rt-debug.c"
+#include "lingot-engine.c"
+#include "lingot-decimator.c"
+#include "lingot-ring-buffer.c"
 
 #include <stdio.h>
 #include <string.h>
@@ -66,6 +85,17 @@ int main(void) {
 			(NULL == CU_add_test(pSuite, "lingot_config_scale", lingot_config_scale_test)) || //
 			(NULL == CU_add_test(pSuite, "lingot_signal", lingot_signal_test)) || //
 			(NULL == CU_add_test(pSuite, "lingot_core", lingot_core_test)) || //
+			(NULL == CU_add_test(pSuite, "lingot_ring_buffer", lingot_ring_buffer_test)) || //
+			(NULL == CU_add_test(pSuite, "lingot_decimator", lingot_decimator_test)) || //
+			(NULL == CU_add_test(pSuite, "lingot_filter", lingot_filter_test)) || //
+			(NULL == CU_add_test(pSuite, "lingot_fft", lingot_fft_test)) || //
+			(NULL == CU_add_test(pSuite, "lingot_accuracy", lingot_accuracy_test)) || //
+			(NULL == CU_add_test(pSuite, "lingot_engine", lingot_engine_test)) || //
+			(NULL == CU_add_test(pSuite, "lingot_rt_debug", lingot_rt_debug_test)) || //
+			(NULL == CU_add_test(pSuite, "lingot_audio_format", lingot_audio_format_test)) || //
+			(NULL == CU_add_test(pSuite, "lingot_audio_synth", lingot_audio_synth_test)) || //
+			(NULL == CU_add_test(pSuite, "lingot_audio_file", lingot_audio_file_test)) || //
+			(NULL == CU_add_test(pSuite, "lingot_recorder", lingot_recorder_test)) || //
 			0) {
 		CU_cleanup_registry();
 		return CU_get_error();
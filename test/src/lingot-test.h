@@ -28,6 +28,13 @@
 
 // unit testing functions
 
+// tolerance for a result computed in double or in single precission.
+#ifdef LINGOT_FLOAT
+#define LINGOT_TEST_TOLERANCE(dbl, flt) (flt)
+#else
+#define LINGOT_TEST_TOLERANCE(dbl, flt) (dbl)
+#endif
+
 // time measurement
 void tic();
 double toc();